@@ -50,6 +50,24 @@ static inline int64_t timestamp_now(void)
     return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
+// An event waiting to be written to disk.  The payload is retained from LCM
+// with lcm_recv_buf_ref() instead of being copied, and the channel name is
+// stored immediately after the struct.
+typedef struct queued_event queued_event_t;
+struct queued_event
+{
+    lcm_eventlog_event_t le; // must be the first member
+    lcm_recv_buf_t *rbuf;
+};
+
+static void
+queued_event_free(lcm_eventlog_event_t *le)
+{
+    queued_event_t *qe = (queued_event_t*) le;
+    lcm_recv_buf_unref(qe->rbuf);
+    free(qe);
+}
+
 typedef struct logger logger_t;
 struct logger
 {
@@ -245,7 +263,7 @@ write_thread(void *user_data)
                 last_spew_utime = now;
             }
             free(reason);
-            free(le);
+            queued_event_free(le);
             if(errno == ENOSPC) {
                 exit(1);
             } else {
@@ -268,7 +286,7 @@ write_thread(void *user_data)
         logger->events_since_last_report ++;
         logger->logsize += 4 + 8 + 8 + 4 + le->channellen + 4 + le->datalen;
 
-        free(le);
+        queued_event_free(le);
 
         if (!logger->quiet && (offset_utime - logger->last_report_time > 1000000)) {
             double dt = (offset_utime - logger->last_report_time)/1000000.0;
@@ -327,20 +345,30 @@ message_handler (const lcm_recv_buf_t *rbuf, const char *channel, void *u)
         g_mutex_unlock(logger->mutex);
     }
 
+    // hold on to the message payload until the write thread is done with it
+    lcm_recv_buf_t *retained = lcm_recv_buf_ref(rbuf);
+    if(!retained) {
+        g_mutex_lock(logger->mutex);
+        logger->write_queue_size -= mem_sz;
+        g_mutex_unlock(logger->mutex);
+        return;
+    }
+
     // queue up the message for writing to disk by the write thread
-    lcm_eventlog_event_t *le = (lcm_eventlog_event_t*) malloc(mem_sz);
-    memset(le, 0, mem_sz);
+    queued_event_t *qe =
+        (queued_event_t*) malloc(sizeof(queued_event_t) + channellen + 1);
+    memset(qe, 0, sizeof(queued_event_t));
+    qe->rbuf = retained;
 
+    lcm_eventlog_event_t *le = &qe->le;
     le->timestamp = rbuf->recv_utime;
     le->channellen = channellen;
     le->datalen = rbuf->data_size;
     // log_write_event will handle le.eventnum.
 
-    le->channel = ((char*)le) + sizeof(lcm_eventlog_event_t);
+    le->channel = ((char*)qe) + sizeof(queued_event_t);
     strcpy(le->channel, channel);
-    le->data = le->channel + channellen + 1;
-    assert((char*)le->data + rbuf->data_size == (char*)le + mem_sz);
-    memcpy(le->data, rbuf->data, rbuf->data_size);
+    le->data = retained->data;
 
     g_async_queue_push(logger->write_queue, le);
 }
@@ -607,7 +635,7 @@ int main(int argc, char *argv[])
             msg=g_async_queue_try_pop(logger.write_queue)) {
         if(msg == &logger.write_thread_exit_flag)
             continue;
-        free(msg);
+        queued_event_free((lcm_eventlog_event_t*) msg);
     }
     g_async_queue_unref(logger.write_queue);
 
@@ -17,6 +17,8 @@ class LCMTypedSubscription : public Subscription {
     friend class LCM;
     private:
         ContextClass context;
+        // decoded into for each message, so that its storage is reused
+        MessageType msg;
         void (*handler)(const ReceiveBuffer *rbuf, const std::string& channel,
                 const MessageType*msg, ContextClass context);
         static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel,
@@ -24,8 +26,7 @@ class LCMTypedSubscription : public Subscription {
         {
             typedef LCMTypedSubscription<MessageType,ContextClass> SubsClass;
             SubsClass *subs = static_cast<SubsClass *> (user_data);
-            MessageType msg;
-            int status = msg.decode(rbuf->data, 0, rbuf->data_size);
+            int status = subs->msg.decode(rbuf->data, 0, rbuf->data_size);
             if (status < 0) {
                 fprintf (stderr, "error %d decoding %s!!!\n", status,
                         MessageType::getTypeName());
@@ -36,7 +37,7 @@ class LCMTypedSubscription : public Subscription {
                 rbuf->data_size,
                 rbuf->recv_utime
             };
-            subs->handler(&rb, channel, &msg, subs->context);
+            subs->handler(&rb, channel, &subs->msg, subs->context);
         }
 };
 
@@ -66,14 +67,15 @@ class LCMMHSubscription : public Subscription {
     friend class LCM;
     private:
         MessageHandlerClass* handler;
+        // decoded into for each message, so that its storage is reused
+        MessageType msg;
         void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer* rbuf, const std::string& channel, const MessageType* msg);
         static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel,
                 void *user_data)
         {
             LCMMHSubscription<MessageType,MessageHandlerClass> *subs =
                 static_cast<LCMMHSubscription<MessageType,MessageHandlerClass> *>(user_data);
-            MessageType msg;
-            int status = msg.decode(rbuf->data, 0, rbuf->data_size);
+            int status = subs->msg.decode(rbuf->data, 0, rbuf->data_size);
             if (status < 0) {
                 fprintf (stderr, "error %d decoding %s!!!\n", status,
                         MessageType::getTypeName());
@@ -85,7 +87,7 @@ class LCMMHSubscription : public Subscription {
                 rbuf->recv_utime
             };
             std::string chan_str(channel);
-            (subs->handler->*subs->handlerMethod)(&rb, chan_str, &msg);
+            (subs->handler->*subs->handlerMethod)(&rb, chan_str, &subs->msg);
         }
 };
 
@@ -152,12 +154,37 @@ LCM::publish(const std::string& channel, const void *data, unsigned int datalen)
 template<class MessageType>
 inline int
 LCM::publish(const std::string& channel, const MessageType *msg) {
+    if(this->lcm && !this->hasSubscribers(channel))
+        return 0;
     unsigned int datalen = msg->getEncodedSize();
-    uint8_t *buf = new uint8_t[datalen];
-    msg->encode(buf, 0, datalen);
-    int status = this->publish(channel, buf, datalen);
-    delete[] buf;
-    return status;
+    // the calling thread's encode buffer, reused from one message to the next
+    uint8_t *buf = (uint8_t*) lcm_get_encode_buffer(datalen);
+    if(!buf)
+        return -1;
+    if(msg->encode(buf, 0, datalen) < 0)
+        return -1;
+    return this->publish(channel, buf, datalen);
+}
+
+template<class MessageType>
+inline int
+LCM::publish(const std::string& channel, const MessageType *msg,
+        std::vector<uint8_t>& buf) {
+    if(this->lcm && !this->hasSubscribers(channel))
+        return 0;
+    unsigned int datalen = msg->getEncodedSize();
+    if(buf.size() < datalen)
+        buf.resize(datalen);
+    if(msg->encode(&buf[0], 0, datalen) < 0)
+        return -1;
+    return this->publish(channel, &buf[0], datalen);
+}
+
+inline bool
+LCM::hasSubscribers(const std::string& channel) {
+    if(!this->lcm)
+        return true;
+    return lcm_channel_has_subscribers(this->lcm, channel.c_str()) != 0;
 }
 
 inline void
@@ -209,6 +236,16 @@ LCM::handleTimeout(int timeout_millis) {
     return lcm_handle_timeout(this->lcm, timeout_millis);
 }
 
+inline int
+LCM::handleBatch(int max_msgs, int timeout_millis) {
+    if(!this->lcm) {
+        fprintf(stderr,
+            "LCM instance not initialized.  Ignoring call to handle()\n");
+        return -1;
+    }
+    return lcm_handle_batch(this->lcm, max_msgs, timeout_millis);
+}
+
 template <class MessageType, class MessageHandlerClass>
 Subscription*
 LCM::subscribe(const std::string& channel,
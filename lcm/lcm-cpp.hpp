@@ -93,6 +93,38 @@ class LCM {
         template<class MessageType>
         inline int publish(const std::string& channel, const MessageType* msg);
 
+        /**
+         * @brief Publishes a message, encoding it into a caller-provided
+         * buffer.
+         *
+         * Same as publish(const std::string&, const MessageType*), except
+         * that the message is encoded into @p buf, which is enlarged if
+         * necessary.  Reusing the same buffer avoids memory allocations.
+         *
+         * @param channel the channel to publish the message on.
+         * @param msg the message to publish.
+         * @param buf the buffer to encode the message into.
+         *
+         * @return 0 on success, -1 on failure.
+         */
+        template<class MessageType>
+        inline int publish(const std::string& channel, const MessageType* msg,
+                std::vector<uint8_t>& buf);
+
+        /**
+         * @brief Checks whether a message published on a channel could be
+         * received.
+         *
+         * The templated publish() method uses this to skip encoding messages
+         * that nobody would receive.  See lcm_channel_has_subscribers().
+         *
+         * @param channel the channel name.
+         *
+         * @return false if a message published on @p channel would certainly
+         * not be received, true otherwise.
+         */
+        inline bool hasSubscribers(const std::string& channel);
+
         /**
          * @brief Returns a file descriptor or socket that can be used with
          * @c select(), @c poll(), or other event loops for asynchronous
@@ -130,6 +162,16 @@ class LCM {
          */
         inline int handleTimeout(int timeout_millis);
 
+        /**
+         * @brief Waits for messages, and dispatches up to @p max_msgs of the
+         * ones already queued.
+         *
+         * @return the number of messages handled, 0 if the function timed
+         * out, and <0 if an error occured.
+         * @sa lcm_handle_batch()
+         */
+        inline int handleBatch(int max_msgs, int timeout_millis);
+
         /**
          * @brief Subscribes a callback method of an object to a channel, with
          * automatic message decoding.
@@ -145,6 +187,11 @@ class LCM {
          * decoding fails, the callback method is not invoked and an error
          * message is printed to stderr.
          *
+         * Each message is decoded into the same @c MessageType instance, so
+         * that its vectors and strings keep their storage from one message to
+         * the next.  The message passed to the callback is only valid until
+         * the callback returns.
+         *
          * The callback method is invoked during calls to LCM::handle().
          * Callback methods are invoked by the same thread that invokes
          * LCM::handle(), in the order that they were subscribed.
@@ -255,6 +302,10 @@ class LCM {
          * by @c lcm-gen @c .  If message decoding fails, the callback function
          * is not invoked and an error message is printed to stderr.
          *
+         * As with subscribe(), each message is decoded into the same
+         * @c MessageType instance, and the message passed to the callback is
+         * only valid until the callback returns.
+         *
          * The callback function is invoked during calls to LCM::handle().
          * Callbacks are invoked by the same thread that invokes
          * LCM::handle(), in the order that they were subscribed.
@@ -21,32 +21,195 @@ typedef int SOCKET;
 
 #define LCM_DEFAULT_URL "udpm://239.255.76.67:7667?ttl=0"
 
+// default for lcm_set_max_cached_channels()
+#define LCM_DEFAULT_MAX_CACHED_CHANNELS 1024
+
+// number of channel snapshots remembered by lcm_try_enqueue_message()
+#define LCM_ENQUEUE_CACHE_SIZE 64
+
+typedef struct _lcm_retained_buf_t lcm_retained_buf_t;
+typedef struct _lcm_channel_handlers_t lcm_channel_handlers_t;
+typedef struct _lcm_handler_snapshot_t lcm_handler_snapshot_t;
+typedef struct _lcm_dispatch_worker_t lcm_dispatch_worker_t;
+typedef struct _lcm_enqueue_cache_entry_t lcm_enqueue_cache_entry_t;
+
 struct _lcm_t {
     GStaticRecMutex mutex;  // guards data structures
     GStaticRecMutex handle_mutex;  // only one thread allowed in lcm_handle at a time
 
     GPtrArray   *handlers_all;  // list containing *all* handlers
-    GHashTable  *handlers_map;  // map of channel name (string) to GPtrArray 
-                                // of matching handlers (lcm_subscription_t*)
+    GHashTable  *handlers_map;  // map of channel name (string) to the
+                                // lcm_channel_handlers_t caching its
+                                // matching handlers
+    GQueue       handlers_lru;  // entries of handlers_map, least recently
+                                // used first
+    int          max_cached_channels;
+    // incremented whenever a subscription is added or removed
+    volatile gint handlers_generation;
+    // snapshots used by lcm_try_enqueue_message() without holding mutex,
+    // indexed by channel name hash.  A thread takes an entry out of its slot
+    // while using it.
+    volatile gpointer enqueue_cache[LCM_ENQUEUE_CACHE_SIZE];
+
+    // handlers indexed by the kind of channel pattern they subscribe with,
+    // used to fill in handlers_map for a channel name that hasn't been seen
+    // before without trying every handler's regex.
+    GHashTable  *literal_subs;  // channel name -> GPtrArray of handlers
+    GHashTable  *prefix_subs;   // PREFIX of "PREFIX.*" -> GPtrArray of handlers
+    int          num_prefix_subs[LCM_MAX_CHANNEL_NAME_LENGTH+1]; // by length
+    GPtrArray   *regex_subs;    // all other handlers
+    uint64_t     next_sub_seqno;
 
     lcm_provider_vtable_t * vtable;
     lcm_provider_t * provider;
 
     int default_max_num_queued_messages;
     int in_handle;
+
+    // messages dropped by lcm_try_enqueue_message, including those of
+    // subscriptions that no longer exist
+    uint64_t num_queue_drops;
+    // messages dropped for exceeding a subscription's latency budget
+    uint64_t num_stale_drops;
+
+    // set once any subscription is given a priority.  Until then, providers
+    // need not look at priorities.
+    volatile gint priorities_used;
+
+    // message currently being dispatched, used by lcm_recv_buf_ref().  Only
+    // accessed by the thread in lcm_dispatch_handlers.
+    const lcm_recv_buf_t *dispatch_rbuf;
+    void **dispatch_storage;
+    lcm_retained_buf_t *dispatch_retained;
+
+    // dispatch threads, see lcm_set_dispatch_threads().  Only changed while
+    // holding both handle_mutex and mutex.
+    lcm_dispatch_worker_t **workers;
+    int num_workers;
+};
+
+// An immutable list of the handlers subscribed to a channel name.  Subscribing
+// and unsubscribing replace a channel's snapshot instead of modifying it, so
+// that a message can be dispatched to a snapshot without holding lcm->mutex.
+// Each snapshot holds a reference to its handlers, and is freed once the
+// channel and all the dispatches using it have released it.
+struct _lcm_handler_snapshot_t {
+    volatile gint refcount;
+    int nhandlers;
+    int max_priority;   // highest priority of the handlers, 0 if none
+    lcm_subscription_t *handlers[];
+};
+
+// a channel's snapshot, valid as long as lcm->handlers_generation still
+// equals generation.
+struct _lcm_enqueue_cache_entry_t {
+    gint       generation;
+    char      *channel;
+    lcm_handler_snapshot_t *snapshot;
+};
+
+// the handlers subscribed to a channel name.  Entries are created the first
+// time a channel name is seen, and evicted once more than max_cached_channels
+// channel names are cached.
+struct _lcm_channel_handlers_t {
+    char      *channel;
+    lcm_handler_snapshot_t *snapshot;
+    GList      lru_link;        // link in lcm->handlers_lru
+};
+
+// A dispatch thread.  Each subscription has its own bounded queue of
+// messages, and a single worker handles them in the order received.
+struct _lcm_dispatch_worker_t {
+    lcm_t     *lcm;
+    GThread   *thread;
+    GMutex    *mutex;
+    GCond     *cond;            // signalled when a subscription becomes ready
+    GCond     *space_cond;      // signalled when a message is taken off a
+                                // subscription's queue
+    GQueue     ready;           // the subscription of each queued message,
+                                // in the order received.  Guarded by mutex.
+    int        quit;
+};
+
+typedef struct _lcm_dispatch_job_t {
+    lcm_subscription_t *h;          // referenced
+    lcm_retained_buf_t *retained;   // referenced
+    char *channel;
+} lcm_dispatch_job_t;
+
+// the message being handled by a dispatch thread, used by lcm_recv_buf_ref()
+typedef struct _lcm_worker_dispatch_t {
+    const lcm_recv_buf_t *rbuf;
+    lcm_retained_buf_t *retained;
+} lcm_worker_dispatch_t;
+
+static GStaticPrivate WORKER_DISPATCH_PKEY = G_STATIC_PRIVATE_INIT;
+
+// the calling thread's buffer, returned by lcm_get_encode_buffer()
+typedef struct _lcm_encode_buf_t {
+    void *data;
+    unsigned int size;
+} lcm_encode_buf_t;
+
+static GStaticPrivate ENCODE_BUF_PKEY = G_STATIC_PRIVATE_INIT;
+
+// a received message retained with lcm_recv_buf_ref()
+struct _lcm_retained_buf_t {
+    lcm_recv_buf_t rbuf;      // must be the first member
+    volatile gint refcount;
+    void *storage;            // block containing rbuf.data, freed with the buffer
 };
 
+typedef enum {
+    LCM_MATCH_LITERAL,  // the channel contains no special characters
+    LCM_MATCH_PREFIX,   // "PREFIX.*", where PREFIX is a literal
+    LCM_MATCH_REGEX,
+} lcm_match_type_t;
+
 struct _lcm_subscription_t {
     char             *channel;
     lcm_msg_handler_t  handler;
     void             *userdata;
     lcm_t* lcm;
-    GRegex * regex;
-    int callback_scheduled;
-    int marked_for_deletion;
+    lcm_match_type_t match_type;
+    int prefix_len;     // length of PREFIX, for LCM_MATCH_PREFIX
+    GRegex * regex;     // only compiled for LCM_MATCH_REGEX
+    uint64_t seqno;     // handlers of a channel are called in this order
+
+    // held by lcm->handlers_all, by every snapshot listing the handler, and
+    // by its messages waiting for a dispatch thread
+    volatile gint refcount;
+    volatile gint unsubscribed;
+    volatile gint dispatch_group;
 
     int max_num_queued_messages;
-    int num_queued_messages;
+    volatile gint num_queued_messages;
+    // messages handed to a dispatch thread but not handled yet, including
+    // the one being handled.  These count toward the queue capacity too.
+    volatile gint num_dispatch_queued;
+    uint64_t num_dropped_messages;
+
+    // Used while dispatch threads are enabled.  worker is only meaningful
+    // while num_dispatch_queued is nonzero, and the other fields are guarded
+    // by its mutex.
+    lcm_dispatch_worker_t *worker;
+    GQueue dispatch_queue;      // lcm_dispatch_job_t
+
+    lcm_queue_policy_t queue_policy;
+    uint64_t num_superseded_messages;
+    // LCM_QUEUE_KEEP_LATEST keeps the latest message of each channel.  For a
+    // subscription that can match several channels, latest_queued counts the
+    // messages of each channel still queued by the provider (channel name ->
+    // GINT_TO_POINTER (count)).  Guarded by latest_lock.
+    GStaticMutex latest_lock;
+    GHashTable *latest_queued;
+    // the job of each channel waiting in dispatch_queue, for
+    // LCM_QUEUE_KEEP_LATEST subscriptions.  Guarded by the worker's mutex.
+    GHashTable *latest_jobs;
+
+    int priority;
+    int64_t latency_budget;     // in microseconds, 0 if none
+    uint64_t num_stale_messages;
 };
 
 extern void lcm_udpm_provider_init (GPtrArray * providers);
@@ -122,10 +285,18 @@ lcm_create (const char *url)
     lcm->vtable = info->vtable;
     lcm->handlers_all = g_ptr_array_new();
     lcm->handlers_map = g_hash_table_new (g_str_hash, g_str_equal);
+    g_queue_init (&lcm->handlers_lru);
+    lcm->max_cached_channels = LCM_DEFAULT_MAX_CACHED_CHANNELS;
+    lcm->literal_subs = g_hash_table_new (g_str_hash, g_str_equal);
+    lcm->prefix_subs = g_hash_table_new (g_str_hash, g_str_equal);
+    lcm->regex_subs = g_ptr_array_new();
 
     g_static_rec_mutex_init (&lcm->mutex);
     g_static_rec_mutex_init (&lcm->handle_mutex);
 
+    // the provider may already subscribe, e.g. to test itself
+    lcm->default_max_num_queued_messages = 30;
+
     lcm->provider = info->vtable->create (lcm, network, args);
     lcm->in_handle = 0;
 
@@ -139,8 +310,6 @@ lcm_create (const char *url)
         return NULL;
     }
 
-    lcm->default_max_num_queued_messages = 30;
-
     return lcm;
 
 fail:
@@ -165,37 +334,122 @@ map_free_handlers_callback(gpointer _key, gpointer _value, gpointer _data)
     free(_key);
 }
 
+static void
+free_key_callback(gpointer _key, gpointer _value, gpointer _data)
+{
+    free(_key);
+}
+
 static void
 lcm_handler_free (lcm_subscription_t *h) 
 {
-    assert (!h->callback_scheduled);
-    g_regex_unref(h->regex);
+    if (h->regex)
+        g_regex_unref(h->regex);
+    if (h->latest_queued) {
+        g_hash_table_foreach(h->latest_queued, free_key_callback, NULL);
+        g_hash_table_destroy(h->latest_queued);
+    }
+    if (h->latest_jobs)
+        g_hash_table_destroy(h->latest_jobs);
+    g_static_mutex_free(&h->latest_lock);
     free (h->channel);
     memset (h, 0, sizeof (lcm_subscription_t));
     free (h);
 }
 
+static void
+lcm_handler_unref (lcm_subscription_t *h)
+{
+    if (g_atomic_int_dec_and_test (&h->refcount))
+        lcm_handler_free (h);
+}
+
+static lcm_handler_snapshot_t *
+handler_snapshot_new (int nhandlers)
+{
+    lcm_handler_snapshot_t *snapshot = (lcm_handler_snapshot_t *) malloc (
+            sizeof (lcm_handler_snapshot_t) +
+            nhandlers * sizeof (lcm_subscription_t *));
+    snapshot->refcount = 1;
+    snapshot->nhandlers = 0;
+    snapshot->max_priority = 0;
+    return snapshot;
+}
+
+// adds h to a snapshot being built.  Caller must hold lcm->mutex, which
+// guards h->priority.
+static void
+handler_snapshot_add (lcm_handler_snapshot_t *snapshot, lcm_subscription_t *h)
+{
+    g_atomic_int_inc (&h->refcount);
+    if (!snapshot->nhandlers || h->priority > snapshot->max_priority)
+        snapshot->max_priority = h->priority;
+    snapshot->handlers[snapshot->nhandlers++] = h;
+}
+
+static void
+handler_snapshot_unref (lcm_handler_snapshot_t *snapshot)
+{
+    if (!g_atomic_int_dec_and_test (&snapshot->refcount))
+        return;
+    for (int i = 0; i < snapshot->nhandlers; i++)
+        lcm_handler_unref (snapshot->handlers[i]);
+    free (snapshot);
+}
+
+static void
+enqueue_cache_entry_free(lcm_enqueue_cache_entry_t *entry)
+{
+    handler_snapshot_unref(entry->snapshot);
+    free(entry->channel);
+    free(entry);
+}
+
+static void
+channel_handlers_free(lcm_channel_handlers_t *entry)
+{
+    handler_snapshot_unref(entry->snapshot);
+    free(entry->channel);
+    free(entry);
+}
+
+static void
+map_free_channel_handlers_callback(gpointer _key, gpointer _value,
+        gpointer _data)
+{
+    channel_handlers_free((lcm_channel_handlers_t*) _value);
+}
+
+static void stop_dispatch_threads (lcm_t * lcm);
+
 void
 lcm_destroy (lcm_t * lcm)
 {
-    if (lcm->provider){
-        for (unsigned int i = 0; i < lcm->handlers_all->len; i++) {
-            // unsubscribe from all handlers
-            lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index(
-                    lcm->handlers_all, i);
-            lcm_unsubscribe(lcm, h);
-        }
+    // let the dispatch threads finish handling the messages given to them
+    stop_dispatch_threads (lcm);
+
+    // unsubscribe from all handlers
+    while (lcm->handlers_all->len) {
+        lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index(
+                lcm->handlers_all, 0);
+        lcm_unsubscribe(lcm, h);
+    }
+    if (lcm->provider)
         lcm->vtable->destroy (lcm->provider);
+    for (int i = 0; i < LCM_ENQUEUE_CACHE_SIZE; i++) {
+        if (lcm->enqueue_cache[i])
+            enqueue_cache_entry_free ((lcm_enqueue_cache_entry_t *)
+                    lcm->enqueue_cache[i]);
     }
-    g_hash_table_foreach (lcm->handlers_map, map_free_handlers_callback, NULL);
+    g_hash_table_foreach (lcm->handlers_map,
+            map_free_channel_handlers_callback, NULL);
     g_hash_table_destroy (lcm->handlers_map);
+    g_hash_table_foreach (lcm->literal_subs, map_free_handlers_callback, NULL);
+    g_hash_table_destroy (lcm->literal_subs);
+    g_hash_table_foreach (lcm->prefix_subs, map_free_handlers_callback, NULL);
+    g_hash_table_destroy (lcm->prefix_subs);
+    g_ptr_array_free(lcm->regex_subs, TRUE);
 
-    for (unsigned int i = 0; i < lcm->handlers_all->len; i++) {
-        lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index(
-                lcm->handlers_all, i);
-        h->callback_scheduled = 0; // XXX hack...
-        lcm_handler_free(h);
-    }
     g_ptr_array_free(lcm->handlers_all, TRUE);
 
     g_static_rec_mutex_free (&lcm->mutex);
@@ -244,6 +498,56 @@ lcm_handle_timeout (lcm_t *lcm, int timeout_milis)
   }
 }
 
+// returns 1 if fd is readable, 0 if timeout_millis elapsed first, or <0 on
+// error.  A negative timeout waits indefinitely.
+static int
+wait_readable (SOCKET fd, int timeout_millis)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+
+    struct timeval timeout;
+    timeout.tv_sec = timeout_millis / 1000;
+    timeout.tv_usec = (timeout_millis % 1000) * 1000;
+
+    return select(fd + 1, &fds, NULL, NULL,
+            timeout_millis < 0 ? NULL : &timeout);
+}
+
+int
+lcm_handle_batch (lcm_t *lcm, int max_msgs, int timeout_millis)
+{
+    if (!lcm->provider || !lcm->vtable->handle || max_msgs <= 0)
+        return -1;
+
+    SOCKET lcm_fd = lcm_get_fileno(lcm);
+    int select_result = wait_readable(lcm_fd, timeout_millis);
+    if (select_result <= 0)
+        return select_result;
+
+    int nhandled = 0;
+    g_static_rec_mutex_lock (&lcm->handle_mutex);
+    assert(!lcm->in_handle); // recursive calls to lcm_handle are not allowed
+    lcm->in_handle = 1;
+    if (lcm->vtable->handle_batch) {
+        nhandled = lcm->vtable->handle_batch (lcm->provider, max_msgs);
+    } else {
+        // dispatch one message at a time, for as long as more are available
+        do {
+            if (lcm->vtable->handle (lcm->provider) != 0) {
+                if (!nhandled)
+                    nhandled = -1;
+                break;
+            }
+            nhandled++;
+        } while (nhandled < max_msgs && wait_readable(lcm_fd, 0) > 0);
+    }
+    lcm->in_handle = 0;
+    g_static_rec_mutex_unlock (&lcm->handle_mutex);
+    return nhandled;
+}
+
 int
 lcm_get_fileno (lcm_t * lcm)
 {
@@ -253,6 +557,38 @@ lcm_get_fileno (lcm_t * lcm)
         return -1;
 }
 
+static void
+encode_buf_free (gpointer data)
+{
+    lcm_encode_buf_t *ebuf = (lcm_encode_buf_t *) data;
+    free (ebuf->data);
+    free (ebuf);
+}
+
+void *
+lcm_get_encode_buffer (unsigned int size)
+{
+    lcm_encode_buf_t *ebuf =
+        (lcm_encode_buf_t *) g_static_private_get (&ENCODE_BUF_PKEY);
+    if (!ebuf) {
+        ebuf = (lcm_encode_buf_t *) calloc (1, sizeof (lcm_encode_buf_t));
+        g_static_private_set (&ENCODE_BUF_PKEY, ebuf, encode_buf_free);
+    }
+    if (size > ebuf->size || !ebuf->data) {
+        // grow geometrically, so that messages of slowly increasing size do
+        // not cause a reallocation each time
+        unsigned int newsize = ebuf->size ? ebuf->size : 256;
+        while (newsize < size && newsize <= G_MAXUINT / 2)
+            newsize *= 2;
+        if (newsize < size)
+            newsize = size;
+        free (ebuf->data);
+        ebuf->data = malloc (newsize);
+        ebuf->size = ebuf->data ? newsize : 0;
+    }
+    return ebuf->data;
+}
+
 int
 lcm_publish (lcm_t *lcm, const char *channel, const void *data,
         unsigned int datalen)
@@ -263,10 +599,271 @@ lcm_publish (lcm_t *lcm, const char *channel, const void *data,
         return -1;
 }
 
+int
+lcm_channel_has_subscribers (lcm_t *lcm, const char *channel)
+{
+    if (lcm->provider && lcm->vtable->has_subscribers)
+        return lcm->vtable->has_subscribers (lcm->provider, channel);
+    return 1;
+}
+
+int
+lcm_publish_batch (lcm_t *lcm, const lcm_publish_entry_t *msgs, int nmsgs)
+{
+    if (!lcm->provider || !lcm->vtable->publish)
+        return -1;
+    if (nmsgs <= 0)
+        return 0;
+
+    if (lcm->vtable->publish_batch)
+        return lcm->vtable->publish_batch (lcm->provider, msgs, nmsgs);
+
+    for (int i = 0; i < nmsgs; i++) {
+        int status = lcm->vtable->publish (lcm->provider, msgs[i].channel,
+                msgs[i].data, msgs[i].datalen);
+        if (status != 0)
+            return -1;
+    }
+    return 0;
+}
+
 static int 
 is_handler_subscriber(lcm_subscription_t *h, const char *channel_name)
 {
-    return g_regex_match(h->regex, channel_name, (GRegexMatchFlags) 0, NULL);
+    switch (h->match_type) {
+    case LCM_MATCH_LITERAL:
+        return !strcmp(h->channel, channel_name);
+    case LCM_MATCH_PREFIX:
+        return !strncmp(h->channel, channel_name, h->prefix_len);
+    default:
+        return g_regex_match(h->regex, channel_name, (GRegexMatchFlags) 0,
+                NULL);
+    }
+}
+
+static int
+is_regex_special(char c)
+{
+    return strchr("\\^$.|?*+()[]{}", c) != NULL;
+}
+
+// decides how a subscription's channel pattern can be matched.  Most
+// subscriptions are to a single channel, or to all channels starting with
+// some prefix, which don't need a regex.
+static lcm_match_type_t
+classify_channel(const char *channel, int *prefix_len)
+{
+    int len = 0;
+    while (channel[len] && !is_regex_special(channel[len]))
+        len++;
+    if (!channel[len])
+        return LCM_MATCH_LITERAL;
+    if (!strcmp(channel + len, ".*") && len <= LCM_MAX_CHANNEL_NAME_LENGTH) {
+        *prefix_len = len;
+        return LCM_MATCH_PREFIX;
+    }
+    return LCM_MATCH_REGEX;
+}
+
+static void
+sub_index_add(GHashTable *index, const char *key, lcm_subscription_t *h)
+{
+    GPtrArray *subs = (GPtrArray*) g_hash_table_lookup(index, key);
+    if (!subs) {
+        subs = g_ptr_array_new();
+        g_hash_table_insert(index, strdup(key), subs);
+    }
+    g_ptr_array_add(subs, h);
+}
+
+static void
+sub_index_remove(GHashTable *index, const char *key, lcm_subscription_t *h)
+{
+    gpointer orig_key;
+    gpointer value;
+    if (!g_hash_table_lookup_extended(index, key, &orig_key, &value))
+        return;
+    GPtrArray *subs = (GPtrArray*) value;
+    g_ptr_array_remove(subs, h);
+    if (!subs->len) {
+        g_hash_table_remove(index, key);
+        g_ptr_array_free(subs, TRUE);
+        free(orig_key);
+    }
+}
+
+static void
+index_handler(lcm_t *lcm, lcm_subscription_t *h)
+{
+    if (h->match_type == LCM_MATCH_LITERAL) {
+        sub_index_add(lcm->literal_subs, h->channel, h);
+    } else if (h->match_type == LCM_MATCH_PREFIX) {
+        char prefix[LCM_MAX_CHANNEL_NAME_LENGTH+1];
+        memcpy(prefix, h->channel, h->prefix_len);
+        prefix[h->prefix_len] = 0;
+        sub_index_add(lcm->prefix_subs, prefix, h);
+        lcm->num_prefix_subs[h->prefix_len]++;
+    } else {
+        g_ptr_array_add(lcm->regex_subs, h);
+    }
+}
+
+static void
+unindex_handler(lcm_t *lcm, lcm_subscription_t *h)
+{
+    if (h->match_type == LCM_MATCH_LITERAL) {
+        sub_index_remove(lcm->literal_subs, h->channel, h);
+    } else if (h->match_type == LCM_MATCH_PREFIX) {
+        char prefix[LCM_MAX_CHANNEL_NAME_LENGTH+1];
+        memcpy(prefix, h->channel, h->prefix_len);
+        prefix[h->prefix_len] = 0;
+        sub_index_remove(lcm->prefix_subs, prefix, h);
+        lcm->num_prefix_subs[h->prefix_len]--;
+    } else {
+        g_ptr_array_remove(lcm->regex_subs, h);
+    }
+}
+
+static void
+append_handlers(GPtrArray *handlers, GPtrArray *subs)
+{
+    if (!subs)
+        return;
+    for (unsigned int i = 0; i < subs->len; i++)
+        g_ptr_array_add(handlers, g_ptr_array_index(subs, i));
+}
+
+static gint
+compare_handler_seqno(gconstpointer a, gconstpointer b)
+{
+    const lcm_subscription_t *ha = *(const lcm_subscription_t * const *) a;
+    const lcm_subscription_t *hb = *(const lcm_subscription_t * const *) b;
+    return ha->seqno < hb->seqno ? -1 : (ha->seqno > hb->seqno ? 1 : 0);
+}
+
+// builds the handler snapshot of a channel name that isn't cached
+static lcm_handler_snapshot_t *
+find_handlers(lcm_t *lcm, const char *channel)
+{
+    GPtrArray *handlers = g_ptr_array_new();
+    append_handlers(handlers,
+            (GPtrArray*) g_hash_table_lookup(lcm->literal_subs, channel));
+
+    // look up every prefix of the channel name that some handler subscribes
+    // to.  Channel names are short, so this is at most a few dozen lookups.
+    int channel_len = strlen(channel);
+    char prefix[LCM_MAX_CHANNEL_NAME_LENGTH+1];
+    for (int len = 0; len <= channel_len && len <= LCM_MAX_CHANNEL_NAME_LENGTH;
+            len++) {
+        if (!lcm->num_prefix_subs[len])
+            continue;
+        memcpy(prefix, channel, len);
+        prefix[len] = 0;
+        append_handlers(handlers,
+                (GPtrArray*) g_hash_table_lookup(lcm->prefix_subs, prefix));
+    }
+
+    for (unsigned int i = 0; i < lcm->regex_subs->len; i++) {
+        lcm_subscription_t *h =
+            (lcm_subscription_t *) g_ptr_array_index (lcm->regex_subs, i);
+        if (is_handler_subscriber (h, channel))
+            g_ptr_array_add(handlers, h);
+    }
+
+    // call the handlers in the order they subscribed
+    g_ptr_array_sort(handlers, compare_handler_seqno);
+
+    lcm_handler_snapshot_t *snapshot = handler_snapshot_new(handlers->len);
+    for (unsigned int i = 0; i < handlers->len; i++) {
+        handler_snapshot_add(snapshot,
+                (lcm_subscription_t *) g_ptr_array_index(handlers, i));
+    }
+    g_ptr_array_free(handlers, TRUE);
+    return snapshot;
+}
+
+// like find_handlers(), but only tells whether any handler subscribes to the
+// channel, without building a snapshot
+static int
+any_handlers(lcm_t *lcm, const char *channel)
+{
+    if (g_hash_table_lookup(lcm->literal_subs, channel))
+        return 1;
+
+    int channel_len = strlen(channel);
+    char prefix[LCM_MAX_CHANNEL_NAME_LENGTH+1];
+    for (int len = 0; len <= channel_len && len <= LCM_MAX_CHANNEL_NAME_LENGTH;
+            len++) {
+        if (!lcm->num_prefix_subs[len])
+            continue;
+        memcpy(prefix, channel, len);
+        prefix[len] = 0;
+        if (g_hash_table_lookup(lcm->prefix_subs, prefix))
+            return 1;
+    }
+
+    for (unsigned int i = 0; i < lcm->regex_subs->len; i++) {
+        lcm_subscription_t *h =
+            (lcm_subscription_t *) g_ptr_array_index (lcm->regex_subs, i);
+        if (is_handler_subscriber (h, channel))
+            return 1;
+    }
+    return 0;
+}
+
+// replaces a channel's snapshot with a copy that also lists h.  h subscribed
+// after all the other handlers, so it goes last.
+static void
+channel_handlers_add(lcm_channel_handlers_t *entry, lcm_subscription_t *h)
+{
+    lcm_handler_snapshot_t *old = entry->snapshot;
+    lcm_handler_snapshot_t *snapshot =
+        handler_snapshot_new(old->nhandlers + 1);
+    for (int i = 0; i < old->nhandlers; i++)
+        handler_snapshot_add(snapshot, old->handlers[i]);
+    handler_snapshot_add(snapshot, h);
+    entry->snapshot = snapshot;
+    handler_snapshot_unref(old);
+}
+
+// replaces a channel's snapshot with a copy that doesn't list h, if needed
+static void
+channel_handlers_remove(lcm_channel_handlers_t *entry, lcm_subscription_t *h)
+{
+    lcm_handler_snapshot_t *old = entry->snapshot;
+    int i;
+    for (i = 0; i < old->nhandlers && old->handlers[i] != h; i++);
+    if (i == old->nhandlers)
+        return;
+
+    lcm_handler_snapshot_t *snapshot =
+        handler_snapshot_new(old->nhandlers - 1);
+    for (i = 0; i < old->nhandlers; i++) {
+        if (old->handlers[i] != h)
+            handler_snapshot_add(snapshot, old->handlers[i]);
+    }
+    entry->snapshot = snapshot;
+    handler_snapshot_unref(old);
+}
+
+// replaces a channel's snapshot with a copy if it lists h, so that the copy
+// picks up h's new priority
+static void
+map_refresh_handler_callback(gpointer _key, gpointer _value, gpointer _data)
+{
+    lcm_subscription_t *h = (lcm_subscription_t*) _data;
+    lcm_channel_handlers_t *entry = (lcm_channel_handlers_t*) _value;
+    lcm_handler_snapshot_t *old = entry->snapshot;
+    int i;
+    for (i = 0; i < old->nhandlers && old->handlers[i] != h; i++);
+    if (i == old->nhandlers)
+        return;
+
+    lcm_handler_snapshot_t *snapshot = handler_snapshot_new(old->nhandlers);
+    for (i = 0; i < old->nhandlers; i++)
+        handler_snapshot_add(snapshot, old->handlers[i]);
+    entry->snapshot = snapshot;
+    handler_snapshot_unref(old);
 }
 
 // add the handler to any channel's handler list if its subscription matches
@@ -275,12 +872,12 @@ map_add_handler_callback(gpointer _key, gpointer _value, gpointer _data)
 {
     lcm_subscription_t *h = (lcm_subscription_t*) _data;
     char *channel_name = (char*) _key;
-    GPtrArray *handlers = (GPtrArray*) _value;
+    lcm_channel_handlers_t *entry = (lcm_channel_handlers_t*) _value;
 
     if (!is_handler_subscriber(h, channel_name))
         return;
     
-    g_ptr_array_add(handlers, h);
+    channel_handlers_add(entry, h);
 }
 
 // remove from a channel's handler list
@@ -289,8 +886,8 @@ map_remove_handler_callback(gpointer _key, gpointer _value,
         gpointer _data)
 {
     lcm_subscription_t *h = (lcm_subscription_t*) _data;
-    GPtrArray *handlers = (GPtrArray*) _value;
-    g_ptr_array_remove_fast(handlers, h);
+    lcm_channel_handlers_t *entry = (lcm_channel_handlers_t*) _value;
+    channel_handlers_remove(entry, h);
 }
 
 lcm_subscription_t
@@ -310,26 +907,45 @@ lcm_subscription_t
     h->channel = strdup(channel);
     h->handler = handler;
     h->userdata = userdata;
-    h->callback_scheduled = 0;
-    h->marked_for_deletion = 0;
+    h->refcount = 1;
+    h->unsubscribed = 0;
+    h->dispatch_group = -1;
     h->max_num_queued_messages = lcm->default_max_num_queued_messages;
     h->num_queued_messages = 0;
+    h->num_dropped_messages = 0;
+    g_static_mutex_init(&h->latest_lock);
     h->lcm = lcm;
 
-    char *regexbuf = g_strdup_printf("^%s$", channel);
-    GError *rerr = NULL;
-    h->regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
-    g_free(regexbuf);
-    if(rerr) {
-        fprintf(stderr, "%s: %s\n", __FUNCTION__, rerr->message);
-        dbg(DBG_LCM, "%s: %s\n", __FUNCTION__, rerr->message);
-        g_error_free(rerr);
-        free(h);
-        return NULL;
+    h->match_type = classify_channel(channel, &h->prefix_len);
+    if (h->match_type == LCM_MATCH_REGEX) {
+        char *regexbuf = g_strdup_printf("^%s$", channel);
+        GError *rerr = NULL;
+        h->regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+        g_free(regexbuf);
+        if(rerr) {
+            fprintf(stderr, "%s: %s\n", __FUNCTION__, rerr->message);
+            dbg(DBG_LCM, "%s: %s\n", __FUNCTION__, rerr->message);
+            g_error_free(rerr);
+            g_static_mutex_free(&h->latest_lock);
+            free(h->channel);
+            free(h);
+            return NULL;
+        }
     }
     g_static_rec_mutex_lock (&lcm->mutex);
+    h->seqno = lcm->next_sub_seqno++;
+    g_atomic_int_inc(&lcm->handlers_generation);
     g_ptr_array_add(lcm->handlers_all, h);
-    g_hash_table_foreach(lcm->handlers_map, map_add_handler_callback, h);
+    index_handler(lcm, h);
+    if (h->match_type == LCM_MATCH_LITERAL) {
+        // only one channel can match
+        lcm_channel_handlers_t *entry = (lcm_channel_handlers_t*)
+            g_hash_table_lookup(lcm->handlers_map, channel);
+        if (entry)
+            channel_handlers_add(entry, h);
+    } else {
+        g_hash_table_foreach(lcm->handlers_map, map_add_handler_callback, h);
+    }
     g_static_rec_mutex_unlock (&lcm->mutex);
 
     return h;
@@ -348,12 +964,23 @@ lcm_unsubscribe (lcm_t *lcm, lcm_subscription_t *h)
     }
 
     if (foundit) {
+        // a dispatch that already holds a snapshot listing the handler
+        // checks this before calling it
+        g_atomic_int_set(&h->unsubscribed, 1);
+        g_atomic_int_inc(&lcm->handlers_generation);
+        unindex_handler(lcm, h);
         // remove the handler from all the lists in the hash table
-        g_hash_table_foreach(lcm->handlers_map, map_remove_handler_callback, h);
-        if (!h->callback_scheduled)
-            lcm_handler_free (h);
-        else
-            h->marked_for_deletion = 1;
+        if (h->match_type == LCM_MATCH_LITERAL) {
+            lcm_channel_handlers_t *entry = (lcm_channel_handlers_t*)
+                g_hash_table_lookup(lcm->handlers_map, h->channel);
+            if (entry)
+                channel_handlers_remove(entry, h);
+        } else {
+            g_hash_table_foreach(lcm->handlers_map,
+                    map_remove_handler_callback, h);
+        }
+        // the handler is freed once no dispatch is using it
+        lcm_handler_unref (h);
     }
 
     g_static_rec_mutex_unlock (&lcm->mutex);
@@ -363,112 +990,734 @@ lcm_unsubscribe (lcm_t *lcm, lcm_subscription_t *h)
 
 /* ==== Internal API for Providers ==== */
 
-GPtrArray *
-lcm_get_handlers (lcm_t * lcm, const char * channel)
+// counts a message queued by the provider on one of the channels of an
+// LCM_QUEUE_KEEP_LATEST subscription
+static void
+latest_queued_inc (lcm_subscription_t *h, const char *channel)
 {
-    g_static_rec_mutex_lock (&lcm->mutex);
-    GPtrArray * handlers = (GPtrArray *) g_hash_table_lookup (lcm->handlers_map, channel);
-    if (handlers)
-        goto finished;
+    gpointer key;
+    gpointer value;
+    g_static_mutex_lock (&h->latest_lock);
+    if (!h->latest_queued)
+        h->latest_queued = g_hash_table_new (g_str_hash, g_str_equal);
+    if (g_hash_table_lookup_extended (h->latest_queued, channel, &key, &value))
+        g_hash_table_insert (h->latest_queued, key,
+                GINT_TO_POINTER (GPOINTER_TO_INT (value) + 1));
+    else
+        g_hash_table_insert (h->latest_queued, strdup (channel),
+                GINT_TO_POINTER (1));
+    g_static_mutex_unlock (&h->latest_lock);
+}
 
-    // if we haven't seen this channel name before, create a new list
+// takes a message of the channel off the count, if it was counted
+static void
+latest_queued_dec (lcm_subscription_t *h, const char *channel)
+{
+    gpointer key;
+    gpointer value;
+    g_static_mutex_lock (&h->latest_lock);
+    if (g_hash_table_lookup_extended (h->latest_queued, channel, &key,
+                &value)) {
+        int n = GPOINTER_TO_INT (value) - 1;
+        if (n > 0) {
+            g_hash_table_insert (h->latest_queued, key, GINT_TO_POINTER (n));
+        } else {
+            g_hash_table_remove (h->latest_queued, channel);
+            free (key);
+        }
+    }
+    g_static_mutex_unlock (&h->latest_lock);
+}
+
+// returns the number of messages of the channel queued by the provider
+static int
+latest_queued_count (lcm_subscription_t *h, const char *channel)
+{
+    int n = 0;
+    g_static_mutex_lock (&h->latest_lock);
+    if (h->latest_queued)
+        n = GPOINTER_TO_INT (g_hash_table_lookup (h->latest_queued, channel));
+    g_static_mutex_unlock (&h->latest_lock);
+    return n;
+}
+
+// evicts least recently used entries of handlers_map until at most
+// num_entries are left.  Caller must hold lcm->mutex.
+static void
+evict_channel_handlers (lcm_t * lcm, int num_entries)
+{
+    while ((int) lcm->handlers_lru.length > num_entries) {
+        lcm_channel_handlers_t *entry =
+            (lcm_channel_handlers_t*) g_queue_peek_head (&lcm->handlers_lru);
+        g_queue_unlink (&lcm->handlers_lru, &entry->lru_link);
+        g_hash_table_remove (lcm->handlers_map, entry->channel);
+        channel_handlers_free (entry);
+    }
+}
+
+// returns the handlers subscribed to a channel.  The snapshot is only valid
+// while the caller holds lcm->mutex, unless the caller takes a reference.
+static lcm_handler_snapshot_t *
+get_handler_snapshot (lcm_t * lcm, const char * channel)
+{
+    lcm_channel_handlers_t *entry = (lcm_channel_handlers_t*)
+        g_hash_table_lookup (lcm->handlers_map, channel);
+    if (entry) {
+        g_queue_unlink (&lcm->handlers_lru, &entry->lru_link);
+        g_queue_push_tail_link (&lcm->handlers_lru, &entry->lru_link);
+        return entry->snapshot;
+    }
+
+    // if we haven't seen this channel name recently, create a new list
     // of subscribed handlers.
-    handlers = g_ptr_array_new ();
-    // alloc channel name
-    g_hash_table_insert (lcm->handlers_map, strdup(channel), handlers);
+    if (lcm->max_cached_channels > 0)
+        evict_channel_handlers (lcm, lcm->max_cached_channels - 1);
+    entry = (lcm_channel_handlers_t*) calloc (1,
+            sizeof (lcm_channel_handlers_t));
+    entry->channel = strdup (channel);
+    entry->lru_link.data = entry;
+    g_queue_push_tail_link (&lcm->handlers_lru, &entry->lru_link);
+    g_hash_table_insert (lcm->handlers_map, entry->channel, entry);
 
     // find all the matching handlers
-    for (unsigned int i = 0; i < lcm->handlers_all->len; i++) {
-        lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index (lcm->handlers_all, i);
-        if (is_handler_subscriber (h, channel))
-            g_ptr_array_add(handlers, h);
-    }
+    entry->snapshot = find_handlers (lcm, channel);
+    return entry->snapshot;
+}
 
-finished:
+// takes the channel's entry out of lcm->enqueue_cache, looking up its current
+// snapshot if the entry is missing or stale.  The entry must be handed back
+// with enqueue_cache_put().
+static lcm_enqueue_cache_entry_t *
+enqueue_cache_take (lcm_t * lcm, const char * channel, guint slot)
+{
+    lcm_enqueue_cache_entry_t *entry;
+    do {
+        entry = (lcm_enqueue_cache_entry_t *)
+            g_atomic_pointer_get (&lcm->enqueue_cache[slot]);
+    } while (entry && !g_atomic_pointer_compare_and_exchange (
+                &lcm->enqueue_cache[slot], entry, NULL));
+
+    if (entry &&
+            entry->generation == g_atomic_int_get (&lcm->handlers_generation) &&
+            !strcmp (entry->channel, channel))
+        return entry;
+
+    if (entry) {
+        handler_snapshot_unref (entry->snapshot);
+        free (entry->channel);
+    } else {
+        entry = (lcm_enqueue_cache_entry_t *) malloc (
+                sizeof (lcm_enqueue_cache_entry_t));
+    }
+    g_static_rec_mutex_lock (&lcm->mutex);
+    entry->generation = g_atomic_int_get (&lcm->handlers_generation);
+    entry->snapshot = get_handler_snapshot (lcm, channel);
+    g_atomic_int_inc (&entry->snapshot->refcount);
     g_static_rec_mutex_unlock (&lcm->mutex);
-    return handlers;
+    entry->channel = strdup (channel);
+    return entry;
 }
 
-int
-lcm_try_enqueue_message(lcm_t* lcm, const char* channel)
+static void
+enqueue_cache_put (lcm_t * lcm, lcm_enqueue_cache_entry_t *entry, guint slot)
 {
+    // another thread may have filled the slot in the meantime
+    if (!g_atomic_pointer_compare_and_exchange (&lcm->enqueue_cache[slot],
+                NULL, entry))
+        enqueue_cache_entry_free (entry);
+}
+
+// returns a reference to the channel's current snapshot if lcm->enqueue_cache
+// holds it, or NULL.  Doesn't lock lcm->mutex.
+static lcm_handler_snapshot_t *
+enqueue_cache_peek (lcm_t * lcm, const char * channel)
+{
+    guint slot = g_str_hash (channel) % LCM_ENQUEUE_CACHE_SIZE;
+    lcm_enqueue_cache_entry_t *entry;
+    do {
+        entry = (lcm_enqueue_cache_entry_t *)
+            g_atomic_pointer_get (&lcm->enqueue_cache[slot]);
+    } while (entry && !g_atomic_pointer_compare_and_exchange (
+                &lcm->enqueue_cache[slot], entry, NULL));
+    if (!entry)
+        return NULL;
+
+    lcm_handler_snapshot_t *snapshot = NULL;
+    if (entry->generation == g_atomic_int_get (&lcm->handlers_generation) &&
+            !strcmp (entry->channel, channel)) {
+        snapshot = entry->snapshot;
+        g_atomic_int_inc (&snapshot->refcount);
+    }
+    enqueue_cache_put (lcm, entry, slot);
+    return snapshot;
+}
+
+// returns a reference to the channel's current snapshot.  Unlike
+// enqueue_cache_take (), neither lcm->enqueue_cache nor handlers_map gains an
+// entry for the channel, so looking up channels that are not being received
+// doesn't evict the ones that are.
+static lcm_handler_snapshot_t *
+peek_handler_snapshot (lcm_t * lcm, const char * channel)
+{
+    lcm_handler_snapshot_t *snapshot = enqueue_cache_peek (lcm, channel);
+    if (snapshot)
+        return snapshot;
+
     g_static_rec_mutex_lock (&lcm->mutex);
-    GPtrArray * handlers = lcm_get_handlers (lcm, channel);
+    lcm_channel_handlers_t *cached = (lcm_channel_handlers_t*)
+        g_hash_table_lookup (lcm->handlers_map, channel);
+    if (cached) {
+        snapshot = cached->snapshot;
+        g_atomic_int_inc (&snapshot->refcount);
+    } else {
+        snapshot = find_handlers (lcm, channel);
+    }
+    g_static_rec_mutex_unlock (&lcm->mutex);
+    return snapshot;
+}
+
+// counts a message as queued for each of the channel's subscriptions.  If
+// bounded, LCM_QUEUE_DROP_NEWEST subscriptions with a full queue turn it away.
+// Returns the number of subscriptions that kept the message.  Providers call
+// this for every message received, so lcm->mutex is only taken for channels
+// whose snapshot isn't cached, and to count dropped messages.
+static int
+enqueue_message (lcm_t* lcm, const char* channel, int bounded)
+{
+    guint slot = g_str_hash (channel) % LCM_ENQUEUE_CACHE_SIZE;
+    lcm_enqueue_cache_entry_t *entry = enqueue_cache_take (lcm, channel, slot);
+    lcm_handler_snapshot_t *snapshot = entry->snapshot;
     int num_keepers = 0;
-    for(unsigned int i=0; i<handlers->len; i++) {
-        lcm_subscription_t* h = (lcm_subscription_t*) g_ptr_array_index(handlers, i);
-        if(h->num_queued_messages <= h->max_num_queued_messages ||
+    for (int i = 0; i < snapshot->nhandlers; i++) {
+        lcm_subscription_t* h = snapshot->handlers[i];
+        // lcm_dispatch_handlers decrements the count concurrently, so it may
+        // be slightly stale here.  Only LCM_QUEUE_DROP_NEWEST subscriptions
+        // turn away new messages.  The others make room for them when
+        // dispatching.
+        if(g_atomic_int_get(&h->unsubscribed)) {
+            continue;
+        } else if(!bounded || h->queue_policy != LCM_QUEUE_DROP_NEWEST ||
+                g_atomic_int_get(&h->num_queued_messages) +
+                g_atomic_int_get(&h->num_dispatch_queued) <=
+                h->max_num_queued_messages ||
                 h->max_num_queued_messages <= 0) {
-            h->num_queued_messages++;
+            g_atomic_int_inc(&h->num_queued_messages);
+            if (h->queue_policy == LCM_QUEUE_KEEP_LATEST &&
+                    h->match_type != LCM_MATCH_LITERAL)
+                latest_queued_inc(h, channel);
             num_keepers++;
+        } else {
+            g_static_rec_mutex_lock (&lcm->mutex);
+            h->num_dropped_messages++;
+            lcm->num_queue_drops++;
+            g_static_rec_mutex_unlock (&lcm->mutex);
         }
     }
-    g_static_rec_mutex_unlock (&lcm->mutex);
-    return num_keepers > 0;
+    enqueue_cache_put (lcm, entry, slot);
+    return num_keepers;
+}
+
+int
+lcm_try_enqueue_message(lcm_t* lcm, const char* channel)
+{
+    return enqueue_message (lcm, channel, 1) > 0;
+}
+
+int
+lcm_enqueue_message(lcm_t* lcm, const char* channel)
+{
+    return enqueue_message (lcm, channel, 0) > 0;
 }
 
 int
 lcm_has_handlers (lcm_t * lcm, const char * channel)
 {
-    int has_handlers = 1;
+    // Publishers may call this for every message, so it leaves the caches
+    // alone, like peek_handler_snapshot (), and doesn't build a snapshot.
+    lcm_handler_snapshot_t *snapshot = enqueue_cache_peek (lcm, channel);
+    if (snapshot) {
+        int has_handlers = snapshot->nhandlers > 0;
+        handler_snapshot_unref (snapshot);
+        return has_handlers;
+    }
+
     g_static_rec_mutex_lock (&lcm->mutex);
-    GPtrArray * handlers = lcm_get_handlers (lcm, channel);
-    if (!handlers || !handlers->len)
-        has_handlers = 0;
+    lcm_channel_handlers_t *cached = (lcm_channel_handlers_t*)
+        g_hash_table_lookup (lcm->handlers_map, channel);
+    int has_handlers = cached ? cached->snapshot->nhandlers > 0 :
+        any_handlers (lcm, channel);
     g_static_rec_mutex_unlock (&lcm->mutex);
     return has_handlers;
 }
 
+char **
+lcm_get_subscribed_channels (lcm_t * lcm)
+{
+    g_static_rec_mutex_lock (&lcm->mutex);
+    GHashTable *seen = g_hash_table_new (g_str_hash, g_str_equal);
+    char **channels = (char **) g_malloc0 ((lcm->handlers_all->len + 1) *
+            sizeof (char *));
+    int n = 0;
+    for (unsigned int i = 0; i < lcm->handlers_all->len; i++) {
+        lcm_subscription_t *h =
+            (lcm_subscription_t *) g_ptr_array_index (lcm->handlers_all, i);
+        if (g_hash_table_lookup (seen, h->channel))
+            continue;
+        g_hash_table_insert (seen, h->channel, h->channel);
+        channels[n++] = g_strdup (h->channel);
+    }
+    g_hash_table_destroy (seen);
+    g_static_rec_mutex_unlock (&lcm->mutex);
+    return channels;
+}
+
 int
-lcm_dispatch_handlers (lcm_t * lcm, lcm_recv_buf_t * buf, const char *channel)
+lcm_has_priorities (lcm_t * lcm)
 {
+    return g_atomic_int_get (&lcm->priorities_used);
+}
+
+int
+lcm_select_by_priority (lcm_t * lcm, const char * const * channels, int n)
+{
+    // Providers call this for every message dispatched.  The channels were
+    // all looked up when they were received, so their snapshots are usually
+    // still in lcm->enqueue_cache.
+    int best_index = 0;
+    int best_priority = 0;
+    for (int i = 0; i < n; i++) {
+        // a channel has the highest priority of its subscriptions
+        lcm_handler_snapshot_t *snapshot =
+            peek_handler_snapshot (lcm, channels[i]);
+        int priority = snapshot->max_priority;
+        handler_snapshot_unref (snapshot);
+        if (i == 0 || priority > best_priority) {
+            best_index = i;
+            best_priority = priority;
+        }
+    }
+    return best_index;
+}
+
+static int64_t
+timestamp_now (void)
+{
+    GTimeVal tv;
+    g_get_current_time (&tv);
+    return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// checks a message against a subscription's latency budget just before its
+// handler is called, and counts it if it's too old.  *now is filled in the
+// first time the time is needed.
+static int
+message_is_stale (lcm_subscription_t *h, const lcm_recv_buf_t *buf,
+        int64_t *now)
+{
+    if (!h->latency_budget)
+        return 0;
+    if (!*now)
+        *now = timestamp_now ();
+    if (*now - buf->recv_utime <= h->latency_budget)
+        return 0;
+
+    lcm_t *lcm = h->lcm;
+    g_static_rec_mutex_lock (&lcm->mutex);
+    h->num_stale_messages++;
+    lcm->num_stale_drops++;
+    g_static_rec_mutex_unlock (&lcm->mutex);
+    return 1;
+}
+
+static void
+count_displaced_messages (lcm_subscription_t *h, int num_superseded,
+        int num_dropped)
+{
+    lcm_t *lcm = h->lcm;
     g_static_rec_mutex_lock (&lcm->mutex);
+    h->num_superseded_messages += num_superseded;
+    h->num_dropped_messages += num_dropped;
+    lcm->num_queue_drops += num_dropped;
+    g_static_rec_mutex_unlock (&lcm->mutex);
+}
 
-    GPtrArray * handlers = lcm_get_handlers (lcm, channel);
-
-    // ref the handlers to prevent them from being destroyed by an
-    // lcm_unsubscribe.  This guarantees that handlers 0-(nhandlers-1) will not
-    // be destroyed during the callbacks.  Store nhandlers in a local variable
-    // so that we don't iterate over handlers that are added during the
-    // callbacks.
-    int nhandlers = handlers->len;
-    for (int i = 0; i < nhandlers; i++) {
-        lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index(handlers, i);
-        h->callback_scheduled = 1;
-    }
-
-    // now, call the handlers.
-    for (int i = 0; i < nhandlers; i++) {
-        lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index(handlers, i);
-        if (!h->marked_for_deletion && h->num_queued_messages > 0) {
-            h->num_queued_messages--;
-            int depth = g_static_rec_mutex_unlock_full (&lcm->mutex);
-            h->handler (buf, channel, h->userdata);
-            g_static_rec_mutex_lock_full (&lcm->mutex, depth);
+// checks whether the message about to be handled has to make room for the
+// newer ones still queued by the provider: for LCM_QUEUE_KEEP_LATEST
+// subscriptions if there are any on the same channel, or for
+// LCM_QUEUE_DROP_OLDEST ones if they fill the queue.  If so, the message is
+// counted and should be skipped.
+static int
+message_is_displaced (lcm_subscription_t *h, const char *channel)
+{
+    int num_newer = g_atomic_int_get (&h->num_queued_messages);
+    if (h->queue_policy == LCM_QUEUE_KEEP_LATEST) {
+        // a literal subscription only has one channel to count
+        if (h->match_type != LCM_MATCH_LITERAL)
+            num_newer = latest_queued_count (h, channel);
+        if (num_newer > 0) {
+            count_displaced_messages (h, 1, 0);
+            return 1;
         }
+        return 0;
+    }
+    if (h->queue_policy == LCM_QUEUE_DROP_OLDEST &&
+            h->max_num_queued_messages > 0 &&
+            num_newer >= h->max_num_queued_messages) {
+        count_displaced_messages (h, 0, 1);
+        return 1;
     }
+    return 0;
+}
 
-    // unref the handlers and check if any should be deleted
-    GList *to_remove = NULL;
-    for (int i = 0; i < nhandlers; i++) {
-        lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index(handlers, i);
-        h->callback_scheduled = 0;
-        if (h->marked_for_deletion)
-            to_remove = g_list_prepend (to_remove, h);
-    }
-    // actually delete handlers marked for deletion
-    for (;to_remove; to_remove = g_list_delete_link (to_remove, to_remove)) {
-        lcm_subscription_t *h = (lcm_subscription_t *) to_remove->data;
-        g_ptr_array_remove (lcm->handlers_all, h);
-        g_hash_table_foreach (lcm->handlers_map, 
-                map_remove_handler_callback, h);
-        lcm_handler_free (h);
+// takes one message of the channel off a subscription's queue.  Returns 0 if
+// none was queued.
+static int
+dequeue_message (lcm_subscription_t *h, const char *channel)
+{
+    gint n;
+    do {
+        n = g_atomic_int_get (&h->num_queued_messages);
+        if (n <= 0)
+            return 0;
+    } while (!g_atomic_int_compare_and_exchange (&h->num_queued_messages,
+                n, n - 1));
+    // set by latest_queued_inc () before the message was queued
+    if (h->latest_queued)
+        latest_queued_dec (h, channel);
+    return 1;
+}
+
+static void
+run_dispatch_job (lcm_t * lcm, lcm_dispatch_job_t *job)
+{
+    lcm_subscription_t *h = job->h;
+
+    // handlers get a buffer that looks like it is being dispatched by
+    // lcm_handle (), so that lcm_recv_buf_ref () works on it
+    lcm_recv_buf_t rbuf = job->retained->rbuf;
+    rbuf.lcm = lcm;
+    lcm_worker_dispatch_t dispatch;
+    dispatch.rbuf = &rbuf;
+    dispatch.retained = job->retained;
+
+    int64_t now = 0;
+    if (!g_atomic_int_get (&h->unsubscribed) &&
+            !message_is_displaced (h, job->channel) &&
+            !message_is_stale (h, &rbuf, &now)) {
+        g_static_private_set (&WORKER_DISPATCH_PKEY, &dispatch, NULL);
+        h->handler (&rbuf, job->channel, h->userdata);
+        g_static_private_set (&WORKER_DISPATCH_PKEY, NULL, NULL);
     }
+}
+
+static void
+free_dispatch_job (lcm_dispatch_job_t *job)
+{
+    lcm_recv_buf_unref (&job->retained->rbuf);
+    lcm_handler_unref (job->h);
+    free (job->channel);
+    free (job);
+}
+
+// forgets the job of an LCM_QUEUE_KEEP_LATEST subscription once it leaves
+// dispatch_queue.  Caller must hold the worker's mutex.
+static void
+forget_latest_job (lcm_subscription_t *h, lcm_dispatch_job_t *job)
+{
+    if (h->latest_jobs &&
+            g_hash_table_lookup (h->latest_jobs, job->channel) == job)
+        g_hash_table_remove (h->latest_jobs, job->channel);
+}
+
+static gpointer
+dispatch_worker_main (gpointer user)
+{
+    lcm_dispatch_worker_t *worker = (lcm_dispatch_worker_t *) user;
+
+    g_mutex_lock (worker->mutex);
+    while (1) {
+        while (g_queue_is_empty (&worker->ready) && !worker->quit)
+            g_cond_wait (worker->cond, worker->mutex);
+        // finish the queued messages before quitting
+        if (g_queue_is_empty (&worker->ready))
+            break;
+
+        // handle the oldest message of the next subscription in line
+        lcm_subscription_t *h =
+            (lcm_subscription_t *) g_queue_pop_head (&worker->ready);
+        lcm_dispatch_job_t *job =
+            (lcm_dispatch_job_t *) g_queue_pop_head (&h->dispatch_queue);
+        forget_latest_job (h, job);
+        g_cond_broadcast (worker->space_cond);
+        g_mutex_unlock (worker->mutex);
+
+        run_dispatch_job (worker->lcm, job);
+
+        g_mutex_lock (worker->mutex);
+        // once this reaches zero, the subscription may be given to another
+        // worker
+        g_atomic_int_add (&h->num_dispatch_queued, -1);
+        g_mutex_unlock (worker->mutex);
+
+        free_dispatch_job (job);
+        g_mutex_lock (worker->mutex);
+    }
+    g_mutex_unlock (worker->mutex);
+    return NULL;
+}
+
+static void
+post_dispatch_job (lcm_t * lcm, lcm_subscription_t *h,
+        lcm_retained_buf_t *retained, const char *channel)
+{
+    lcm_dispatch_job_t *job =
+        (lcm_dispatch_job_t *) malloc (sizeof (lcm_dispatch_job_t));
+    g_atomic_int_inc (&h->refcount);
+    job->h = h;
+    g_atomic_int_inc (&retained->refcount);
+    job->retained = retained;
+    job->channel = strdup (channel);
+
+    // The subscriptions of a group share a worker, and are otherwise spread
+    // over the workers in the order they subscribed.  A subscription keeps
+    // its worker for as long as it has messages queued, so that they are
+    // handled in order.
+    if (!g_atomic_int_get (&h->num_dispatch_queued)) {
+        int dispatch_group = g_atomic_int_get (&h->dispatch_group);
+        uint64_t group = dispatch_group >= 0 ?
+            (uint64_t) dispatch_group : h->seqno;
+        h->worker = lcm->workers[group % lcm->num_workers];
+    }
+    lcm_dispatch_worker_t *worker = h->worker;
+
+    // apply the queue policy to the subscription's queue.  The message the
+    // handler is busy with is not counted.  Each message removed from the
+    // queue takes the subscription's oldest entry in worker->ready with it.
+    GQueue displaced = G_QUEUE_INIT;
+    lcm_queue_policy_t policy = h->queue_policy;
+    int capacity = h->max_num_queued_messages;
+    int num_superseded = 0;
+    int num_dropped = 0;
+    int num_removed = 0;
+    g_mutex_lock (worker->mutex);
+    switch (policy) {
+    case LCM_QUEUE_KEEP_LATEST: {
+        // the message takes the place of the one still queued on the same
+        // channel, if any
+        if (!h->latest_jobs)
+            h->latest_jobs = g_hash_table_new (g_str_hash, g_str_equal);
+        lcm_dispatch_job_t *queued = (lcm_dispatch_job_t *)
+            g_hash_table_lookup (h->latest_jobs, channel);
+        if (queued) {
+            lcm_retained_buf_t *older = queued->retained;
+            queued->retained = job->retained;
+            job->retained = older;
+            g_queue_push_tail (&displaced, job);
+            job = NULL;
+            num_superseded++;
+        }
+        break;
+    }
+    case LCM_QUEUE_DROP_OLDEST:
+        while (capacity > 0 && (int) h->dispatch_queue.length >= capacity) {
+            lcm_dispatch_job_t *oldest = (lcm_dispatch_job_t *)
+                g_queue_pop_head (&h->dispatch_queue);
+            forget_latest_job (h, oldest);
+            g_queue_push_tail (&displaced, oldest);
+            num_dropped++;
+            num_removed++;
+        }
+        break;
+    case LCM_QUEUE_BLOCK:
+        // wait for the dispatch thread to catch up
+        while (capacity > 0 && (int) h->dispatch_queue.length >= capacity)
+            g_cond_wait (worker->space_cond, worker->mutex);
+        break;
+    default:
+        if (capacity > 0 && (int) h->dispatch_queue.length >= capacity) {
+            g_queue_push_tail (&displaced, job);
+            job = NULL;
+            num_dropped++;
+        }
+        break;
+    }
+    for (int i = 0; i < num_removed; i++)
+        g_queue_remove (&worker->ready, h);
+    g_atomic_int_add (&h->num_dispatch_queued, -num_removed);
+    if (job) {
+        g_queue_push_tail (&h->dispatch_queue, job);
+        if (policy == LCM_QUEUE_KEEP_LATEST)
+            g_hash_table_insert (h->latest_jobs, job->channel, job);
+        g_queue_push_tail (&worker->ready, h);
+        g_atomic_int_inc (&h->num_dispatch_queued);
+        g_cond_signal (worker->cond);
+    }
+    g_mutex_unlock (worker->mutex);
+
+    if (num_superseded || num_dropped)
+        count_displaced_messages (h, num_superseded, num_dropped);
+    while (!g_queue_is_empty (&displaced))
+        free_dispatch_job ((lcm_dispatch_job_t *)
+                g_queue_pop_head (&displaced));
+}
+
+// waits for the dispatch threads to handle their queued messages, and
+// destroys them.  Caller must hold handle_mutex, or be lcm_destroy ().
+static void
+stop_dispatch_threads (lcm_t * lcm)
+{
+    for (int i = 0; i < lcm->num_workers; i++) {
+        lcm_dispatch_worker_t *worker = lcm->workers[i];
+        g_mutex_lock (worker->mutex);
+        worker->quit = 1;
+        g_cond_signal (worker->cond);
+        g_mutex_unlock (worker->mutex);
+        g_thread_join (worker->thread);
+        g_cond_free (worker->space_cond);
+        g_cond_free (worker->cond);
+        g_mutex_free (worker->mutex);
+        free (worker);
+    }
+    g_static_rec_mutex_lock (&lcm->mutex);
+    free (lcm->workers);
+    lcm->workers = NULL;
+    lcm->num_workers = 0;
     g_static_rec_mutex_unlock (&lcm->mutex);
+}
+
+int
+lcm_dispatch_handlers (lcm_t * lcm, lcm_recv_buf_t * buf, const char *channel)
+{
+    return lcm_dispatch_handlers_owned (lcm, buf, channel, NULL);
+}
+
+int
+lcm_dispatch_handlers_owned (lcm_t * lcm, lcm_recv_buf_t * buf,
+        const char *channel, void **storage)
+{
+    lcm->dispatch_rbuf = buf;
+    lcm->dispatch_storage = storage;
+    lcm->dispatch_retained = NULL;
+
+    // Hold on to the channel's current handler snapshot.  Handlers that are
+    // added or removed during the callbacks replace the snapshot rather than
+    // modifying it, and the handlers listed in it are not freed before it is
+    // released.  The channel was just enqueued, so the snapshot is usually
+    // found in lcm->enqueue_cache without locking lcm->mutex.
+    guint slot = g_str_hash (channel) % LCM_ENQUEUE_CACHE_SIZE;
+    lcm_enqueue_cache_entry_t *entry = enqueue_cache_take (lcm, channel, slot);
+    lcm_handler_snapshot_t *snapshot = entry->snapshot;
+    g_atomic_int_inc (&snapshot->refcount);
+    enqueue_cache_put (lcm, entry, slot);
+
+    if (lcm->num_workers) {
+        // hand the message over to the dispatch threads
+        lcm_retained_buf_t *retained = NULL;
+        for (int i = 0; i < snapshot->nhandlers; i++) {
+            lcm_subscription_t *h = snapshot->handlers[i];
+            if (g_atomic_int_get (&h->unsubscribed) ||
+                    !dequeue_message (h, channel) ||
+                    message_is_displaced (h, channel))
+                continue;
+            if (!retained)
+                retained = (lcm_retained_buf_t *) lcm_recv_buf_ref (buf);
+            post_dispatch_job (lcm, h, retained, channel);
+        }
+        if (retained)
+            lcm_recv_buf_unref (&retained->rbuf);
+    } else {
+        // now, call the handlers.
+        int64_t now = 0;
+        for (int i = 0; i < snapshot->nhandlers; i++) {
+            lcm_subscription_t *h = snapshot->handlers[i];
+            if (!g_atomic_int_get (&h->unsubscribed) &&
+                    dequeue_message (h, channel) &&
+                    !message_is_displaced (h, channel) &&
+                    !message_is_stale (h, buf, &now))
+                h->handler (buf, channel, h->userdata);
+        }
+    }
+
+    handler_snapshot_unref (snapshot);
+
+    // release the reference held on behalf of the dispatch, if a handler
+    // retained the message
+    if (lcm->dispatch_retained)
+        lcm_recv_buf_unref (&lcm->dispatch_retained->rbuf);
+    lcm->dispatch_rbuf = NULL;
+    lcm->dispatch_storage = NULL;
+    lcm->dispatch_retained = NULL;
 
     return 0;
 }
 
+lcm_recv_buf_t *
+lcm_recv_buf_ref (const lcm_recv_buf_t *rbuf)
+{
+    if (!rbuf)
+        return NULL;
+
+    // buffers that were already retained have no lcm_t
+    if (!rbuf->lcm) {
+        lcm_retained_buf_t *retained = (lcm_retained_buf_t *) rbuf;
+        g_atomic_int_inc (&retained->refcount);
+        return &retained->rbuf;
+    }
+
+    // messages handled by a dispatch thread are already retained
+    lcm_worker_dispatch_t *worker_dispatch = (lcm_worker_dispatch_t *)
+        g_static_private_get (&WORKER_DISPATCH_PKEY);
+    if (worker_dispatch && rbuf == worker_dispatch->rbuf) {
+        g_atomic_int_inc (&worker_dispatch->retained->refcount);
+        return &worker_dispatch->retained->rbuf;
+    }
+
+    lcm_t *lcm = rbuf->lcm;
+    if (rbuf != lcm->dispatch_rbuf) {
+        fprintf (stderr, "lcm_recv_buf_ref: buffer is not being dispatched\n");
+        return NULL;
+    }
+
+    lcm_retained_buf_t *retained = lcm->dispatch_retained;
+    if (retained) {
+        // another handler already retained this message
+        g_atomic_int_inc (&retained->refcount);
+        return &retained->rbuf;
+    }
+
+    retained = (lcm_retained_buf_t *) malloc (sizeof (lcm_retained_buf_t));
+    retained->rbuf = *rbuf;
+    retained->rbuf.lcm = NULL;
+    if (lcm->dispatch_storage && *lcm->dispatch_storage) {
+        // take over the provider's buffer.  The remaining handlers keep
+        // reading from it, so the dispatch holds a reference until they are
+        // done.
+        retained->storage = *lcm->dispatch_storage;
+        *lcm->dispatch_storage = NULL;
+    } else {
+        retained->storage = malloc (rbuf->data_size ? rbuf->data_size : 1);
+        memcpy (retained->storage, rbuf->data, rbuf->data_size);
+        retained->rbuf.data = retained->storage;
+    }
+    // one reference for the caller, and one for the dispatch
+    retained->refcount = 2;
+    lcm->dispatch_retained = retained;
+    return &retained->rbuf;
+}
+
+void
+lcm_recv_buf_unref (lcm_recv_buf_t *rbuf)
+{
+    if (!rbuf)
+        return;
+    assert (!rbuf->lcm); // only retained buffers can be released
+    lcm_retained_buf_t *retained = (lcm_retained_buf_t *) rbuf;
+    if (g_atomic_int_dec_and_test (&retained->refcount)) {
+        free (retained->storage);
+        free (retained);
+    }
+}
+
 int
 lcm_parse_url (const char * url, char ** provider, char ** network,
         GHashTable * args)
@@ -524,3 +1773,130 @@ lcm_subscription_set_queue_capacity(lcm_subscription_t* subs, int num_messages)
     g_static_rec_mutex_unlock(&subs->lcm->mutex);
     return 0;
 }
+
+int
+lcm_subscription_set_queue_policy(lcm_subscription_t* subs,
+        lcm_queue_policy_t policy)
+{
+    if (policy < LCM_QUEUE_DROP_NEWEST || policy > LCM_QUEUE_BLOCK)
+        return -1;
+    g_static_rec_mutex_lock(&subs->lcm->mutex);
+    subs->queue_policy = policy;
+    g_static_rec_mutex_unlock(&subs->lcm->mutex);
+    return 0;
+}
+
+int
+lcm_subscription_set_priority(lcm_subscription_t* subs, int priority)
+{
+    lcm_t *lcm = subs->lcm;
+    g_static_rec_mutex_lock(&lcm->mutex);
+    subs->priority = priority;
+    if (priority)
+        g_atomic_int_set(&lcm->priorities_used, 1);
+    // the snapshots listing the subscription hold its old priority
+    g_atomic_int_inc(&lcm->handlers_generation);
+    g_hash_table_foreach(lcm->handlers_map, map_refresh_handler_callback,
+            subs);
+    g_static_rec_mutex_unlock(&lcm->mutex);
+    return 0;
+}
+
+int
+lcm_subscription_set_latency_budget(lcm_subscription_t* subs,
+        int64_t budget_usec)
+{
+    if (budget_usec < 0)
+        return -1;
+    g_static_rec_mutex_lock(&subs->lcm->mutex);
+    subs->latency_budget = budget_usec;
+    g_static_rec_mutex_unlock(&subs->lcm->mutex);
+    return 0;
+}
+
+int
+lcm_subscription_get_stats(lcm_subscription_t* subs,
+        lcm_subscription_stats_t* stats)
+{
+    g_static_rec_mutex_lock(&subs->lcm->mutex);
+    stats->dispatch_queue_depth = g_atomic_int_get(&subs->num_dispatch_queued);
+    stats->queue_depth = g_atomic_int_get(&subs->num_queued_messages) +
+        stats->dispatch_queue_depth;
+    stats->queue_capacity = subs->max_num_queued_messages;
+    stats->queue_drops = subs->num_dropped_messages;
+    stats->stale_drops = subs->num_stale_messages;
+    stats->superseded = subs->num_superseded_messages;
+    g_static_rec_mutex_unlock(&subs->lcm->mutex);
+    return 0;
+}
+
+int
+lcm_get_stats(lcm_t *lcm, lcm_stats_t *stats)
+{
+    memset(stats, 0, sizeof(lcm_stats_t));
+    if (lcm->provider && lcm->vtable->get_stats)
+        lcm->vtable->get_stats(lcm->provider, stats);
+
+    g_static_rec_mutex_lock(&lcm->mutex);
+    stats->queue_drops = lcm->num_queue_drops;
+    stats->stale_drops = lcm->num_stale_drops;
+    g_static_rec_mutex_unlock(&lcm->mutex);
+    return 0;
+}
+
+int
+lcm_set_max_cached_channels(lcm_t *lcm, int num_channels)
+{
+    g_static_rec_mutex_lock(&lcm->mutex);
+    lcm->max_cached_channels = num_channels;
+    if (num_channels > 0)
+        evict_channel_handlers(lcm, num_channels);
+    g_static_rec_mutex_unlock(&lcm->mutex);
+    return 0;
+}
+
+int
+lcm_set_dispatch_threads(lcm_t *lcm, int num_threads)
+{
+    if (num_threads < 0)
+        return -1;
+
+    // no messages are dispatched while the threads are replaced
+    g_static_rec_mutex_lock(&lcm->handle_mutex);
+    stop_dispatch_threads(lcm);
+
+    lcm_dispatch_worker_t **workers = NULL;
+    if (num_threads > 0) {
+        workers = (lcm_dispatch_worker_t **) calloc(num_threads,
+                sizeof(lcm_dispatch_worker_t *));
+    }
+    for (int i = 0; i < num_threads; i++) {
+        lcm_dispatch_worker_t *worker =
+            (lcm_dispatch_worker_t *) calloc(1, sizeof(lcm_dispatch_worker_t));
+        worker->lcm = lcm;
+        worker->mutex = g_mutex_new();
+        worker->cond = g_cond_new();
+        worker->space_cond = g_cond_new();
+        g_queue_init(&worker->ready);
+        worker->thread = g_thread_create(dispatch_worker_main, worker, TRUE,
+                NULL);
+        workers[i] = worker;
+    }
+
+    g_static_rec_mutex_lock(&lcm->mutex);
+    lcm->workers = workers;
+    lcm->num_workers = num_threads;
+    g_static_rec_mutex_unlock(&lcm->mutex);
+
+    g_static_rec_mutex_unlock(&lcm->handle_mutex);
+    return 0;
+}
+
+int
+lcm_subscription_set_dispatch_group(lcm_subscription_t* subs, int group)
+{
+    if (group < 0)
+        return -1;
+    g_atomic_int_set(&subs->dispatch_group, group);
+    return 0;
+}
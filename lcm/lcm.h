@@ -78,6 +78,26 @@ struct _lcm_recv_buf_t
     lcm_t *lcm;
 };
 
+/**
+ * Describes one message to be transmitted by lcm_publish_batch().
+ */
+typedef struct _lcm_publish_entry_t lcm_publish_entry_t;
+struct _lcm_publish_entry_t
+{
+    /**
+     * the channel to publish on
+     */
+    const char *channel;
+    /**
+     * the raw byte buffer
+     */
+    const void *data;
+    /**
+     * size of the byte buffer
+     */
+    unsigned int datalen;
+};
+
 /**
  * @brief Callback function prototype.
  *
@@ -119,6 +139,45 @@ typedef void (*lcm_msg_handler_t) (const lcm_recv_buf_t *rbuf,
          ttl = N
              time to live of transmitted packets.  Default 0
 
+         recv_batch = N
+             maximum number of packets read from the socket with a single
+             system call, using recvmmsg().  Reduces per-packet overhead at
+             high packet rates.  Only supported on Linux.  Default 1, at most
+             1024
+
+         send_batch = 0 | 1
+             if 1, transmit the fragments of a large message, and the
+             messages passed to lcm_publish_batch(), with as few system calls
+             as possible using sendmmsg().  Only supported on Linux.
+             Default 1
+
+         ringbuf_slab_size = N
+             received packets are stored in a buffer made of N byte slabs.
+             The buffer grows one slab at a time as needed.  Default 204800,
+             at least 131072
+
+         ringbuf_low_watermark = N
+             number of bytes of empty slabs kept for reuse once a burst of
+             packets has been handled.  Default 819200
+
+         ringbuf_high_watermark = N
+             maximum size of the receive buffer, in bytes.  Packets that
+             arrive while the buffer is full are dropped.  Default 0 (no
+             limit)
+
+         ringbuf_hugepages = 0 | 1
+             if 1, back the receive buffer with huge pages.  Slabs are then
+             rounded up to 2 MB.  Only supported on Linux.  Default 0
+
+         interest = 0 | 1
+             if 1, periodically advertise this instance's subscriptions on
+             the LCM_INTEREST channel, and do not transmit messages on
+             channels that nobody has advertised.  The instance starts
+             listening for advertisements when it is created, and transmits
+             everything for the first 1.5 seconds.  Every process using the multicast group must
+             enable this option, or its subscriptions will not be seen.
+             Default 0
+
      examples:
          "udpm://239.255.76.67:7667"
              Default initialization string
@@ -259,6 +318,55 @@ lcm_subscription_t *lcm_subscribe (lcm_t *lcm, const char *channel,
 LCM_API_FUNCTION
 int lcm_unsubscribe (lcm_t *lcm, lcm_subscription_t *handler);
 
+/**
+ * @brief Limits how many channel names the handlers are cached for.
+ *
+ * The first time a message arrives on a channel name, the subscriptions that
+ * match it are looked up and cached, so that later messages on that channel
+ * are dispatched quickly.  Once the cache is full, the channel name that
+ * received a message least recently is evicted.  Applications that see many
+ * short-lived channel names can use this to bound the memory used by the
+ * cache, and the time taken by lcm_subscribe() and lcm_unsubscribe() to
+ * update it.
+ *
+ * @param lcm the %LCM object
+ * @param num_channels the maximum number of cached channel names.  The
+ *        default is 1024.  A value of 0 indicates no limit.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_API_FUNCTION
+int lcm_set_max_cached_channels (lcm_t *lcm, int num_channels);
+
+/**
+ * @brief Calls the subscription handlers from a pool of dispatch threads.
+ *
+ * By default, handlers are called by the thread calling lcm_handle().  Once
+ * dispatch threads are started, lcm_handle() instead queues each received
+ * message for the dispatch thread assigned to each subscription that matches
+ * it, and returns without waiting for the handlers.  Every subscription is
+ * bound to a single dispatch thread, so its handler is called for one message
+ * at a time, in the order the messages were received.  Handlers of different
+ * subscriptions may run concurrently.
+ *
+ * Each subscription has its own queue of messages waiting for its dispatch
+ * thread, bounded by its queue capacity and queue policy (see
+ * lcm_subscription_set_queue_capacity() and
+ * lcm_subscription_set_queue_policy()).
+ *
+ * This function waits for the current dispatch threads to handle the messages
+ * queued for them before replacing them, and must not be called from a
+ * handler.
+ *
+ * @param lcm the %LCM object
+ * @param num_threads the number of dispatch threads.  The default, 0, calls
+ *        the handlers from lcm_handle().
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_API_FUNCTION
+int lcm_set_dispatch_threads (lcm_t *lcm, int num_threads);
+
 /**
  * @brief Publish a message, specified as a raw byte buffer.
  *
@@ -278,6 +386,63 @@ LCM_API_FUNCTION
 int lcm_publish (lcm_t *lcm, const char *channel, const void *data,
         unsigned int datalen);
 
+/**
+ * @brief Returns a buffer for encoding a message before publishing it.
+ *
+ * The buffer belongs to the calling thread, and is reused by its next call to
+ * this function, so the message-specific publish functions generated by
+ * @c lcm-gen do not allocate memory once the buffer is large enough.  The
+ * buffer grows as needed, and is freed when the thread exits.  lcm_publish()
+ * does not use it.
+ *
+ * @param size the number of bytes needed.
+ *
+ * @return a buffer of at least @c size bytes, or NULL if it could not be
+ * allocated.
+ */
+LCM_API_FUNCTION
+void *lcm_get_encode_buffer (unsigned int size);
+
+/**
+ * @brief Checks whether a message published on a channel could be received.
+ *
+ * Lets publishers skip encoding messages that nobody would receive.  The
+ * answer depends on what the provider knows: memq checks the subscriptions
+ * of the %LCM object itself, and udpm checks the subscriptions advertised by
+ * other processes when the @c interest option is enabled.  Other providers
+ * always report subscribers.
+ *
+ * The message-specific publish functions generated by @c lcm-gen call this
+ * function before encoding the message.
+ *
+ * @param lcm      The %LCM object
+ * @param channel  The channel name
+ *
+ * @return 0 if a message published on @c channel would certainly not be
+ * received, nonzero otherwise.
+ */
+LCM_API_FUNCTION
+int lcm_channel_has_subscribers (lcm_t *lcm, const char *channel);
+
+/**
+ * @brief Publish several messages at once, specified as raw byte buffers.
+ *
+ * The messages are transmitted in order, as if by calling lcm_publish() on
+ * each of them.  Providers that support it (e.g., udpm on Linux) transmit
+ * the whole batch with as few system calls as possible, which greatly
+ * improves throughput when publishing bursts of small messages.
+ *
+ * @param lcm      The %LCM object
+ * @param msgs     The messages to publish
+ * @param nmsgs    Number of entries in @c msgs
+ *
+ * @return 0 on success, -1 on failure.  On failure, some of the messages may
+ * have been transmitted.
+ */
+LCM_API_FUNCTION
+int lcm_publish_batch (lcm_t *lcm, const lcm_publish_entry_t *msgs,
+        int nmsgs);
+
 /**
  * @brief Wait for and dispatch the next incoming message.
  *
@@ -323,6 +488,66 @@ int lcm_handle (lcm_t *lcm);
 LCM_API_FUNCTION
 int lcm_handle_timeout (lcm_t *lcm, int timeout_millis);
 
+/**
+ * @brief Wait for and dispatch up to @p max_msgs incoming messages.
+ *
+ * This function waits for a message like lcm_handle_timeout(), and then
+ * dispatches every message that is already queued, up to @p max_msgs of them,
+ * before returning.  Draining a backlog this way is much cheaper than calling
+ * lcm_handle() once per message, and lets an application catch up after it
+ * has been stalled.
+ *
+ * The same restrictions as for lcm_handle() apply.
+ *
+ * @param lcm the %LCM object
+ * @param max_msgs the maximum number of messages to dispatch.  Must be
+ *        positive.
+ * @param timeout_millis the maximum amount of time to wait for the first
+ *        message, in milliseconds.  If 0, then dispatches any available
+ *        messages and then returns immediately.  If negative, waits
+ *        indefinitely.
+ *
+ * @return the number of messages handled, 0 if the function timed out, and <0
+ * if an error occured.
+ */
+LCM_API_FUNCTION
+int lcm_handle_batch (lcm_t *lcm, int max_msgs, int timeout_millis);
+
+/**
+ * @brief Retain a received message beyond the end of a message handler.
+ *
+ * Normally, the buffer passed to a message handler is only valid until the
+ * handler returns.  Calling this function from within the handler returns a
+ * buffer with the same contents that remains valid until it is released with
+ * lcm_recv_buf_unref().  This lets an application hold on to a message (e.g.,
+ * to queue it for another thread) without copying it.
+ *
+ * Large messages received by the udpm provider, and messages published with
+ * the memq provider, are retained without copying their payload.  Otherwise,
+ * the payload is copied once, no matter how many handlers retain it.
+ *
+ * The returned buffer can be passed to lcm_recv_buf_ref() again from any
+ * thread to add a reference.  Its @c lcm field is NULL, and it remains valid
+ * after the %LCM object is destroyed.
+ *
+ * @param rbuf the buffer passed to the currently running message handler, or
+ *        a buffer previously returned by this function.
+ *
+ * @return a retained buffer, or NULL if @c rbuf cannot be retained (e.g.,
+ * because its handler has already returned).
+ */
+LCM_API_FUNCTION
+lcm_recv_buf_t * lcm_recv_buf_ref (const lcm_recv_buf_t *rbuf);
+
+/**
+ * @brief Release a buffer retained with lcm_recv_buf_ref().
+ *
+ * The buffer is freed when its last reference is released.  This function may
+ * be called from any thread.
+ */
+LCM_API_FUNCTION
+void lcm_recv_buf_unref (lcm_recv_buf_t *rbuf);
+
 /**
  * @brief Adjusts the maximum number of received messages that can be queued up
  * for a subscription.
@@ -344,6 +569,248 @@ int lcm_handle_timeout (lcm_t *lcm, int timeout_millis);
 LCM_API_FUNCTION
 int lcm_subscription_set_queue_capacity(lcm_subscription_t* handler, int num_messages);
 
+/**
+ * @brief What a subscription does with received messages it cannot keep up
+ * with, see lcm_subscription_set_queue_policy().
+ */
+typedef enum {
+    /**
+     * Once the queue is full, newly received messages are dropped.  This is
+     * the default.
+     */
+    LCM_QUEUE_DROP_NEWEST = 0,
+    /**
+     * Only the most recent message of each channel is handled.  Newly
+     * received messages are always queued, and older messages on the same
+     * channel still waiting to be handled are skipped without calling the
+     * handler, so they are never decoded.  Suited to state-like channels,
+     * where a slow handler should always see the freshest data.  The queue
+     * capacity is ignored.
+     *
+     * A subscription that matches several channels keeps the most recent
+     * message of each of them.
+     */
+    LCM_QUEUE_KEEP_LATEST,
+    /**
+     * Once the queue is full, the oldest queued message is dropped to make
+     * room for the new one.
+     */
+    LCM_QUEUE_DROP_OLDEST,
+    /**
+     * Once the queue is full, dispatching waits for the handler to catch up
+     * instead of dropping messages.  This only applies to the queue of a
+     * dispatch thread (see lcm_set_dispatch_threads()), and holds up every
+     * subscription.  Otherwise, received messages wait in the provider's
+     * queue, and are only dropped if that fills up.
+     */
+    LCM_QUEUE_BLOCK
+} lcm_queue_policy_t;
+
+/**
+ * @brief Sets the queue policy of a subscription.
+ *
+ * The policy decides which messages are dropped once more messages are
+ * waiting for the subscription than its queue capacity allows (see
+ * lcm_subscription_set_queue_capacity()).  With dispatch threads, each
+ * subscription has a queue of its own, so that a slow handler only causes
+ * its own subscription to drop messages.  Without them, the messages wait in
+ * the provider's receive queue, and each subscription only keeps count of
+ * how many of them are its own.  The policy is then applied as they are
+ * dispatched.
+ *
+ * @param handler the subscription object
+ * @param policy the new policy.  The default is LCM_QUEUE_DROP_NEWEST.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_API_FUNCTION
+int lcm_subscription_set_queue_policy(lcm_subscription_t* handler,
+        lcm_queue_policy_t policy);
+
+/**
+ * @brief Binds a subscription to a dispatch thread group.
+ *
+ * Only used when dispatch threads are enabled with lcm_set_dispatch_threads().
+ * Subscriptions in the same group are handled by the same dispatch thread, so
+ * their handlers are never called concurrently, and are called in the order
+ * the messages were received.  By default, each subscription is assigned a
+ * dispatch thread on its own.
+ *
+ * @param handler the subscription object
+ * @param group a non-negative group number
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_API_FUNCTION
+int lcm_subscription_set_dispatch_group(lcm_subscription_t* handler, int group);
+
+/**
+ * @brief Sets the priority of a subscription.
+ *
+ * When received messages back up faster than they are handled, messages on
+ * channels with higher priority subscriptions are dispatched ahead of the
+ * others.  A channel has the highest priority of the subscriptions matching
+ * it.  Messages of equal priority are dispatched in the order received.
+ *
+ * Messages are only reordered within a short window at the head of the
+ * receive queue, and only by providers that hold such a queue (currently
+ * udpm and memq).
+ *
+ * @param handler the subscription object
+ * @param priority the priority.  The default is 0, and higher values are
+ *        dispatched first.  Negative values are allowed.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_API_FUNCTION
+int lcm_subscription_set_priority(lcm_subscription_t* handler, int priority);
+
+/**
+ * @brief Sets how old a message can get before the subscription drops it.
+ *
+ * Just before the handler would be called, the age of the message is measured
+ * from its @c recv_utime.  If it exceeds the budget, the handler is skipped
+ * and the message is counted in the @c stale_drops statistics.  Use this on
+ * subscriptions for which late data is worse than no data, so that a backlog
+ * is cleared quickly instead of being handled in full.
+ *
+ * @param handler the subscription object
+ * @param budget_usec the maximum age, in microseconds.  The default, 0,
+ *        never drops messages.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_API_FUNCTION
+int lcm_subscription_set_latency_budget(lcm_subscription_t* handler,
+        int64_t budget_usec);
+
+/**
+ * @brief Receive statistics for a subscription, see lcm_subscription_get_stats().
+ */
+typedef struct _lcm_subscription_stats_t {
+    /**
+     * Number of received messages waiting to be dispatched to the subscription.
+     */
+    int queue_depth;
+    /**
+     * Number of the queued messages that were handed to the subscription's
+     * dispatch thread, including the one being handled.  Always 0 unless
+     * lcm_set_dispatch_threads() is used.
+     */
+    int dispatch_queue_depth;
+    /**
+     * Maximum number of queued messages, as set by
+     * lcm_subscription_set_queue_capacity().
+     */
+    int queue_capacity;
+    /**
+     * Number of received messages dropped because the queue was full.
+     */
+    uint64_t queue_drops;
+    /**
+     * Number of messages dropped because they exceeded the latency budget set
+     * with lcm_subscription_set_latency_budget().
+     */
+    uint64_t stale_drops;
+    /**
+     * Number of messages skipped in favor of a newer one, for subscriptions
+     * using LCM_QUEUE_KEEP_LATEST.
+     */
+    uint64_t superseded;
+} lcm_subscription_stats_t;
+
+/**
+ * @brief Retrieves the receive statistics of a subscription.
+ *
+ * @param handler the subscription object
+ * @param stats filled in with the statistics
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_API_FUNCTION
+int lcm_subscription_get_stats(lcm_subscription_t* handler,
+        lcm_subscription_stats_t* stats);
+
+/**
+ * @brief Receive statistics for an %LCM instance, see lcm_get_stats().
+ *
+ * All counters are cumulative since the %LCM instance was created.  Counters
+ * that do not apply to the provider in use are always 0.
+ */
+typedef struct _lcm_stats_t {
+    /**
+     * Number of datagrams (or stream messages) read from the network.
+     */
+    uint64_t packets_received;
+    /**
+     * Total size of the datagrams read from the network, in bytes.
+     */
+    uint64_t bytes_received;
+    /**
+     * Number of datagrams discarded because they were malformed or did not
+     * fit with the other fragments of their message.
+     */
+    uint64_t packets_bad;
+    /**
+     * Number of fragmented messages abandoned before all of their fragments
+     * arrived.  A partially received message is abandoned when newer
+     * fragmented messages need its reassembly buffer.
+     */
+    uint64_t fragment_timeouts;
+    /**
+     * Number of datagrams dropped by the operating system because the socket
+     * receive buffer was full.  Only reported on Linux.
+     */
+    uint64_t kernel_drops;
+    /**
+     * Number of datagrams dropped because the receive buffer had reached its
+     * high watermark (see the @c ringbuf_high_watermark option).
+     */
+    uint64_t ringbuf_drops;
+    /**
+     * Largest amount of receive buffer space in use at any one time, in bytes.
+     */
+    uint64_t ringbuf_peak_used;
+    /**
+     * Current size of the receive buffer, in bytes.
+     */
+    uint64_t ringbuf_capacity;
+    /**
+     * Number of slabs making up the receive buffer, including the empty ones
+     * kept for reuse (see the @c ringbuf_slab_size option).
+     */
+    uint64_t ringbuf_slabs;
+    /**
+     * Largest number of slabs making up the receive buffer at any one time.
+     */
+    uint64_t ringbuf_peak_slabs;
+    /**
+     * Number of received messages dropped because a subscription's queue was
+     * full, summed over all subscriptions.  A message dropped by several
+     * subscriptions is counted once for each of them.
+     */
+    uint64_t queue_drops;
+    /**
+     * Number of received messages dropped because they exceeded a
+     * subscription's latency budget, summed over all subscriptions.
+     */
+    uint64_t stale_drops;
+} lcm_stats_t;
+
+/**
+ * @brief Retrieves receive statistics.
+ *
+ * Statistics are gathered from the receive thread while this function runs,
+ * so the counters are not guaranteed to be consistent with each other.
+ *
+ * @param lcm the %LCM object
+ * @param stats filled in with the statistics
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_API_FUNCTION
+int lcm_get_stats(lcm_t *lcm, lcm_stats_t *stats);
+
 /// LCM release major version - the X in version X.Y.Z
 #define LCM_MAJOR_VERSION 1
 
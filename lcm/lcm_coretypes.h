@@ -6,6 +6,17 @@
 #include <string.h>
 #include <stdlib.h>
 
+/*
+ * Large arrays of multi-byte primitives are byte-swapped with SSSE3 or AVX2
+ * on x86 processors that support them, as detected at run time.  Define
+ * LCM_NO_SIMD to always use the portable code.
+ */
+#if !defined(LCM_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define LCM_CORETYPES_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -22,6 +33,72 @@ union double_uint64
     uint64_t  i;
 };
 
+/*
+ * Byte-swaps the leading elements of an array of elements of the given size
+ * (2, 4 or 8 bytes) from src to dst, which may be unaligned.  Returns how
+ * many elements were converted; the caller converts the rest.  Only arrays
+ * long enough to amortize the CPU feature check are converted.
+ */
+#ifdef LCM_CORETYPES_X86_SIMD
+__attribute__((target("ssse3")))
+static inline __m128i __lcm_bswap_shuffle(int size)
+{
+    if (size == 2)
+        return _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    if (size == 4)
+        return _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    return _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+}
+
+__attribute__((target("avx2")))
+static inline int __lcm_bswap_bytes_avx2(uint8_t *dst, const uint8_t *src,
+        int nbytes, int size)
+{
+    const __m256i mask = _mm256_broadcastsi128_si256(__lcm_bswap_shuffle(size));
+    int i;
+    for (i = 0; i + 32 <= nbytes; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+        _mm256_storeu_si256((__m256i*) (dst + i), _mm256_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static inline int __lcm_bswap_bytes_ssse3(uint8_t *dst, const uint8_t *src,
+        int nbytes, int size)
+{
+    const __m128i mask = __lcm_bswap_shuffle(size);
+    int i;
+    for (i = 0; i + 16 <= nbytes; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+        _mm_storeu_si128((__m128i*) (dst + i), _mm_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+static inline int __lcm_bswap_array(void *dst, const void *src, int elements,
+        int size)
+{
+    int nbytes = elements * size;
+    if (nbytes < 64)
+        return 0;
+    if (__builtin_cpu_supports("avx2"))
+        return __lcm_bswap_bytes_avx2((uint8_t*) dst, (const uint8_t*) src,
+                nbytes, size) / size;
+    if (__builtin_cpu_supports("ssse3"))
+        return __lcm_bswap_bytes_ssse3((uint8_t*) dst, (const uint8_t*) src,
+                nbytes, size) / size;
+    return 0;
+}
+#else
+static inline int __lcm_bswap_array(void *dst, const void *src, int elements,
+        int size)
+{
+    (void)dst; (void)src; (void)elements; (void)size;
+    return 0;
+}
+#endif
+
 typedef struct ___lcm_hash_ptr __lcm_hash_ptr;
 struct ___lcm_hash_ptr
 {
@@ -144,7 +221,9 @@ static inline int __int16_t_encode_array(void *_buf, int offset, int maxlen, con
     if (maxlen < total_size)
         return -1;
 
-    for (element = 0; element < elements; element++) {
+    element = __lcm_bswap_array(&buf[pos], p, elements, sizeof(int16_t));
+    pos += element * sizeof(int16_t);
+    for (; element < elements; element++) {
         int16_t v = p[element];
         buf[pos++] = (v>>8) & 0xff;
         buf[pos++] = (v & 0xff);
@@ -163,7 +242,9 @@ static inline int __int16_t_decode_array(const void *_buf, int offset, int maxle
     if (maxlen < total_size)
         return -1;
 
-    for (element = 0; element < elements; element++) {
+    element = __lcm_bswap_array(p, &buf[pos], elements, sizeof(int16_t));
+    pos += element * sizeof(int16_t);
+    for (; element < elements; element++) {
         p[element] = (buf[pos]<<8) + buf[pos+1];
         pos+=2;
     }
@@ -200,7 +281,9 @@ static inline int __int32_t_encode_array(void *_buf, int offset, int maxlen, con
     if (maxlen < total_size)
         return -1;
 
-    for (element = 0; element < elements; element++) {
+    element = __lcm_bswap_array(&buf[pos], p, elements, sizeof(int32_t));
+    pos += element * sizeof(int32_t);
+    for (; element < elements; element++) {
         int32_t v = p[element];
         buf[pos++] = (v>>24)&0xff;
         buf[pos++] = (v>>16)&0xff;
@@ -221,7 +304,9 @@ static inline int __int32_t_decode_array(const void *_buf, int offset, int maxle
     if (maxlen < total_size)
         return -1;
 
-    for (element = 0; element < elements; element++) {
+    element = __lcm_bswap_array(p, &buf[pos], elements, sizeof(int32_t));
+    pos += element * sizeof(int32_t);
+    for (; element < elements; element++) {
         p[element] = (((int32_t)buf[pos+0])<<24) + (((int32_t)buf[pos+1])<<16) + (((int32_t)buf[pos+2])<<8) + ((int32_t)buf[pos+3]);
         pos+=4;
     }
@@ -258,7 +343,9 @@ static inline int __int64_t_encode_array(void *_buf, int offset, int maxlen, con
     if (maxlen < total_size)
         return -1;
 
-    for (element = 0; element < elements; element++) {
+    element = __lcm_bswap_array(&buf[pos], p, elements, sizeof(int64_t));
+    pos += element * sizeof(int64_t);
+    for (; element < elements; element++) {
         int64_t v = p[element];
         buf[pos++] = (v>>56)&0xff;
         buf[pos++] = (v>>48)&0xff;
@@ -283,7 +370,9 @@ static inline int __int64_t_decode_array(const void *_buf, int offset, int maxle
     if (maxlen < total_size)
         return -1;
 
-    for (element = 0; element < elements; element++) {
+    element = __lcm_bswap_array(p, &buf[pos], elements, sizeof(int64_t));
+    pos += element * sizeof(int64_t);
+    for (; element < elements; element++) {
         int64_t a = (((int32_t)buf[pos+0])<<24) + (((int32_t)buf[pos+1])<<16) + ((int32_t)buf[pos+2]<<8) + (int32_t)buf[pos+3];
         pos+=4;
         int64_t b = (((int32_t)buf[pos+0])<<24) + (((int32_t)buf[pos+1])<<16) + ((int32_t)buf[pos+2]<<8) + (int32_t)buf[pos+3];
@@ -443,6 +532,94 @@ static inline void *lcm_malloc(size_t sz)
     return NULL;
 }
 
+/**
+ * ARENA
+ *
+ * A bump allocator over a caller-supplied block of memory, used by the
+ * _decode_arena() functions that lcm-gen --c-arena generates.  Every string
+ * and array of a message decoded this way is allocated from the arena, so
+ * the message is released all at once by lcm_arena_reset() (or by releasing
+ * the block) instead of by _decode_cleanup().
+ */
+typedef struct _lcm_arena_t lcm_arena_t;
+struct _lcm_arena_t
+{
+    uint8_t *data;
+    size_t size;
+    size_t used;
+};
+
+static inline void lcm_arena_init(lcm_arena_t *arena, void *data, size_t size)
+{
+    arena->data = (uint8_t*) data;
+    arena->size = size;
+    arena->used = 0;
+}
+
+/**
+ * Releases everything allocated from @p arena.
+ */
+static inline void lcm_arena_reset(lcm_arena_t *arena)
+{
+    arena->used = 0;
+}
+
+/**
+ * Allocates @p sz bytes, aligned to 8 bytes, from @p arena.  Returns NULL if
+ * the arena does not have enough space left.
+ */
+static inline void *lcm_arena_alloc(lcm_arena_t *arena, size_t sz)
+{
+    size_t pad = (size_t) (-(uintptr_t) (arena->data + arena->used)) & 7;
+    void *p;
+    if (pad > arena->size - arena->used ||
+            sz > arena->size - arena->used - pad)
+        return NULL;
+    p = arena->data + arena->used + pad;
+    arena->used += pad + sz;
+    return p;
+}
+
+// primitive arrays are decoded into storage provided by the caller
+#define __boolean_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __boolean_decode_array(buf, offset, maxlen, p, elements)
+#define __byte_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __byte_decode_array(buf, offset, maxlen, p, elements)
+#define __int8_t_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __int8_t_decode_array(buf, offset, maxlen, p, elements)
+#define __int16_t_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __int16_t_decode_array(buf, offset, maxlen, p, elements)
+#define __int32_t_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __int32_t_decode_array(buf, offset, maxlen, p, elements)
+#define __int64_t_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __int64_t_decode_array(buf, offset, maxlen, p, elements)
+#define __float_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __float_decode_array(buf, offset, maxlen, p, elements)
+#define __double_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __double_decode_array(buf, offset, maxlen, p, elements)
+
+static inline int __string_decode_array_arena(const void *_buf, int offset, int maxlen, char **p, int elements, lcm_arena_t *arena)
+{
+    int pos = 0, thislen;
+    int element;
+
+    for (element = 0; element < elements; element++) {
+        int32_t length;
+
+        // read length including \0
+        thislen = __int32_t_decode_array(_buf, offset + pos, maxlen - pos, &length, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+        if (length < 1) return -1;
+
+        p[element] = (char*) lcm_arena_alloc(arena, length);
+        if (!p[element]) return -1;
+        thislen = __int8_t_decode_array(_buf, offset + pos, maxlen - pos, (int8_t*) p[element], length);
+        if (thislen < 0) return thislen; else pos += thislen;
+    }
+
+    return pos;
+}
+
 /**
  * Describes the type of a single field in an LCM message.
  */
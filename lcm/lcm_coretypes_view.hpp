@@ -0,0 +1,152 @@
+#ifndef __lcm_coretypes_view_hpp__
+#define __lcm_coretypes_view_hpp__
+
+#include "lcm_coretypes.h"
+
+/*
+ * Support for the read-only view classes generated by lcm-gen --cpp-views.
+ * A view reads the fields of an encoded message on access, straight from the
+ * buffer holding it, instead of decoding the whole message up front.
+ */
+
+namespace lcm {
+
+/**
+ * Reads big-endian primitives of type T out of an encoded message.
+ */
+template<typename T> struct ViewDecoder;
+
+#define LCM_VIEW_DECODER(T, lcmtype) \
+template<> struct ViewDecoder<T> { \
+    static inline T get(const uint8_t *p) { \
+        T v; \
+        __##lcmtype##_decode_array(p, 0, sizeof(T), &v, 1); \
+        return v; \
+    } \
+    static inline void getArray(const uint8_t *p, T *out, int n) { \
+        __##lcmtype##_decode_array(p, 0, n * sizeof(T), out, n); \
+    } \
+};
+
+LCM_VIEW_DECODER(int8_t, int8_t)
+LCM_VIEW_DECODER(uint8_t, byte)
+LCM_VIEW_DECODER(int16_t, int16_t)
+LCM_VIEW_DECODER(int32_t, int32_t)
+LCM_VIEW_DECODER(int64_t, int64_t)
+LCM_VIEW_DECODER(float, float)
+LCM_VIEW_DECODER(double, double)
+
+#undef LCM_VIEW_DECODER
+
+/**
+ * A read-only array of big-endian primitives inside an encoded message.
+ * Elements are decoded when they are accessed.  Elements may be spaced by
+ * more than their size, e.g. to view one column of a two-dimensional array.
+ */
+template<typename T>
+class ArrayView
+{
+    public:
+        ArrayView() : data_(NULL), size_(0), stride_(sizeof(T)) {}
+
+        /**
+         * @param data the first encoded element.
+         * @param size the number of elements.
+         * @param stride the distance between elements, in bytes.
+         */
+        ArrayView(const void *data, int size, int stride = sizeof(T)) :
+            data_((const uint8_t*) data), size_(size), stride_(stride) {}
+
+        /**
+         * The number of elements.
+         */
+        int size() const { return size_; }
+
+        bool empty() const { return size_ == 0; }
+
+        /**
+         * Decodes element @p i.  @p i is not checked.
+         */
+        T operator[](int i) const {
+            return ViewDecoder<T>::get(data_ + (size_t) i * stride_);
+        }
+
+        /**
+         * The distance between elements, in bytes.
+         */
+        int stride() const { return stride_; }
+
+        /**
+         * The encoded (big-endian) bytes of the first element.
+         */
+        const uint8_t *data() const { return data_; }
+
+        /**
+         * Decodes every element into @p out, which must have room for size()
+         * elements.
+         */
+        void copyTo(T *out) const {
+            if (stride_ == (int) sizeof(T)) {
+                ViewDecoder<T>::getArray(data_, out, size_);
+                return;
+            }
+            for (int i = 0; i < size_; i++)
+                out[i] = (*this)[i];
+        }
+
+        /**
+         * Returns a view of @p count elements, starting with element
+         * @p first and taking every @p step th element.
+         */
+        ArrayView<T> slice(int first, int count, int step = 1) const {
+            return ArrayView<T>(data_ + (size_t) first * stride_, count,
+                    stride_ * step);
+        }
+
+    private:
+        const uint8_t *data_;
+        int size_;
+        int stride_;
+};
+
+// LCM support functions used by the generated view classes.  Users should
+// not call these.
+
+// Multiplies an element count by an array dimension.  Returns -1 if either
+// is negative, or if the product could not possibly fit in a message.
+inline int64_t _viewCount(int64_t count, int64_t dim)
+{
+    if (count < 0 || dim < 0)
+        return -1;
+    if (count == 0 || dim == 0)
+        return 0;
+    if (dim > INT32_MAX || count > INT32_MAX / dim)
+        return -1;
+    return count * dim;
+}
+
+// Skips an array of primitives.  Returns the position following it, or -1 if
+// it does not fit within maxlen.
+inline int _viewSkip(int pos, int maxlen, int64_t count, int size)
+{
+    if (count < 0 || count > (maxlen - pos) / size)
+        return -1;
+    return pos + (int) count * size;
+}
+
+// Skips a string, which must be NUL-terminated.  Returns the position
+// following it, or -1 if it does not fit within maxlen.
+inline int _viewSkipString(const uint8_t *buf, int pos, int maxlen)
+{
+    if (maxlen - pos < 4)
+        return -1;
+    int32_t len = ViewDecoder<int32_t>::get(buf + pos);
+    pos += 4;
+    if (len < 1 || len > maxlen - pos || buf[pos + len - 1] != 0)
+        return -1;
+    return pos + len;
+}
+
+}
+
+#endif
@@ -233,7 +233,7 @@ lcm_logprov_get_fileno (lcm_logprov_t *lr)
 }
 
 static int
-lcm_logprov_handle (lcm_logprov_t * lr)
+lcm_logprov_handle_batch (lcm_logprov_t * lr, int max_msgs)
 {
     lcm_recv_buf_t rbuf;
 
@@ -256,32 +256,39 @@ lcm_logprov_handle (lcm_logprov_t * lr)
     if (lr->next_clock_time < 0)
         lr->next_clock_time = now;
 
-//    rbuf.channel = lr->event->channel,
-    rbuf.data = (uint8_t*) lr->event->data;
-    rbuf.data_size = lr->event->datalen;
-    rbuf.recv_utime = lr->next_clock_time;
-    rbuf.lcm = lr->lcm;
+    int nhandled = 0;
+    do {
+//        rbuf.channel = lr->event->channel,
+        rbuf.data = (uint8_t*) lr->event->data;
+        rbuf.data_size = lr->event->datalen;
+        rbuf.recv_utime = lr->next_clock_time;
+        rbuf.lcm = lr->lcm;
 
-    if(lcm_try_enqueue_message(lr->lcm, lr->event->channel))
-        lcm_dispatch_handlers (lr->lcm, &rbuf, lr->event->channel);
+        if(lcm_try_enqueue_message(lr->lcm, lr->event->channel))
+            lcm_dispatch_handlers (lr->lcm, &rbuf, lr->event->channel);
+        nhandled++;
 
-    int64_t prev_log_time = lr->event->timestamp;
-    if (load_next_event (lr) < 0) {
-        /* end-of-file reached.  This call succeeds, but next call to
-         * _handle will fail */
-        lr->event = NULL;
-        if(lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1) < 0) {
-            perror(__FILE__ " - write(notify)");
+        int64_t prev_log_time = lr->event->timestamp;
+        if (load_next_event (lr) < 0) {
+            /* end-of-file reached.  This call succeeds, but next call to
+             * _handle will fail */
+            lr->event = NULL;
+            if(lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1) < 0) {
+                perror(__FILE__ " - write(notify)");
+            }
+            return nhandled;
         }
-        return 0;
-    }
 
-    /* Compute the wall time for the next event */
-    if (lr->speed > 0)
-        lr->next_clock_time +=
-            (lr->event->timestamp - prev_log_time) / lr->speed;
-    else
-        lr->next_clock_time = now;
+        /* Compute the wall time for the next event */
+        if (lr->speed > 0)
+            lr->next_clock_time +=
+                (lr->event->timestamp - prev_log_time) / lr->speed;
+        else
+            lr->next_clock_time = now;
+
+        /* Keep dispatching events that are already due, without a round trip
+         * through the notify pipe. */
+    } while (nhandled < max_msgs && lr->next_clock_time <= now);
 
     if (lr->next_clock_time > now) {
         int wstatus = lcm_internal_pipe_write(lr->timer_pipe[1], &lr->next_clock_time, 8);
@@ -295,7 +302,13 @@ lcm_logprov_handle (lcm_logprov_t * lr)
         }
     }
 
-    return 0;
+    return nhandled;
+}
+
+static int
+lcm_logprov_handle (lcm_logprov_t * lr)
+{
+    return lcm_logprov_handle_batch (lr, 1) < 0 ? -1 : 0;
 }
 
 
@@ -346,8 +359,12 @@ lcm_logprov_provider_init (GPtrArray * providers)
     logprov_vtable.subscribe   = NULL;
     logprov_vtable.unsubscribe = NULL;
     logprov_vtable.publish     = lcm_logprov_publish;
+    logprov_vtable.publish_batch = NULL;
     logprov_vtable.handle      = lcm_logprov_handle;
+    logprov_vtable.handle_batch = lcm_logprov_handle_batch;
     logprov_vtable.get_fileno  = lcm_logprov_get_fileno;
+    logprov_vtable.get_stats   = NULL;
+    logprov_vtable.has_subscribers = NULL;
 
     logprov_info.name = "file";
     logprov_info.vtable = &logprov_vtable;
@@ -40,8 +40,22 @@ struct _lcm_provider_vtable_t {
     int (*unsubscribe)(lcm_provider_t *, const char *channel);
     int (*publish)(lcm_provider_t *, const char *, const void *, 
             unsigned int);
+    // optional.  If NULL, lcm_publish_batch() calls publish once per message
+    int (*publish_batch)(lcm_provider_t *, const lcm_publish_entry_t *, int);
     int (*handle)(lcm_provider_t *);
+    // optional.  Called once the fileno is readable, dispatches up to the
+    // specified number of queued messages and returns how many were
+    // dispatched, or -1 on error.  If NULL, lcm_handle_batch() calls handle
+    // repeatedly while more messages are available.
+    int (*handle_batch)(lcm_provider_t *, int max_msgs);
     int (*get_fileno)(lcm_provider_t *);
+    // optional.  Fills in the provider's counters in an lcm_stats_t that has
+    // been zeroed out.
+    void (*get_stats)(lcm_provider_t *, lcm_stats_t *);
+    // optional.  Returns 0 only if a message published on the channel would
+    // certainly not be received by anyone.  If NULL, every channel is
+    // assumed to have subscribers.
+    int (*has_subscribers)(lcm_provider_t *, const char *channel);
 };
 
 int
@@ -56,10 +70,58 @@ lcm_parse_url (const char * url, char ** provider, char ** target,
 int
 lcm_try_enqueue_message (lcm_t * lcm, const char * channel);
 
+/**
+ * Like lcm_try_enqueue_message(), but the message is never turned away
+ * because a queue is full.  For providers that hold on to every message
+ * until it is handled anyway, like memq.
+ */
+int
+lcm_enqueue_message (lcm_t * lcm, const char * channel);
+
 int
 lcm_has_handlers (lcm_t * lcm, const char * channel);
 
+/**
+ * Returns the distinct channel names and regexes of all the subscriptions, as
+ * a NULL-terminated array to be released with g_strfreev().
+ */
+char **
+lcm_get_subscribed_channels (lcm_t * lcm);
+
+/**
+ * Returns nonzero once any subscription has been given a priority with
+ * lcm_subscription_set_priority().  Providers that hold a backlog of received
+ * messages only need to call lcm_select_by_priority() after that.
+ */
+int
+lcm_has_priorities (lcm_t * lcm);
+
+/**
+ * Number of received messages at the head of a provider's queue that are
+ * considered when picking the highest priority one.
+ */
+#define LCM_PRIORITY_WINDOW 64
+
+/**
+ * Returns the index of the channel in @c channels that should be dispatched
+ * first: the one with the highest priority subscription, or the first of
+ * several with the same priority.  @c n must be at least 1.
+ */
+int
+lcm_select_by_priority (lcm_t * lcm, const char * const * channels, int n);
+
 int
 lcm_dispatch_handlers (lcm_t * lcm, lcm_recv_buf_t * buf, const char *channel);
 
+/**
+ * Same as lcm_dispatch_handlers, for providers that can give up ownership of
+ * the message payload.  @c storage points to the provider's pointer to the
+ * malloc()ed block containing buf->data.  If a handler retains the message
+ * with lcm_recv_buf_ref(), the block is taken over and *storage is set to
+ * NULL, in which case the provider must not free it.
+ */
+int
+lcm_dispatch_handlers_owned (lcm_t * lcm, lcm_recv_buf_t * buf,
+        const char *channel, void **storage);
+
 #endif
@@ -96,7 +96,7 @@ lcm_memq_get_fileno(lcm_memq_t* self)
 }
 
 static int
-lcm_memq_handle(lcm_memq_t* self)
+lcm_memq_handle_batch(lcm_memq_t* self, int max_msgs)
 {
     char ch;
     int status = lcm_internal_pipe_read(self->notify_pipe[0], &ch, 1);
@@ -106,8 +106,24 @@ lcm_memq_handle(lcm_memq_t* self)
         return -1;
     }
 
+    // take up to max_msgs messages off the queue at once
+    GQueue batch = G_QUEUE_INIT;
     g_mutex_lock(self->mutex);
-    memq_msg_t* msg = (memq_msg_t*)g_queue_pop_head(self->queue);
+    if (lcm_has_priorities(self->lcm)) {
+        // pick the highest priority messages near the head of the queue
+        const char* channels[LCM_PRIORITY_WINDOW];
+        while ((int) batch.length < max_msgs &&
+                !g_queue_is_empty(self->queue)) {
+            int n = 0;
+            for (GList* link = self->queue->head;
+                    link && n < LCM_PRIORITY_WINDOW; link = link->next)
+                channels[n++] = ((memq_msg_t*) link->data)->channel;
+            int index = lcm_select_by_priority(self->lcm, channels, n);
+            g_queue_push_tail(&batch, g_queue_pop_nth(self->queue, index));
+        }
+    }
+    while ((int) batch.length < max_msgs && !g_queue_is_empty(self->queue))
+        g_queue_push_tail(&batch, g_queue_pop_head(self->queue));
     if (!g_queue_is_empty(self->queue)) {
         if(lcm_internal_pipe_write(self->notify_pipe[1], "+", 1) < 0) {
             perror(__FILE__ " - write to notify pipe (lcm_memq_handle)");
@@ -115,15 +131,30 @@ lcm_memq_handle(lcm_memq_t* self)
     }
     g_mutex_unlock(self->mutex);
 
-    dbg(DBG_LCM, "Dispatching message on channel [%s], size [%d]\n",
-        msg->channel, msg->rbuf.data_size);
+    int nhandled = 0;
+    while (!g_queue_is_empty(&batch)) {
+        memq_msg_t* msg = (memq_msg_t*)g_queue_pop_head(&batch);
+
+        dbg(DBG_LCM, "Dispatching message on channel [%s], size [%d]\n",
+            msg->channel, msg->rbuf.data_size);
 
-    if (lcm_try_enqueue_message(self->lcm, msg->channel)) {
-      lcm_dispatch_handlers(self->lcm, &msg->rbuf, msg->channel);
+        // the payload may be taken over by lcm_recv_buf_ref()
+        void* storage = msg->rbuf.data;
+        lcm_dispatch_handlers_owned(self->lcm, &msg->rbuf, msg->channel,
+            &storage);
+        if (!storage)
+            msg->rbuf.data = NULL;
+
+        memq_msg_destroy(msg);
+        nhandled++;
     }
+    return nhandled;
+}
 
-    memq_msg_destroy(msg);
-    return 0;
+static int
+lcm_memq_handle(lcm_memq_t* self)
+{
+    return lcm_memq_handle_batch(self, 1) < 0 ? -1 : 0;
 }
 
 
@@ -131,7 +162,11 @@ static int
 lcm_memq_publish (lcm_memq_t *self, const char *channel, const void *data,
         unsigned int datalen)
 {
-    if(!lcm_has_handlers(self->lcm, channel)) {
+    // count the message as queued now, like the network providers do when a
+    // message is received, so that LCM_QUEUE_KEEP_LATEST and
+    // LCM_QUEUE_DROP_OLDEST subscriptions know about the newer messages when
+    // dispatching.  The queue itself is unbounded, as before.
+    if(!lcm_enqueue_message(self->lcm, channel)) {
       dbg(DBG_LCM,
           "Publishing [%s] size [%d] - dropping (no subscribers)\n",
           channel, datalen);
@@ -153,6 +188,12 @@ lcm_memq_publish (lcm_memq_t *self, const char *channel, const void *data,
     return 0;
 }
 
+static int
+lcm_memq_has_subscribers (lcm_memq_t *self, const char *channel)
+{
+    return lcm_has_handlers(self->lcm, channel);
+}
+
 static lcm_provider_vtable_t memq_vtable;
 static lcm_provider_info_t memq_info;
 
@@ -164,8 +205,12 @@ lcm_memq_provider_init (GPtrArray * providers)
     memq_vtable.subscribe   = NULL;
     memq_vtable.unsubscribe = NULL;
     memq_vtable.publish     = lcm_memq_publish;
+    memq_vtable.publish_batch = NULL;
     memq_vtable.handle      = lcm_memq_handle;
+    memq_vtable.handle_batch = lcm_memq_handle_batch;
     memq_vtable.get_fileno  = lcm_memq_get_fileno;
+    memq_vtable.get_stats   = NULL;
+    memq_vtable.has_subscribers = lcm_memq_has_subscribers;
 
     memq_info.name = "memq";
     memq_info.vtable = &memq_vtable;
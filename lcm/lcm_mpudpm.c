@@ -17,6 +17,10 @@
 #include <sys/select.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 #include <glib.h>
 
 #include "lcm.h"
@@ -27,6 +31,11 @@
 
 #include "lcmtypes/channel_port_map_update_t.h"
 
+#ifdef HAVE_SYS_EPOLL_H
+// maximum number of ready sockets reported by a single epoll_wait()
+#define MPUDPM_MAX_EPOLL_EVENTS 64
+#endif
+
 // Lets reserve channels starting with #! for internal use
 #define RESERVED_CHANNEL_PREFIX "#!"
 // The number of LCM channels that we use internally for stuff.
@@ -52,11 +61,14 @@
  * @port                multicast port
  * @num_subscribers     the number of subscribers to enable closing this socket
  *                             when it's no longer in use
+ * @kernel_drops        packets dropped by the kernel on this socket, as last
+ *                             reported by SO_RXQ_OVFL
  */
 typedef struct _mpudpm_socket_t {
     SOCKET fd;
     uint16_t port;
     int num_subscribers;
+    uint32_t kernel_drops;
 } mpudpm_socket_t;
 
 
@@ -85,6 +97,7 @@ typedef struct _mpudpm_subscriber_t {
  *                        don't use > 1.  that's just rude.
  * @recv_buf_size:        requested size of the kernel receive buffer, set with
  *                        SO_RCVBUF.  0 indicates to use the default settings.
+ * @ringbuf:              sizes of the ringbuffer holding received packets.
  *
  */
 typedef struct _mpudpm_params_t mpudpm_params_t;
@@ -94,6 +107,7 @@ struct _mpudpm_params_t {
     uint16_t num_mc_ports;
     uint8_t mc_ttl; 
     int recv_buf_size;
+    lcm_ringbuf_params_t ringbuf;
 };
 
 typedef struct _lcm_provider_t lcm_mpudpm_t;
@@ -168,6 +182,10 @@ struct _lcm_provider_t {
     int notify_pipe[2];         // pipe to notify application when messages arrive
     int thread_msg_pipe[2];     // pipe to notify read thread when to cancel a
     // select or terminate
+#ifdef HAVE_SYS_EPOLL_H
+    int epoll_fd;               // the read thread waits on this epoll instance,
+    // which contains thread_msg_pipe[0] and the fd of every recv_socket
+#endif
 
     /* synchronization variables used only while allocating receive resources
      */
@@ -178,12 +196,17 @@ struct _lcm_provider_t {
 
     /* other variables */
     lcm_frag_buf_store  *frag_bufs;
-
-    uint32_t     udp_rx;            // packets received and processed
-    uint32_t     udp_discarded_bad; // packets discarded because they were bad 
+    /* payload buffers of large messages */
+    lcm_buf_pool_t      *buf_pool;
+
+    /* receive statistics, updated by the read thread and reported by
+     * lcm_get_stats () */
+    uint64_t     udp_rx;            // packets received
+    uint64_t     udp_rx_bytes;      // bytes received
+    uint64_t     udp_discarded_bad; // packets discarded because they were bad 
     // somehow
-    double       udp_low_watermark; // least buffer available
-    int32_t      udp_last_report_secs;
+    uint64_t     udp_kernel_drops;  // packets dropped by the kernel, summed
+    // over all of the receive sockets
 
     // regex to check whether a passed in channel is a regex :-)
     GRegex* regex_finder_re;
@@ -265,17 +288,34 @@ destroy_recv_parts (lcm_mpudpm_t *lcm)
     }
 
     if (lcm->inbufs_empty) {
-        lcm_buf_queue_free (lcm->inbufs_empty, lcm->ringbuf);
+        lcm_buf_queue_free (lcm->inbufs_empty);
         lcm->inbufs_empty = NULL;
     }
     if (lcm->inbufs_filled) {
-        lcm_buf_queue_free (lcm->inbufs_filled, lcm->ringbuf);
+        lcm_buf_queue_free (lcm->inbufs_filled);
         lcm->inbufs_filled = NULL;
     }
     if (lcm->ringbuf) {
+        lcm_ringbuf_stats_t stats;
+        lcm_ringbuf_get_stats (lcm->ringbuf, &stats);
+        dbg (DBG_LCM, "receive ringbuffer peaked at %u slabs, %u bytes used; "
+                "%llu packets dropped at the high watermark\n",
+                stats.peak_slabs, stats.peak_used,
+                (unsigned long long) stats.num_overflows);
         lcm_ringbuf_free (lcm->ringbuf);
         lcm->ringbuf = NULL;
     }
+    if (lcm->buf_pool) {
+        lcm_buf_pool_destroy (lcm->buf_pool);
+        lcm->buf_pool = NULL;
+    }
+
+#ifdef HAVE_SYS_EPOLL_H
+    if (lcm->epoll_fd >= 0) {
+        close(lcm->epoll_fd);
+        lcm->epoll_fd = -1;
+    }
+#endif
 }
 
 void
@@ -386,6 +426,10 @@ new_argument (gpointer key, gpointer value, gpointer user)
             params->num_mc_ports = 1;
         }
     }
+    else if (lcm_ringbuf_params_parse(&params->ringbuf, (char *) key,
+                (char *) value)) {
+        // ringbuf_* options
+    }
     else {
         fprintf(stderr, "%s:%d -- unknown provider argument %s\n",
                 __FILE__, __LINE__, (char *)key);
@@ -398,15 +442,50 @@ is_reserved_channel(const char * channel){
             strlen(RESERVED_CHANNEL_PREFIX)) == 0);
 }
 
+// Called once the payload of a fragment received in lcmb has been placed in
+// fbuf.  If the message is complete, moves it into lcmb and returns 1.
+static int
+fragment_received (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, lcm_frag_buf_t *fbuf)
+{
+    fbuf->last_packet_utime = lcmb->recv_utime;
+
+    fbuf->fragments_remaining --;
+
+    if (0 == fbuf->fragments_remaining) {
+        // complete message received.  Is there a subscriber that still
+        // wants it?  (i.e., does any subscriber have space in its queue?)
+        // WARNING: lcm_try_enqueue_message increments the number of queued
+        // messages, so we must check whether it is a reserved channel FIRST
+        if (!is_reserved_channel(fbuf->channel)
+                && !lcm_try_enqueue_message(lcm->lcm, fbuf->channel)) {
+            // no... sad... free the fragment buffer and return
+            lcm_frag_buf_store_remove(lcm->frag_bufs, fbuf);
+            return 0;
+        }
+
+        // yes, transfer the message into the lcm_buf_t
+
+        // deallocate the ringbuffer-allocated buffer
+        g_static_mutex_lock(&lcm->receive_lock);
+        lcm_buf_free_data(lcmb);
+        g_static_mutex_unlock(&lcm->receive_lock);
+
+        lcm_frag_buf_transfer (fbuf, lcmb);
+
+        // don't need the fragment buffer anymore
+        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
+
+        return 1;
+    }
+
+    return 0;
+}
+
 static int 
 recv_message_fragment (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
 {
     lcm2_header_long_t *hdr = (lcm2_header_long_t*) lcmb->buf;
 
-    // any existing fragment buffer for this message source?
-    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(lcm->frag_bufs,
-            &lcmb->from);
-
     uint32_t msg_seqno = ntohl (hdr->msg_seqno);
     uint32_t data_size = ntohl (hdr->msg_size);
     uint32_t fragment_offset = ntohl (hdr->fragment_offset);
@@ -415,12 +494,17 @@ recv_message_fragment (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
     uint32_t frag_size = sz - sizeof (lcm2_header_long_t);
     char *data_start = (char*) (hdr + 1);
 
-    // discard any stale fragments from previous messages
-    if (fbuf && ((fbuf->msg_seqno != msg_seqno) ||
-            (fbuf->data_size != data_size))) {
-        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
+    // any existing fragment buffer for this message?  Fragment buffers of
+    // other messages from the same source are left alone, since a sender may
+    // interleave the fragments of several messages.
+    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(lcm->frag_bufs,
+            &lcmb->from, msg_seqno);
+
+    // discard a fragment buffer that doesn't match the message
+    if (fbuf && fbuf->data_size != data_size) {
         dbg(DBG_LCM, "Dropping message (missing %d fragments)\n",
             fbuf->fragments_remaining);
+        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
         fbuf = NULL;
     }
 
@@ -445,7 +529,8 @@ recv_message_fragment (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
                 && !is_reserved_channel(channel))
             return 0;
 
-        fbuf = lcm_frag_buf_new (*((struct sockaddr_in*) &lcmb->from),
+        fbuf = lcm_frag_buf_new (lcm->buf_pool,
+                *((struct sockaddr_in*) &lcmb->from),
                 channel, msg_seqno, data_size, fragments_in_msg,
                 lcmb->recv_utime);
         lcm_frag_buf_store_add (lcm->frag_bufs, fbuf);
@@ -485,46 +570,8 @@ recv_message_fragment (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
 
     // copy data
     memcpy (fbuf->data + fragment_offset, data_start, frag_size);
-    fbuf->last_packet_utime = lcmb->recv_utime;
 
-    fbuf->fragments_remaining --;
-
-    if (0 == fbuf->fragments_remaining) {
-        // complete message received.  Is there a subscriber that still
-        // wants it?  (i.e., does any subscriber have space in its queue?)
-        // WARNING: lcm_try_enqueue_message increments the number of queued
-        // messages, so we must check whether it is a reserved channel FIRST
-        if (!is_reserved_channel(fbuf->channel)
-                && !lcm_try_enqueue_message(lcm->lcm, fbuf->channel)) {
-            // no... sad... free the fragment buffer and return
-            lcm_frag_buf_store_remove(lcm->frag_bufs, fbuf);
-            return 0;
-        }
-
-        // yes, transfer the message into the lcm_buf_t
-
-        // deallocate the ringbuffer-allocated buffer
-        g_static_mutex_lock(&lcm->receive_lock);
-        lcm_buf_free_data(lcmb, lcm->ringbuf);
-        g_static_mutex_unlock(&lcm->receive_lock);
-
-        // transfer ownership of the message's payload buffer
-        lcmb->buf = fbuf->data;
-        fbuf->data = NULL;
-
-        strcpy (lcmb->channel_name, fbuf->channel);
-        lcmb->channel_size = strlen (lcmb->channel_name);
-        lcmb->data_offset = 0;
-        lcmb->data_size = fbuf->data_size;
-        lcmb->recv_utime = fbuf->last_packet_utime;
-
-        // don't need the fragment buffer anymore
-        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
-
-        return 1;
-    }
-
-    return 0;
+    return fragment_received (lcm, lcmb, fbuf);
 }
 
 static int
@@ -544,8 +591,6 @@ recv_short_message (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, int sz)
         return 0;
     }
 
-    lcm->udp_rx++;
-
     // if the packet has no subscribers, drop the message now.
     // WARNING: lcm_try_enqueue_message increments the number of queued
     // messages, so we must check whether it is a reserved channel FIRST
@@ -595,7 +640,7 @@ static void dispatch_complete_message(lcm_mpudpm_t * lcm, lcm_buf_t * lcmb,
     if (handled_internal_message) {
         // one of the handlers above took it, so discard lcmb
         g_static_mutex_lock(&lcm->receive_lock);
-        lcm_buf_free_data(lcmb, lcm->ringbuf);
+        lcm_buf_free_data(lcmb);
         lcm_buf_enqueue(lcm->inbufs_empty, lcmb);
         g_static_mutex_unlock(&lcm->receive_lock);
     } else {
@@ -624,6 +669,130 @@ static void dispatch_complete_message(lcm_mpudpm_t * lcm, lcm_buf_t * lcmb,
     }
 }
 
+// Receive and queue all data available on sub_socket.  Called with the
+// receive_lock held, and returns with it held, but releases it while waiting
+// on the socket.  *lcmb_ptr is an unused receive buffer carried across calls.
+//
+// remove_recv_socket() may free sub_socket while receive_lock is released, so
+// it is only used while the lock is held and recv_sockets_changed is unset.
+static void
+recv_from_socket(lcm_mpudpm_t *lcm, mpudpm_socket_t *sub_socket,
+        lcm_buf_t **lcmb_ptr) {
+    SOCKET recv_fd = sub_socket->fd;
+    uint16_t recv_port = sub_socket->port;
+    uint32_t kernel_drops = sub_socket->kernel_drops;
+    lcm_buf_t *lcmb = *lcmb_ptr;
+
+    // loop until recvmsg would block (we've read all available data), a read
+    // fails, or the receive sockets change
+    while (!lcm->recv_sockets_changed) {
+        // We should be holding receive_lock at the start of this loop
+        if (lcmb == NULL ) {
+            lcmb = lcm_buf_allocate_data(lcm->inbufs_empty,
+                    lcm->ringbuf);
+            if (lcmb == NULL) {
+                // the ringbuffer is at its high watermark.  Drop the packet.
+                g_static_mutex_unlock(&lcm->receive_lock);
+                int status = lcm_discard_datagram(recv_fd);
+                g_static_mutex_lock(&lcm->receive_lock);
+                if (status < 0)
+                    break;
+                continue;
+            }
+        }
+
+        // unlock while we actually receive the incoming message
+        g_static_mutex_unlock(&lcm->receive_lock);
+        struct iovec vec;
+        vec.iov_base = lcmb->buf;
+        vec.iov_len = 65535;
+
+        struct msghdr msg;
+        msg.msg_name = &lcmb->from;
+        msg.msg_namelen = sizeof(struct sockaddr);
+        msg.msg_iov = &vec;
+        msg.msg_iovlen = 1;
+#ifdef MSG_EXT_HDR
+        // operating systems that provide SO_TIMESTAMP allow us to
+        // obtain more accurate timestamps by having the kernel produce
+        // timestamps as soon as packets are received.
+        char controlbuf[64];
+        msg.msg_control = controlbuf;
+        msg.msg_controllen = sizeof(controlbuf);
+        msg.msg_flags = 0;
+#endif
+        int sz = recvmsg(recv_fd, &msg, 0);
+
+        if (sz < 0) {
+#ifndef WIN32
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+#else
+            if (WSAGetLastError() != WSAEWOULDBLOCK) {
+#endif
+                perror("udp_read_packet -- recvmsg");
+                lcm->udp_discarded_bad++;
+            }
+            g_static_mutex_lock(&lcm->receive_lock);
+            break;
+        }
+
+        lcm->udp_rx++;
+        lcm->udp_rx_bytes += sz;
+        uint32_t reported_drops = kernel_drops;
+        lcmb->recv_utime = lcm_recv_control_parse(&msg, &reported_drops);
+        lcm->udp_kernel_drops += reported_drops - kernel_drops;
+        kernel_drops = reported_drops;
+
+        if (sz < sizeof(lcm2_header_short_t)) {
+            // packet too short to be LCM
+            lcm->udp_discarded_bad++;
+            g_static_mutex_lock(&lcm->receive_lock);
+            continue;
+        }
+
+        lcmb->fromlen = msg.msg_namelen;
+        // overwrite upper 16 bits of the address in lcmb->from with the
+        // recv_port since all channels are sent from the same port, and
+        // the from address is used to retrieve fragment buffers. If
+        // there is an existing fragment buffer with a different seqno
+        // the message would get dropped. This ensures that messages on
+        // different channels will appear as though they are coming from
+        // different senders
+        struct sockaddr_in *from_addr =
+                (struct sockaddr_in*) &lcmb->from;
+        // s_addr is network order, so we actually modify lower 16
+        from_addr->sin_addr.s_addr &= 0xFFFF0000;
+        from_addr->sin_addr.s_addr |= htons(recv_port);
+
+        lcm2_header_short_t *hdr2 = (lcm2_header_short_t*) lcmb->buf;
+        uint32_t rcvd_magic = ntohl(hdr2->magic);
+        int got_complete_message = 0;
+        if (rcvd_magic == LCM2_MAGIC_SHORT)
+            got_complete_message = recv_short_message(lcm, lcmb, sz);
+        else if (rcvd_magic == LCM2_MAGIC_LONG)
+            got_complete_message = recv_message_fragment(lcm, lcmb, sz);
+        else {
+            dbg(DBG_LCM, "LCM: bad magic\n");
+            lcm->udp_discarded_bad++;
+            g_static_mutex_lock(&lcm->receive_lock);
+            continue;
+        }
+
+        // dispatch internal messages
+        if (got_complete_message) {
+            dispatch_complete_message(lcm, lcmb, sz);
+            lcmb = NULL;
+        }
+        // lock to go back around the while loop
+        g_static_mutex_lock(&lcm->receive_lock);
+    }
+
+    // we're done with this file descriptor
+    if (!lcm->recv_sockets_changed)
+        sub_socket->kernel_drops = kernel_drops;
+    *lcmb_ptr = lcmb;
+}
+
 /* This is the receiver thread that runs continuously to retrieve any incoming
  * LCM packets from the network and queues them locally. */
 static void *
@@ -638,9 +807,68 @@ recv_thread(void * user) {
     lcm_mpudpm_t * lcm = (lcm_mpudpm_t *) user;
 
     lcm_buf_t *lcmb = NULL;
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event events[MPUDPM_MAX_EPOLL_EVENTS];
+#endif
     // loop until we get an exit message on the thread_msg_pipe
     while (1) {
 
+#ifdef HAVE_SYS_EPOLL_H
+        // Sockets are added to and removed from the epoll set as they are
+        // created and destroyed, so there is nothing to set up here.  Just
+        // note that no sockets have been removed since we started waiting.
+        g_static_mutex_lock(&lcm->receive_lock);
+        lcm->recv_sockets_changed = 0;
+        g_static_mutex_unlock(&lcm->receive_lock);
+
+        int nevents = epoll_wait(lcm->epoll_fd, events,
+                MPUDPM_MAX_EPOLL_EVENTS, -1);
+        if (nevents < 0) {
+            if (errno != EINTR)
+                perror("udp_read_packet -- epoll_wait() failed:");
+            continue;
+        }
+
+        // check for a signaling message.  It is registered with a NULL
+        // pointer.
+        int got_exit = 0;
+        for (int i = 0; i < nevents; i++) {
+            if (events[i].data.ptr)
+                continue;
+            char ch;
+            int status = lcm_internal_pipe_read(lcm->thread_msg_pipe[0], &ch,
+                    1);
+            if (status <= 0) {
+                fprintf(stderr,
+                        "Error: Problem reading from thread_msg_pipe\n");
+                got_exit = 1;
+            } else if (ch != 'c') {
+                // received an exit message.
+                dbg(DBG_LCM, "read thread received exit command\n");
+                got_exit = 1;
+            }
+        }
+        if (got_exit) {
+            // lcmb is not on one of the memory managed buffer queues, and its
+            // data buffer is managed either by the ring buffer or the fragment
+            // buffer, so just free the lcm_buf_t.
+            free(lcmb);
+            break;
+        }
+
+        // there is incoming UDP data ready on at least one of our sockets.
+        // If a socket was removed while we were waiting, then the events may
+        // refer to freed sockets, so wait again.  Any data still pending will
+        // be reported again, since epoll is level-triggered.
+        g_static_mutex_lock(&lcm->receive_lock);
+        for (int i = 0; i < nevents && !lcm->recv_sockets_changed; i++) {
+            mpudpm_socket_t * sub_socket =
+                (mpudpm_socket_t *) events[i].data.ptr;
+            if (sub_socket)
+                recv_from_socket(lcm, sub_socket, &lcmb);
+        }
+        g_static_mutex_unlock(&lcm->receive_lock);
+#else
         // lock subscription lists so things don't change on us
         g_static_mutex_lock(&lcm->receive_lock);
 
@@ -708,129 +936,16 @@ recv_thread(void * user) {
 
         // there is incoming UDP data ready on at least one of our sockets.
         // loop over sockets and receive data on all the ones that have data
-        SOCKET recv_fd = -1;
-        uint16_t recv_port = -1;
-        int poll_i = 1;
-        for (GSList* it = lcm->recv_sockets; it != NULL ;
-                it = it->next, ++poll_i) {
+        for (GSList* it = lcm->recv_sockets; it != NULL ; it = it->next) {
             // We should be holding receive_lock at the start of this loop
             mpudpm_socket_t * sub_socket = (mpudpm_socket_t *) it->data;
-            if (!FD_ISSET(sub_socket->fd, &fds)) {
+            if (!FD_ISSET(sub_socket->fd, &fds))
                 continue;
-            } else {
-                recv_fd = sub_socket->fd;
-                recv_port = sub_socket->port;
-            }
-
-            // loop until recvmsg would block (we've read all available data)
-            // or a read fails
-            while (1) {
-                // We should be holding receive_lock at the start of this loop
-                if (lcmb == NULL ) {
-                    lcmb = lcm_buf_allocate_data(lcm->inbufs_empty,
-                            &lcm->ringbuf);
-                }
-
-                // unlock while we actually receive the incoming message
-                g_static_mutex_unlock(&lcm->receive_lock);
-                struct iovec vec;
-                vec.iov_base = lcmb->buf;
-                vec.iov_len = 65535;
-
-                struct msghdr msg;
-                msg.msg_name = &lcmb->from;
-                msg.msg_namelen = sizeof(struct sockaddr);
-                msg.msg_iov = &vec;
-                msg.msg_iovlen = 1;
-#ifdef MSG_EXT_HDR
-                // operating systems that provide SO_TIMESTAMP allow us to
-                // obtain more accurate timestamps by having the kernel produce
-                // timestamps as soon as packets are received.
-                char controlbuf[64];
-                msg.msg_control = controlbuf;
-                msg.msg_controllen = sizeof(controlbuf);
-                msg.msg_flags = 0;
-#endif
-                int sz = recvmsg(recv_fd, &msg, 0);
-
-                if (sz < 0) {
-#ifndef WIN32
-                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
-#else
-                    if (WSAGetLastError() != WSAEWOULDBLOCK) {
-#endif
-                        perror("udp_read_packet -- recvmsg");
-                        lcm->udp_discarded_bad++;
-                    }
-                    break;
-                }
-
-                if (sz < sizeof(lcm2_header_short_t)) {
-                    // packet too short to be LCM
-                    lcm->udp_discarded_bad++;
-                    continue;
-                }
 
-                lcmb->fromlen = msg.msg_namelen;
-                // overwrite upper 16 bits of the address in lcmb->from with the
-                // recv_port since all channels are sent from the same port, and
-                // the from address is used to retrieve fragment buffers. If
-                // there is an existing fragment buffer with a different seqno
-                // the message would get dropped. This ensures that messages on
-                // different channels will appear as though they are coming from
-                // different senders
-                struct sockaddr_in *from_addr =
-                        (struct sockaddr_in*) &lcmb->from;
-                // s_addr is network order, so we actually modify lower 16
-                from_addr->sin_addr.s_addr &= 0xFFFF0000;
-                from_addr->sin_addr.s_addr |= htons(recv_port);
-
-                int got_utime = 0;
-#ifdef SO_TIMESTAMP
-                struct cmsghdr * cmsg = CMSG_FIRSTHDR (&msg);
-                // Get the receive timestamp out of the packet headers
-                // (if possible)
-                while (!lcmb->recv_utime && cmsg) {
-                    if (cmsg->cmsg_level == SOL_SOCKET
-                            && cmsg->cmsg_type == SCM_TIMESTAMP) {
-                        struct timeval * t = (struct timeval*) CMSG_DATA (cmsg);
-                        lcmb->recv_utime = (int64_t) t->tv_sec * 1000000
-                                + t->tv_usec;
-                        got_utime = 1;
-                        break;
-                    }
-                    cmsg = CMSG_NXTHDR (&msg, cmsg);
-                }
-#endif
-                if (!got_utime)
-                    lcmb->recv_utime = lcm_timestamp_now();
-
-                lcm2_header_short_t *hdr2 = (lcm2_header_short_t*) lcmb->buf;
-                uint32_t rcvd_magic = ntohl(hdr2->magic);
-                int got_complete_message = 0;
-                if (rcvd_magic == LCM2_MAGIC_SHORT)
-                    got_complete_message = recv_short_message(lcm, lcmb, sz);
-                else if (rcvd_magic == LCM2_MAGIC_LONG)
-                    got_complete_message = recv_message_fragment(lcm, lcmb, sz);
-                else {
-                    dbg(DBG_LCM, "LCM: bad magic\n");
-                    lcm->udp_discarded_bad++;
-                    continue;
-                }
+            recv_from_socket(lcm, sub_socket, &lcmb);
 
-                // dispatch internal messages
-                if (got_complete_message) {
-                    dispatch_complete_message(lcm, lcmb, sz);
-                    lcmb = NULL;
-                }
-                // lock to go back around the while loop
-                g_static_mutex_lock(&lcm->receive_lock);
-            }
-
-            // we're done with this file descriptor
-            // lock the receive lock to check whether the receive sockets have
-            // changed and go back around the loop
-            g_static_mutex_lock(&lcm->receive_lock);
+            // check whether the receive sockets have changed and go back
+            // around the loop
             if (lcm->recv_sockets_changed) {
                 // the set of receive sockets may have changed, so we need to
                 // break and wait again on the appropriate set of sockets
@@ -838,6 +953,7 @@ recv_thread(void * user) {
             }
         }
         g_static_mutex_unlock(&lcm->receive_lock);
+#endif
     }
 
     dbg(DBG_LCM, "read thread exiting\n");
@@ -853,6 +969,30 @@ lcm_mpudpm_get_fileno (lcm_mpudpm_t *lcm)
     return lcm->notify_pipe[0];
 }
 
+static void
+lcm_mpudpm_get_stats (lcm_mpudpm_t *lcm, lcm_stats_t *stats)
+{
+    // the packet counters are updated by the read thread while it is not
+    // holding receive_lock, so they are only approximately consistent.
+    g_static_mutex_lock(&lcm->receive_lock);
+    stats->packets_received = lcm->udp_rx;
+    stats->bytes_received = lcm->udp_rx_bytes;
+    stats->packets_bad = lcm->udp_discarded_bad;
+    stats->kernel_drops = lcm->udp_kernel_drops;
+    if (lcm->frag_bufs)
+        stats->fragment_timeouts = lcm->frag_bufs->num_evicted;
+    if (lcm->ringbuf) {
+        lcm_ringbuf_stats_t ring_stats;
+        lcm_ringbuf_get_stats(lcm->ringbuf, &ring_stats);
+        stats->ringbuf_drops = ring_stats.num_overflows;
+        stats->ringbuf_peak_used = ring_stats.peak_used;
+        stats->ringbuf_capacity = ring_stats.capacity;
+        stats->ringbuf_slabs = ring_stats.num_slabs;
+        stats->ringbuf_peak_slabs = ring_stats.peak_slabs;
+    }
+    g_static_mutex_unlock(&lcm->receive_lock);
+}
+
 int
 lcm_mpudpm_subscribe (lcm_mpudpm_t *lcm, const char *channel)
 {
@@ -1361,17 +1501,24 @@ lcm_mpudpm_handle (lcm_mpudpm_t *lcm)
     rbuf.recv_utime = lcmb->recv_utime;
     rbuf.lcm = lcm->lcm;
 
+    // reassembled messages are stored in a malloc()ed buffer, which handlers
+    // can take over with lcm_recv_buf_ref().  Ringbuffer space can't be
+    // handed out.
+    void **storage = lcmb->ringbuf ? NULL : (void **) &lcmb->buf;
+
     if(lcm->creating_read_thread) {
         // special case:  If we're creating the read thread and are in
         // self-test mode, then only dispatch the self-test message.
         if(!strcmp(lcmb->channel_name, SELF_TEST_CHANNEL))
-            lcm_dispatch_handlers (lcm->lcm, &rbuf, lcmb->channel_name);
+            lcm_dispatch_handlers_owned (lcm->lcm, &rbuf, lcmb->channel_name,
+                    storage);
     } else {
-        lcm_dispatch_handlers (lcm->lcm, &rbuf, lcmb->channel_name);
+        lcm_dispatch_handlers_owned (lcm->lcm, &rbuf, lcmb->channel_name,
+                storage);
     }
 
     g_static_mutex_lock (&lcm->receive_lock);
-    lcm_buf_free_data(lcmb, lcm->ringbuf);
+    lcm_buf_free_data(lcmb);
     lcm_buf_enqueue (lcm->inbufs_empty, lcmb);
     g_static_mutex_unlock (&lcm->receive_lock);
 
@@ -1532,6 +1679,12 @@ add_recv_socket(lcm_mpudpm_t *lcm, uint16_t port){
     setsockopt (recv_fd, SOL_SOCKET, SO_TIMESTAMP, &opt, sizeof (opt));
 #endif
 
+    /* Have the kernel report how many packets it drops on the socket */
+#ifdef SO_RXQ_OVFL
+    opt = 1;
+    setsockopt (recv_fd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof (opt));
+#endif
+
     if (bind (recv_fd, (struct sockaddr*)&addr, sizeof (addr)) < 0) {
         perror ("bind");
         goto add_recv_socket_fail;
@@ -1553,6 +1706,20 @@ add_recv_socket(lcm_mpudpm_t *lcm, uint16_t port){
     subscriber_socket->fd = recv_fd;
     subscriber_socket->port = port;
     subscriber_socket->num_subscribers =0;
+#ifdef HAVE_SYS_EPOLL_H
+    // start watching the new socket right away.  The read thread does not
+    // need to be interrupted.
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = subscriber_socket;
+    if (epoll_ctl(lcm->epoll_fd, EPOLL_CTL_ADD, recv_fd, &ev) < 0) {
+        perror("epoll_ctl (EPOLL_CTL_ADD)");
+        free(subscriber_socket);
+        goto add_recv_socket_fail;
+    }
+    lcm->recv_sockets = g_slist_prepend(lcm->recv_sockets, subscriber_socket);
+#else
     lcm->recv_sockets = g_slist_prepend(lcm->recv_sockets, subscriber_socket);
     lcm->recv_sockets_changed = 1;
 
@@ -1561,6 +1728,7 @@ add_recv_socket(lcm_mpudpm_t *lcm, uint16_t port){
     if (wstatus < 0) {
         perror(__FILE__ " thread_msg_pipe write: cancel_select");
     }
+#endif
     return subscriber_socket;
 
     add_recv_socket_fail:
@@ -1571,11 +1739,18 @@ add_recv_socket(lcm_mpudpm_t *lcm, uint16_t port){
 // This function assumes that the caller is holding the lcm->receive_lock
 static void
 remove_recv_socket(lcm_mpudpm_t *lcm, mpudpm_socket_t* sock){
+#ifdef HAVE_SYS_EPOLL_H
+    // stop watching the socket.  The read thread may already have an event
+    // referring to it, so also tell it to discard its current events.
+    if (lcm->epoll_fd >= 0)
+        epoll_ctl(lcm->epoll_fd, EPOLL_CTL_DEL, sock->fd, NULL);
+#else
     // Tell read thread that a select should be canceled
     int wstatus = lcm_internal_pipe_write(lcm->thread_msg_pipe[1], "c", 1);
     if (wstatus < 0) {
         perror(__FILE__ " thread_msg_pipe write: cancel_select");
     }
+#endif
     lcm->recv_sockets_changed = 1;
 
     lcm->recv_sockets = g_slist_remove(lcm->recv_sockets, sock);
@@ -1632,11 +1807,12 @@ setup_recv_parts (lcm_mpudpm_t *lcm)
 
     // allocate the fragment buffer hashtable
     lcm->frag_bufs = lcm_frag_buf_store_new(MAX_FRAG_BUF_TOTAL_SIZE,
-            MAX_NUM_FRAG_BUFS);
+            MAX_NUM_FRAG_BUFS, MAX_NUM_FRAG_BUFS_PER_SENDER);
+    lcm->buf_pool = lcm_buf_pool_new();
 
     lcm->inbufs_empty = lcm_buf_queue_new ();
     lcm->inbufs_filled = lcm_buf_queue_new ();
-    lcm->ringbuf = lcm_ringbuf_new (LCM_RINGBUF_SIZE);
+    lcm->ringbuf = lcm_ringbuf_params_create (&lcm->params.ringbuf);
 
     for (int i = 0; i < LCM_DEFAULT_RECV_BUFS; i++) {
         /* We don't set the receive buffer's data pointer yet because it
@@ -1652,6 +1828,26 @@ setup_recv_parts (lcm_mpudpm_t *lcm)
     }
     fcntl (lcm->thread_msg_pipe[1], F_SETFL, O_NONBLOCK);
 
+#ifdef HAVE_SYS_EPOLL_H
+    // the read thread waits on all of its sockets with epoll.  The
+    // thread_msg_pipe is registered with a NULL pointer to tell it apart from
+    // the receive sockets.
+    lcm->epoll_fd = epoll_create(MPUDPM_MAX_EPOLL_EVENTS);
+    if (lcm->epoll_fd < 0) {
+        perror(__FILE__ " epoll_create(setup)");
+        goto setup_recv_thread_fail;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(lcm->epoll_fd, EPOLL_CTL_ADD, lcm->thread_msg_pipe[0],
+                &ev) < 0) {
+        perror(__FILE__ " epoll_ctl(setup)");
+        goto setup_recv_thread_fail;
+    }
+#endif
+
     /* Start the reader thread */
     lcm->read_thread = g_thread_create (recv_thread, lcm, TRUE, NULL);
     if (!lcm->read_thread) {
@@ -1718,6 +1914,7 @@ lcm_mpudpm_create (lcm_t * parent, const char *network, const GHashTable *args)
     mpudpm_params_t params;
     memset (&params, 0, sizeof (mpudpm_params_t));
     params.num_mc_ports = 500;
+    lcm_ringbuf_params_init (&params.ringbuf);
 
     g_hash_table_foreach ((GHashTable*) args, new_argument, &params);
 
@@ -1732,12 +1929,15 @@ lcm_mpudpm_create (lcm_t * parent, const char *network, const GHashTable *args)
     lcm->recv_sockets = NULL;
     lcm->send_fd = -1;
     lcm->thread_msg_pipe[0] = lcm->thread_msg_pipe[1] = -1;
-    lcm->udp_low_watermark = 1.0;
+#ifdef HAVE_SYS_EPOLL_H
+    lcm->epoll_fd = -1;
+#endif
 
     lcm->kernel_rbuf_sz = 0;
     lcm->warned_about_small_kernel_buf = 0;
 
     lcm->frag_bufs = NULL;
+    lcm->buf_pool = NULL;
 
     // synchronization variables used when allocating receive resources
     lcm->creating_read_thread = 0;
@@ -1892,8 +2092,12 @@ lcm_mpudpm_provider_init (GPtrArray * providers)
     mpudpm_vtable.subscribe   = lcm_mpudpm_subscribe;
     mpudpm_vtable.unsubscribe = lcm_mpudpm_unsubscribe;
     mpudpm_vtable.publish     = lcm_mpudpm_publish;
+    mpudpm_vtable.publish_batch = NULL;
     mpudpm_vtable.handle      = lcm_mpudpm_handle;
+    mpudpm_vtable.handle_batch = NULL;
     mpudpm_vtable.get_fileno  = lcm_mpudpm_get_fileno;
+    mpudpm_vtable.get_stats   = lcm_mpudpm_get_stats;
+    mpudpm_vtable.has_subscribers = NULL;
 
     mpudpm_info.name = "mpudpm";
     mpudpm_info.vtable = &mpudpm_vtable;
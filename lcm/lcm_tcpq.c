@@ -428,8 +428,12 @@ lcm_tcpq_provider_init (GPtrArray * providers)
     tcpq_vtable.subscribe   = lcm_tcpq_subscribe;
     tcpq_vtable.unsubscribe = lcm_tcpq_unsubscribe;
     tcpq_vtable.publish     = lcm_tcpq_publish;
+    tcpq_vtable.publish_batch = NULL;
     tcpq_vtable.handle      = lcm_tcpq_handle;
+    tcpq_vtable.handle_batch = NULL;
     tcpq_vtable.get_fileno  = lcm_tcpq_get_fileno;
+    tcpq_vtable.get_stats   = NULL;
+    tcpq_vtable.has_subscribers = NULL;
 
     tcpq_info.name = "tcpq";
     tcpq_info.vtable = &tcpq_vtable;
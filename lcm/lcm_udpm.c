@@ -1,3 +1,8 @@
+#ifdef __linux__
+// needed for the declarations of recvmmsg() and sendmmsg()
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,6 +23,10 @@
 #include <sys/select.h>
 #endif
 
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
 #ifdef SO_TIMESTAMP
 #define MSG_EXT_HDR
 #endif
@@ -37,10 +46,38 @@
 #include "dbg.h"
 #include "ringbuffer.h"
 #include "udpm_util.h"
+#include "lcmtypes/channel_interest_t.h"
 
 
 #define SELF_TEST_CHANNEL "LCM_SELF_TEST"
 
+// channels used to advertise subscriber interest when the interest option is
+// enabled.  Messages on them are handled by the read thread.
+#define INTEREST_CHANNEL "LCM_INTEREST"
+#define INTEREST_REQUEST_CHANNEL "LCM_INTEREST_REQ"
+
+// subscriptions are advertised this often, and forgotten if they are not
+// renewed within INTEREST_LIFETIME.  Publishers transmit every channel until
+// they have been listening to advertisements for INTEREST_WARMUP.
+#define INTEREST_PERIOD 1000000
+#define INTEREST_LIFETIME (3 * INTEREST_PERIOD)
+#define INTEREST_WARMUP (INTEREST_PERIOD + INTEREST_PERIOD / 2)
+
+// the cache of which channels peers want is emptied when it reaches this
+// size, so that publishing to ever-changing channel names can't grow it
+// without bound
+#define INTEREST_CACHE_MAX 1024
+
+// upper bound on the recv_batch option.  Linux refuses to receive more than
+// UIO_MAXIOV (1024) datagrams per recvmmsg() call.
+#define LCM_MAX_RECV_BATCH 1024
+
+// size of the per-datagram control buffer used to receive kernel timestamps
+#define LCM_RECV_CONTROL_SIZE 64
+
+// maximum number of datagrams passed to a single sendmmsg() call
+#define LCM_MAX_SEND_BATCH 1024
+
 /**
  * udpm_params_t:
  * @mc_addr:        multicast address
@@ -51,6 +88,15 @@
  *                  don't use > 1.  that's just rude. 
  * @recv_buf_size:  requested size of the kernel receive buffer, set with
  *                  SO_RCVBUF.  0 indicates to use the default settings.
+ * @recv_batch:     maximum number of datagrams read by the receive thread
+ *                  with a single recvmmsg() call.  0 or 1 reads one datagram
+ *                  at a time.
+ * @send_batch:     if nonzero, transmit the fragments of large messages and
+ *                  the messages passed to lcm_publish_batch() with
+ *                  sendmmsg().  Ignored where sendmmsg() is unavailable.
+ * @ringbuf:        sizes of the ringbuffer holding received packets.
+ * @interest:       if nonzero, advertise subscriptions, and only transmit
+ *                  channels that some process subscribes to.
  *
  */
 typedef struct _udpm_params_t udpm_params_t;
@@ -59,7 +105,75 @@ struct _udpm_params_t {
     uint16_t mc_port;
     uint8_t mc_ttl; 
     int recv_buf_size;
+    int recv_batch;
+    int send_batch;
+    lcm_ringbuf_params_t ringbuf;
+    int interest;
+};
+
+/**
+ * udpm_interest_peer_t:
+ * Subscriptions advertised by another LCM instance.
+ *
+ * @channels:      the advertised channel names and regexes
+ * @regexes:       the same, compiled
+ * @expire_utime:  when to forget them, unless they are advertised again
+ */
+typedef struct _udpm_interest_peer_t udpm_interest_peer_t;
+struct _udpm_interest_peer_t {
+    char **channels;
+    GRegex **regexes;
+    int64_t expire_utime;
+};
+
+#ifdef HAVE_RECVMMSG
+/**
+ * udpm_recv_batch_t:
+ * Receive slots used by the read thread when recv_batch > 1.  Datagrams are
+ * received into a fixed set of 64 KB slots, and then complete messages are
+ * moved into the ringbuffer (short messages) or the fragment buffers (long
+ * messages), so that a slot can be reused as soon as a batch is processed.
+ *
+ * @nslots:   number of receive slots
+ * @msgs:     message headers passed to recvmmsg()
+ * @iovecs:   one iovec per slot, pointing into @data
+ * @from:     source address of each datagram
+ * @control:  control buffers used to receive SO_TIMESTAMP
+ * @data:     the slots themselves, 65536 bytes each
+ * @staged:   metadata of the complete messages found in the current batch
+ */
+typedef struct _udpm_recv_batch_t udpm_recv_batch_t;
+struct _udpm_recv_batch_t {
+    int nslots;
+    struct mmsghdr *msgs;
+    struct iovec *iovecs;
+    struct sockaddr *from;
+    char *control;
+    char *data;
+    lcm_buf_t *staged;
 };
+#endif
+
+#ifdef HAVE_SENDMMSG
+/**
+ * udpm_send_batch_t:
+ * Scratch space used to transmit several datagrams with sendmmsg().  Only
+ * accessed with the transmit lock held, and grown as needed.
+ *
+ * @capacity: number of datagrams that fit in the arrays below
+ * @msgs:     message headers passed to sendmmsg()
+ * @iovecs:   three iovecs per datagram (header, channel, payload)
+ * @hdrs:     LCM headers, one per datagram.  Short messages use the first
+ *            fields of the entry, which match lcm2_header_short_t.
+ */
+typedef struct _udpm_send_batch_t udpm_send_batch_t;
+struct _udpm_send_batch_t {
+    int capacity;
+    struct mmsghdr *msgs;
+    struct iovec *iovecs;
+    lcm2_header_long_t *hdrs;
+};
+#endif
 
 typedef struct _lcm_provider_t lcm_udpm_t;
 struct _lcm_provider_t {
@@ -75,23 +189,43 @@ struct _lcm_provider_t {
     int kernel_rbuf_sz;
     int warned_about_small_kernel_buf;
 
-    /* Packet structures available for sending or receiving use are
-     * stored in the *_empty queues. */
+    /* Packet structures available for receiving use are stored in the
+     * *_empty queue.  Only accessed by the read thread. */
     lcm_buf_queue_t * inbufs_empty;
-    /* Received packets that are filled with data are queued here. */
-    lcm_buf_queue_t * inbufs_filled;
+    /* Received packets that are filled with data are passed from the read
+     * thread to lcm_handle () through this lock-free ring. */
+    lcm_buf_ring_t * inbufs_filled;
+    /* Number of packets in inbufs_filled that lcm_handle () has not yet been
+     * notified of.  notify_pipe is signalled when this goes from 0 to 1. */
+    volatile gint num_filled;
+    /* Packets taken off inbufs_filled early so that the highest priority one
+     * can be dispatched first.  They are still counted in num_filled.  Only
+     * accessed by lcm_handle (). */
+    lcm_buf_t * pending[LCM_PRIORITY_WINDOW];
+    int num_pending;
+    /* Packets that have been handled are passed back to the read thread
+     * through this lock-free ring, and returned to inbufs_empty there. */
+    lcm_buf_ring_t * inbufs_recycled;
 
     /* Memory for received small packets is taken from a fixed-size ring buffer
-     * so we don't have to do any mallocs */
+     * so we don't have to do any mallocs.  Only modified by the read thread. */
     lcm_ringbuf_t * ringbuf;
 
-    GStaticRecMutex mutex; /* Must be locked when reading/writing to the
-                              above three queues */
+    GStaticRecMutex mutex; /* Must be locked when setting up or tearing down
+                              the receive resources */
 
     int thread_created;
     GThread *read_thread;
-    int notify_pipe[2];         // pipe to notify application when messages arrive
+    // notifies the application when messages arrive.  If eventfd() is
+    // available, both ends are the same eventfd descriptor.
+    int notify_pipe[2];
     int thread_msg_pipe[2];     // pipe to notify read thread when to quit
+    /* Set by the read thread while it waits for room in inbufs_filled.
+     * lcm_handle () clears it and signals space_pipe once it has taken a
+     * packet off the ring.  If eventfd() is available, both ends of
+     * space_pipe are the same eventfd descriptor. */
+    volatile gint read_thread_waiting;
+    int space_pipe[2];
 
     GStaticMutex transmit_lock; // so that only thread at a time can transmit
 
@@ -104,20 +238,225 @@ struct _lcm_provider_t {
 
     /* other variables */
     lcm_frag_buf_store * frag_bufs;
+    /* payload buffers of large messages */
+    lcm_buf_pool_t * buf_pool;
+
+#ifdef HAVE_RECVMMSG
+    /* receive slots, allocated only when batched receive is enabled */
+    udpm_recv_batch_t * recv_batch;
+#endif
 
-    uint32_t     udp_rx;            // packets received and processed
-    uint32_t     udp_discarded_bad; // packets discarded because they were bad 
+#ifdef HAVE_SENDMMSG
+    udpm_send_batch_t send_batch;
+#endif
+
+    /* receive statistics, updated by the read thread and reported by
+     * lcm_get_stats () */
+    uint64_t     udp_rx;            // packets received
+    uint64_t     udp_rx_bytes;      // bytes received
+    uint64_t     udp_discarded_bad; // packets discarded because they were bad 
                                     // somehow
-    double       udp_low_watermark; // least buffer available
-    int32_t      udp_last_report_secs;
+    uint32_t     udp_kernel_drops;  // packets dropped by the kernel, as
+                                    // reported by SO_RXQ_OVFL
 
     uint32_t     msg_seqno; // rolling counter of how many messages transmitted
+
+    /* subscriber interest, used when the interest option is enabled.  The
+     * tables are guarded by interest_lock. */
+    GStaticMutex interest_lock;
+    int64_t      interest_sender_id;
+    GHashTable  *interest_peers;        // sender id -> udpm_interest_peer_t
+    GHashTable  *interest_cache;        // channel -> whether a peer wants it
+    int64_t      interest_expire_utime; // when the next peer may expire
+    int64_t      interest_listen_utime; // when advertisements started arriving
+    int64_t      interest_next_advert;  // only accessed by the read thread
+    int          interest_advertised;   // last advertisement was not empty
 };
 
 static int _setup_recv_parts (lcm_udpm_t *lcm);
+static int lcm_udpm_publish (lcm_udpm_t *lcm, const char *channel,
+        const void *data, unsigned int datalen);
 
 static GStaticPrivate CREATE_READ_THREAD_PKEY = G_STATIC_PRIVATE_INIT;
 
+// wake up lcm_handle ()
+static void
+_notify_signal (lcm_udpm_t *lcm)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t one = 1;
+    if (write (lcm->notify_pipe[1], &one, sizeof (one)) < 0)
+        perror ("write to notify");
+#else
+    if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0)
+        perror ("write to notify");
+#endif
+}
+
+// block until _notify_signal () has been called.  Returns 0 on success, -1 on
+// error.
+static int
+_notify_wait (lcm_udpm_t *lcm)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t count;
+    int status = read (lcm->notify_pipe[0], &count, sizeof (count));
+#else
+    char ch;
+    int status = lcm_internal_pipe_read(lcm->notify_pipe[0], &ch, 1);
+#endif
+    if (status == 0) {
+        fprintf (stderr, "Error: lcm_handle read 0 bytes from notify_pipe\n");
+        return -1;
+    }
+    else if (status < 0) {
+        fprintf (stderr, "Error: lcm_handle read: %s\n", strerror (errno));
+        return -1;
+    }
+    return 0;
+}
+
+// wake up the read thread if it is waiting for room in inbufs_filled.  Called
+// by lcm_handle () after taking a packet off the ring.
+static void
+_space_signal (lcm_udpm_t *lcm)
+{
+    if (!g_atomic_int_get (&lcm->read_thread_waiting) ||
+            !g_atomic_int_compare_and_exchange (&lcm->read_thread_waiting,
+                1, 0))
+        return;
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t one = 1;
+    if (write (lcm->space_pipe[1], &one, sizeof (one)) < 0)
+        perror ("write to space_pipe");
+#else
+    if (lcm_internal_pipe_write(lcm->space_pipe[1], "+", 1) < 0)
+        perror ("write to space_pipe");
+#endif
+}
+
+// consume the wakeups sent by _space_signal ().  Must only be called from the
+// read thread, once space_pipe is readable.
+static void
+_space_drain (lcm_udpm_t *lcm)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t count;
+    if (read (lcm->space_pipe[0], &count, sizeof (count)) < 0)
+        perror ("read from space_pipe");
+#else
+    char buf[16];
+    if (lcm_internal_pipe_read(lcm->space_pipe[0], buf, sizeof (buf)) < 0)
+        perror ("read from space_pipe");
+#endif
+}
+
+// return buffers released by lcm_handle () to inbufs_empty, and their data to
+// the ringbuffer.  Must only be called from the read thread.
+static void
+_reclaim_bufs (lcm_udpm_t *lcm)
+{
+    lcm_buf_t *lcmb;
+    while ((lcmb = lcm_buf_ring_pop (lcm->inbufs_recycled))) {
+        lcm_buf_free_data(lcmb);
+        lcm_buf_enqueue (lcm->inbufs_empty, lcmb);
+    }
+}
+
+// Queue a complete message for future retrieval by lcm_handle ().  Must only be
+// called from the read thread.  If the application is not keeping up and the
+// ring is full, sleeps until lcm_handle () makes room.  Returns 0 on success,
+// or -1 if the read thread was told to exit while waiting, in which case lcmb
+// is released.  The message then stays counted by lcm_try_enqueue_message,
+// which no longer matters since the provider is being destroyed.
+static int
+_queue_filled_buf (lcm_udpm_t *lcm, lcm_buf_t *lcmb)
+{
+    // Reclaiming before every push bounds the number of buffers in
+    // inbufs_recycled to less than twice the size of inbufs_filled.
+    _reclaim_bufs (lcm);
+    while (!lcm_buf_ring_push (lcm->inbufs_filled, lcmb)) {
+        // Ask for a wakeup, then try again in case lcm_handle () took a
+        // packet off the ring before it could see the request.
+        g_atomic_int_compare_and_exchange (&lcm->read_thread_waiting, 0, 1);
+        if (lcm_buf_ring_push (lcm->inbufs_filled, lcmb)) {
+            g_atomic_int_compare_and_exchange (&lcm->read_thread_waiting,
+                    1, 0);
+            break;
+        }
+
+        fd_set fds;
+        FD_ZERO (&fds);
+        FD_SET (lcm->thread_msg_pipe[0], &fds);
+        FD_SET (lcm->space_pipe[0], &fds);
+        SOCKET maxfd = MAX(lcm->thread_msg_pipe[0], lcm->space_pipe[0]);
+        if (select (maxfd + 1, &fds, NULL, NULL, NULL) < 0) {
+            if (errno != EINTR)
+                perror ("_queue_filled_buf -- select");
+            continue;
+        }
+        if (FD_ISSET (lcm->thread_msg_pipe[0], &fds)) {
+            dbg (DBG_LCM, "read thread received exit command\n");
+            lcm_buf_free_data(lcmb);
+            free (lcmb);
+            return -1;
+        }
+        _space_drain (lcm);
+        _reclaim_bufs (lcm);
+    }
+
+    /* Notify the reading thread only when the number of pending messages
+     * transitions from zero to non-zero.  lcm_handle () re-arms the
+     * notification if messages remain after it dequeues one. */
+    if (g_atomic_int_exchange_and_add (&lcm->num_filled, 1) == 0)
+        _notify_signal (lcm);
+    return 0;
+}
+
+#ifdef HAVE_RECVMMSG
+static udpm_recv_batch_t *
+_recv_batch_new (int nslots)
+{
+    udpm_recv_batch_t *batch =
+        (udpm_recv_batch_t *) calloc (1, sizeof (udpm_recv_batch_t));
+    batch->nslots = nslots;
+    batch->msgs = (struct mmsghdr *) calloc (nslots, sizeof (struct mmsghdr));
+    batch->iovecs = (struct iovec *) calloc (nslots, sizeof (struct iovec));
+    batch->from = (struct sockaddr *) calloc (nslots, sizeof (struct sockaddr));
+    batch->control = (char *) calloc (nslots, LCM_RECV_CONTROL_SIZE);
+    batch->data = (char *) malloc ((size_t) nslots * 65536);
+    batch->staged = (lcm_buf_t *) calloc (nslots, sizeof (lcm_buf_t));
+
+    for (int i = 0; i < nslots; i++) {
+        char *slot = batch->data + (size_t) i * 65536;
+        // zero the last byte so that strlen never segfaults.  recvmmsg()
+        // never writes to it.
+        slot[65535] = 0;
+        batch->iovecs[i].iov_base = slot;
+        batch->iovecs[i].iov_len = 65535;
+
+        struct msghdr *msg = &batch->msgs[i].msg_hdr;
+        msg->msg_name = &batch->from[i];
+        msg->msg_iov = &batch->iovecs[i];
+        msg->msg_iovlen = 1;
+        msg->msg_control = batch->control + i * LCM_RECV_CONTROL_SIZE;
+    }
+    return batch;
+}
+
+static void
+_recv_batch_free (udpm_recv_batch_t *batch)
+{
+    free (batch->msgs);
+    free (batch->iovecs);
+    free (batch->from);
+    free (batch->control);
+    free (batch->data);
+    free (batch->staged);
+    free (batch);
+}
+#endif
+
 static void
 _destroy_recv_parts (lcm_udpm_t *lcm)
 {
@@ -139,6 +478,14 @@ _destroy_recv_parts (lcm_udpm_t *lcm)
         lcm->thread_msg_pipe[0] = lcm->thread_msg_pipe[1] = -1;
     }
 
+    if (lcm->space_pipe[0] >= 0) {
+        lcm_internal_pipe_close(lcm->space_pipe[0]);
+        if (lcm->space_pipe[1] != lcm->space_pipe[0])
+            lcm_internal_pipe_close(lcm->space_pipe[1]);
+        lcm->space_pipe[0] = lcm->space_pipe[1] = -1;
+    }
+    lcm->read_thread_waiting = 0;
+
     if (lcm->recvfd >= 0) {
         lcm_close_socket(lcm->recvfd);
         lcm->recvfd = -1;
@@ -149,18 +496,45 @@ _destroy_recv_parts (lcm_udpm_t *lcm)
         lcm->frag_bufs = NULL;
     }
 
+#ifdef HAVE_RECVMMSG
+    if (lcm->recv_batch) {
+        _recv_batch_free (lcm->recv_batch);
+        lcm->recv_batch = NULL;
+    }
+#endif
+
     if (lcm->inbufs_empty) {
-        lcm_buf_queue_free (lcm->inbufs_empty, lcm->ringbuf);
+        lcm_buf_queue_free (lcm->inbufs_empty);
         lcm->inbufs_empty = NULL;
     }
     if (lcm->inbufs_filled) {
-        lcm_buf_queue_free (lcm->inbufs_filled, lcm->ringbuf);
+        lcm_buf_ring_free (lcm->inbufs_filled);
         lcm->inbufs_filled = NULL;
     }
+    for (int i = 0; i < lcm->num_pending; i++) {
+        lcm_buf_free_data (lcm->pending[i]);
+        free (lcm->pending[i]);
+    }
+    lcm->num_pending = 0;
+    if (lcm->inbufs_recycled) {
+        lcm_buf_ring_free (lcm->inbufs_recycled);
+        lcm->inbufs_recycled = NULL;
+    }
+    lcm->num_filled = 0;
     if (lcm->ringbuf) {
+        lcm_ringbuf_stats_t stats;
+        lcm_ringbuf_get_stats (lcm->ringbuf, &stats);
+        dbg (DBG_LCM, "receive ringbuffer peaked at %u slabs, %u bytes used; "
+                "%llu packets dropped at the high watermark\n",
+                stats.peak_slabs, stats.peak_used,
+                (unsigned long long) stats.num_overflows);
         lcm_ringbuf_free (lcm->ringbuf);
         lcm->ringbuf = NULL;
     }
+    if (lcm->buf_pool) {
+        lcm_buf_pool_destroy (lcm->buf_pool);
+        lcm->buf_pool = NULL;
+    }
 }
 
 void
@@ -173,10 +547,23 @@ lcm_udpm_destroy (lcm_udpm_t *lcm)
         lcm_close_socket(lcm->sendfd);
 
     lcm_internal_pipe_close(lcm->notify_pipe[0]);
-    lcm_internal_pipe_close(lcm->notify_pipe[1]);
+    if (lcm->notify_pipe[1] != lcm->notify_pipe[0])
+        lcm_internal_pipe_close(lcm->notify_pipe[1]);
+
+#ifdef HAVE_SENDMMSG
+    free (lcm->send_batch.msgs);
+    free (lcm->send_batch.iovecs);
+    free (lcm->send_batch.hdrs);
+#endif
+
+    if (lcm->interest_peers) {
+        g_hash_table_destroy (lcm->interest_peers);
+        g_hash_table_destroy (lcm->interest_cache);
+    }
 
     g_static_rec_mutex_free (&lcm->mutex);
     g_static_mutex_free (&lcm->transmit_lock);
+    g_static_mutex_free (&lcm->interest_lock);
     if(lcm->create_read_thread_mutex) {
         g_mutex_free(lcm->create_read_thread_mutex);
         g_cond_free(lcm->create_read_thread_cond);
@@ -228,6 +615,34 @@ new_argument (gpointer key, gpointer value, gpointer user)
         if (endptr == value)
             fprintf (stderr, "Warning: Invalid value for ttl\n");
     }
+    else if (!strcmp ((char *) key, "recv_batch")) {
+        char *endptr = NULL;
+        params->recv_batch = strtol ((char *) value, &endptr, 0);
+        if (endptr == value)
+            fprintf (stderr, "Warning: Invalid value for recv_batch\n");
+#ifdef HAVE_RECVMMSG
+        if (params->recv_batch > LCM_MAX_RECV_BATCH) {
+            fprintf (stderr, "Warning: recv_batch must be <= %d.  "
+                    "Setting to %d\n", LCM_MAX_RECV_BATCH, LCM_MAX_RECV_BATCH);
+            params->recv_batch = LCM_MAX_RECV_BATCH;
+        }
+#else
+        if (params->recv_batch > 1)
+            fprintf (stderr, "Warning: recv_batch is not supported on this "
+                    "platform and will be ignored\n");
+        params->recv_batch = 0;
+#endif
+    }
+    else if (!strcmp ((char *) key, "send_batch")) {
+        params->send_batch = atoi ((char *) value) != 0;
+    }
+    else if (lcm_ringbuf_params_parse (&params->ringbuf, (char *) key,
+                (char *) value)) {
+        // ringbuf_* options
+    }
+    else if (!strcmp ((char *) key, "interest")) {
+        params->interest = atoi ((char *) value) != 0;
+    }
     else if (!strcmp ((char *) key, "transmit_only")) {
         fprintf (stderr, "%s:%d -- transmit_only option is now obsolete\n",
                 __FILE__, __LINE__);
@@ -238,15 +653,296 @@ new_argument (gpointer key, gpointer value, gpointer user)
     }
 }
 
+// Returns nonzero for the channels that LCM uses internally.  They are never
+// advertised or filtered.
+static int
+_interest_internal_channel (const char *channel)
+{
+    return !strcmp (channel, INTEREST_CHANNEL) ||
+        !strcmp (channel, INTEREST_REQUEST_CHANNEL) ||
+        !strcmp (channel, SELF_TEST_CHANNEL);
+}
+
+static void
+_interest_peer_free (gpointer data)
+{
+    udpm_interest_peer_t *peer = (udpm_interest_peer_t *) data;
+    int n = g_strv_length (peer->channels);
+    for (int i = 0; i < n; i++)
+        if (peer->regexes[i])
+            g_regex_unref (peer->regexes[i]);
+    g_free (peer->regexes);
+    g_strfreev (peer->channels);
+    free (peer);
+}
+
+// Multicasts the channels subscribed to by this instance, plus channel if it
+// is not NULL (a subscription that is being added).  Nothing is sent if there
+// are no subscriptions and none were advertised previously.
+static void
+_interest_advertise (lcm_udpm_t *lcm, const char *channel)
+{
+    char **subscribed = lcm_get_subscribed_channels (lcm->lcm);
+
+    channel_interest_t msg;
+    msg.sender_id = lcm->interest_sender_id;
+    msg.lifetime_usec = INTEREST_LIFETIME;
+    msg.num_channels = 0;
+    msg.channels = (char **) malloc ((g_strv_length (subscribed) + 1) *
+            sizeof (char *));
+    for (int i = 0; subscribed[i]; i++)
+        if (!_interest_internal_channel (subscribed[i]))
+            msg.channels[msg.num_channels++] = subscribed[i];
+    if (channel && !_interest_internal_channel (channel))
+        msg.channels[msg.num_channels++] = (char *) channel;
+
+    if (msg.num_channels || lcm->interest_advertised) {
+        lcm->interest_advertised = msg.num_channels > 0;
+
+        char *everything = ".*";
+        int size = channel_interest_t_encoded_size (&msg);
+        if (sizeof (INTEREST_CHANNEL) + size > LCM_SHORT_MESSAGE_MAX_SIZE) {
+            // too many subscriptions to list in a single datagram.  Ask for
+            // every channel instead.
+            msg.num_channels = 1;
+            msg.channels[0] = everything;
+            size = channel_interest_t_encoded_size (&msg);
+        }
+
+        void *buf = malloc (size);
+        channel_interest_t_encode (buf, 0, size, &msg);
+        lcm_udpm_publish (lcm, INTEREST_CHANNEL, buf, size);
+        free (buf);
+    }
+
+    free (msg.channels);
+    g_strfreev (subscribed);
+}
+
+// Sends the periodic advertisement when it is due.  Called by the read
+// thread.  Returns the timeout to use for select (), or NULL if the interest
+// option is disabled.
+static struct timeval *
+_interest_tick (lcm_udpm_t *lcm, struct timeval *timeout)
+{
+    if (!lcm->params.interest)
+        return NULL;
+
+    int64_t now = lcm_timestamp_now ();
+    if (now >= lcm->interest_next_advert) {
+        _interest_advertise (lcm, NULL);
+        lcm->interest_next_advert = now + INTEREST_PERIOD;
+    }
+    int64_t wait = lcm->interest_next_advert - now;
+    timeout->tv_sec = wait / 1000000;
+    timeout->tv_usec = wait % 1000000;
+    return timeout;
+}
+
+static int
+_interest_same_channels (char **channels, const channel_interest_t *msg)
+{
+    if ((int) g_strv_length (channels) != msg->num_channels)
+        return 0;
+    for (int i = 0; i < msg->num_channels; i++)
+        if (strcmp (channels[i], msg->channels[i]))
+            return 0;
+    return 1;
+}
+
+// Records the subscriptions advertised by another instance.  Caller must hold
+// the interest lock.
+static void
+_interest_update_peer (lcm_udpm_t *lcm, const channel_interest_t *msg,
+        int64_t now)
+{
+    char key[32];
+    snprintf (key, sizeof (key), "%lld", (long long) msg->sender_id);
+
+    udpm_interest_peer_t *peer = (udpm_interest_peer_t *)
+        g_hash_table_lookup (lcm->interest_peers, key);
+    if (!peer || !_interest_same_channels (peer->channels, msg)) {
+        peer = (udpm_interest_peer_t *) calloc (1,
+                sizeof (udpm_interest_peer_t));
+        peer->channels = (char **) g_malloc0 ((msg->num_channels + 1) *
+                sizeof (char *));
+        peer->regexes = (GRegex **) g_malloc0 ((msg->num_channels + 1) *
+                sizeof (GRegex *));
+        for (int i = 0; i < msg->num_channels; i++) {
+            peer->channels[i] = g_strdup (msg->channels[i]);
+            char *pattern = g_strdup_printf ("^%s$", msg->channels[i]);
+            peer->regexes[i] = g_regex_new (pattern, (GRegexCompileFlags) 0,
+                    (GRegexMatchFlags) 0, NULL);
+            if (!peer->regexes[i])
+                dbg (DBG_LCM, "ignoring bad interest regex [%s]\n", pattern);
+            g_free (pattern);
+        }
+        g_hash_table_replace (lcm->interest_peers, g_strdup (key), peer);
+        g_hash_table_remove_all (lcm->interest_cache);
+    }
+
+    int64_t lifetime = msg->lifetime_usec > 0 ?
+        msg->lifetime_usec : INTEREST_LIFETIME;
+    peer->expire_utime = now + lifetime;
+    if (!lcm->interest_expire_utime ||
+            peer->expire_utime < lcm->interest_expire_utime)
+        lcm->interest_expire_utime = peer->expire_utime;
+}
+
+// Handles a message on one of the interest channels.  Called by the read
+// thread.
+static void
+_interest_received (lcm_udpm_t *lcm, const char *channel, const char *data,
+        int datalen)
+{
+    if (!strcmp (channel, INTEREST_REQUEST_CHANNEL)) {
+        // a new instance wants to know who is listening
+        _interest_advertise (lcm, NULL);
+        return;
+    }
+
+    channel_interest_t msg;
+    if (channel_interest_t_decode (data, 0, datalen, &msg) < 0) {
+        lcm->udp_discarded_bad++;
+        return;
+    }
+    if (msg.sender_id != lcm->interest_sender_id) {
+        int64_t now = lcm_timestamp_now ();
+        g_static_mutex_lock (&lcm->interest_lock);
+        _interest_update_peer (lcm, &msg, now);
+        g_static_mutex_unlock (&lcm->interest_lock);
+    }
+    channel_interest_t_decode_cleanup (&msg);
+}
+
+typedef struct {
+    int64_t now;
+    int64_t next_expire_utime;
+} interest_expire_t;
+
+static gboolean
+_interest_peer_expired (gpointer key, gpointer value, gpointer user)
+{
+    udpm_interest_peer_t *peer = (udpm_interest_peer_t *) value;
+    interest_expire_t *expire = (interest_expire_t *) user;
+    if (peer->expire_utime <= expire->now)
+        return TRUE;
+    if (!expire->next_expire_utime ||
+            peer->expire_utime < expire->next_expire_utime)
+        expire->next_expire_utime = peer->expire_utime;
+    return FALSE;
+}
+
+// Forgets the peers whose advertisements have not been renewed.  Caller must
+// hold the interest lock.
+static void
+_interest_expire_peers (lcm_udpm_t *lcm, int64_t now)
+{
+    interest_expire_t expire = { now, 0 };
+    if (g_hash_table_foreach_remove (lcm->interest_peers,
+                _interest_peer_expired, &expire))
+        g_hash_table_remove_all (lcm->interest_cache);
+    lcm->interest_expire_utime = expire.next_expire_utime;
+}
+
+// Returns nonzero if some peer subscribes to channel.  Caller must hold the
+// interest lock.
+static int
+_interest_match (lcm_udpm_t *lcm, const char *channel)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init (&iter, lcm->interest_peers);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        udpm_interest_peer_t *peer = (udpm_interest_peer_t *) value;
+        for (int i = 0; peer->channels[i]; i++) {
+            if (!strcmp (peer->channels[i], channel) ||
+                    (peer->regexes[i] && g_regex_match (peer->regexes[i],
+                        channel, (GRegexMatchFlags) 0, NULL)))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+// Returns zero if the interest option is enabled and nobody has advertised a
+// subscription to channel, in which case there is no point transmitting it.
+static int
+_interest_wanted (lcm_udpm_t *lcm, const char *channel)
+{
+    // advertisements are only received once the read thread is running,
+    // which lcm_udpm_create() starts
+    if (!lcm->params.interest || !lcm->thread_created ||
+            _interest_internal_channel (channel) ||
+            lcm_has_handlers (lcm->lcm, channel))
+        return 1;
+
+    int64_t now = lcm_timestamp_now ();
+    int wanted = 1;
+    g_static_mutex_lock (&lcm->interest_lock);
+    // until every peer has had a chance to advertise, transmit everything
+    if (lcm->interest_listen_utime &&
+            now - lcm->interest_listen_utime >= INTEREST_WARMUP) {
+        if (lcm->interest_expire_utime && now >= lcm->interest_expire_utime)
+            _interest_expire_peers (lcm, now);
+
+        gpointer cached;
+        if (g_hash_table_lookup_extended (lcm->interest_cache, channel, NULL,
+                    &cached)) {
+            wanted = GPOINTER_TO_INT (cached);
+        } else {
+            wanted = _interest_match (lcm, channel);
+            if (g_hash_table_size (lcm->interest_cache) >= INTEREST_CACHE_MAX)
+                g_hash_table_remove_all (lcm->interest_cache);
+            g_hash_table_insert (lcm->interest_cache, g_strdup (channel),
+                    GINT_TO_POINTER (wanted));
+        }
+    }
+    g_static_mutex_unlock (&lcm->interest_lock);
+    return wanted;
+}
+
+// Called once the payload of a fragment received in lcmb has been placed in
+// fbuf.  If the message is complete, moves it into lcmb and returns 1.
+static int
+_fragment_received (lcm_udpm_t *lcm, lcm_buf_t *lcmb, lcm_frag_buf_t *fbuf)
+{
+    fbuf->last_packet_utime = lcmb->recv_utime;
+
+    fbuf->fragments_remaining --;
+
+    if (0 == fbuf->fragments_remaining) {
+        // complete message received.  Is there a subscriber that still
+        // wants it?  (i.e., does any subscriber have space in its queue?)
+        if(!lcm_try_enqueue_message(lcm->lcm, fbuf->channel)) {
+            // no... sad... free the fragment buffer and return
+            lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
+            return 0;
+        }
+
+        // yes, transfer the message into the lcm_buf_t
+
+        // deallocate the ringbuffer-allocated buffer.  Packets received in
+        // batches are not on the ringbuffer, and their slot is simply reused.
+        if (lcmb->ringbuf)
+            lcm_buf_free_data(lcmb);
+
+        lcm_frag_buf_transfer (fbuf, lcmb);
+
+        // don't need the fragment buffer anymore
+        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
+
+        return 1;
+    }
+
+    return 0;
+}
+
 static int 
 _recv_message_fragment (lcm_udpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
 {
     lcm2_header_long_t *hdr = (lcm2_header_long_t*) lcmb->buf;
 
-    // any existing fragment buffer for this message source?
-    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(lcm->frag_bufs,
-            &lcmb->from);
-
     uint32_t msg_seqno = ntohl (hdr->msg_seqno);
     uint32_t data_size = ntohl (hdr->msg_size);
     uint32_t fragment_offset = ntohl (hdr->fragment_offset);
@@ -255,12 +951,17 @@ _recv_message_fragment (lcm_udpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
     uint32_t frag_size = sz - sizeof (lcm2_header_long_t);
     char *data_start = (char*) (hdr + 1);
 
-    // discard any stale fragments from previous messages
-    if (fbuf && ((fbuf->msg_seqno != msg_seqno) ||
-                 (fbuf->data_size != data_size))) {
-        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
+    // any existing fragment buffer for this message?  Fragment buffers of
+    // other messages from the same source are left alone, since a sender may
+    // interleave the fragments of several messages.
+    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(lcm->frag_bufs,
+            &lcmb->from, msg_seqno);
+
+    // discard a fragment buffer that doesn't match the message
+    if (fbuf && fbuf->data_size != data_size) {
         dbg(DBG_LCM, "Dropping message (missing %d fragments)\n",
             fbuf->fragments_remaining);
+        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
         fbuf = NULL;
     }
 
@@ -287,7 +988,8 @@ _recv_message_fragment (lcm_udpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
         if(!lcm_has_handlers(lcm->lcm, channel))
             return 0;
 
-        fbuf = lcm_frag_buf_new (*((struct sockaddr_in*) &lcmb->from),
+        fbuf = lcm_frag_buf_new (lcm->buf_pool,
+                *((struct sockaddr_in*) &lcmb->from),
                 channel, msg_seqno, data_size, fragments_in_msg,
                 lcmb->recv_utime);
         lcm_frag_buf_store_add (lcm->frag_bufs, fbuf);
@@ -322,43 +1024,8 @@ _recv_message_fragment (lcm_udpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
 
     // copy data
     memcpy (fbuf->data + fragment_offset, data_start, frag_size);
-    fbuf->last_packet_utime = lcmb->recv_utime;
-
-    fbuf->fragments_remaining --;
-
-    if (0 == fbuf->fragments_remaining) {
-        // complete message received.  Is there a subscriber that still
-        // wants it?  (i.e., does any subscriber have space in its queue?)
-        if(!lcm_try_enqueue_message(lcm->lcm, fbuf->channel)) {
-            // no... sad... free the fragment buffer and return
-            lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
-            return 0;
-        }
-
-        // yes, transfer the message into the lcm_buf_t
 
-        // deallocate the ringbuffer-allocated buffer
-        g_static_rec_mutex_lock (&lcm->mutex);
-        lcm_buf_free_data(lcmb, lcm->ringbuf);
-        g_static_rec_mutex_unlock (&lcm->mutex);
-
-        // transfer ownership of the message's payload buffer
-        lcmb->buf = fbuf->data;
-        fbuf->data = NULL;
-
-        strcpy (lcmb->channel_name, fbuf->channel);
-        lcmb->channel_size = strlen (lcmb->channel_name);
-        lcmb->data_offset = 0;
-        lcmb->data_size = fbuf->data_size;
-        lcmb->recv_utime = fbuf->last_packet_utime;
-
-        // don't need the fragment buffer anymore
-        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
-
-        return 1;
-    }
-
-    return 0;
+    return _fragment_received (lcm, lcmb, fbuf);
 }
 
 static int
@@ -378,11 +1045,42 @@ _recv_short_message (lcm_udpm_t *lcm, lcm_buf_t *lcmb, int sz)
         return 0;
     }
 
-    lcm->udp_rx++;
+    // advertisements are consumed by the read thread
+    if (lcm->params.interest &&
+            (!strcmp (pkt_channel_str, INTEREST_CHANNEL) ||
+             !strcmp (pkt_channel_str, INTEREST_REQUEST_CHANNEL))) {
+        int offset = sizeof (lcm2_header_short_t) + lcmb->channel_size + 1;
+        _interest_received (lcm, pkt_channel_str, lcmb->buf + offset,
+                sz - offset);
+        return 0;
+    }
+
+    // a packet received in a batch is still in its receive slot.  Reserve
+    // exactly as much space as it needs on the ringbuffer before
+    // lcm_try_enqueue_message counts it as queued, since the message can't
+    // be dropped after that.
+    char *ring_buf = NULL;
+    if (!lcmb->ringbuf) {
+        ring_buf = lcm_ringbuf_alloc (lcm->ringbuf, sz);
+        if (!ring_buf) {
+            // the ringbuffer is at its high watermark.  Drop the message.
+            return 0;
+        }
+    }
 
     // if the packet has no subscribers, drop the message now.
-    if(!lcm_try_enqueue_message(lcm->lcm, pkt_channel_str))
+    if(!lcm_try_enqueue_message(lcm->lcm, pkt_channel_str)) {
+        if (ring_buf)
+            lcm_ringbuf_dealloc (lcm->ringbuf, ring_buf);
         return 0;
+    }
+
+    if (ring_buf) {
+        memcpy (ring_buf, lcmb->buf, sz);
+        lcmb->buf = ring_buf;
+        lcmb->ringbuf = lcm->ringbuf;
+        lcmb->buf_size = sz;
+    }
 
     strcpy (lcmb->channel_name, pkt_channel_str);
 
@@ -401,37 +1099,6 @@ udp_read_packet (lcm_udpm_t *lcm)
 
     int sz = 0;
 
-    // TODO warn about message loss somewhere else.
-
-//    g_static_rec_mutex_lock (&lcm->mutex);
-//    unsigned int ring_capacity = lcm_ringbuf_capacity(lcm->ringbuf);
-//    unsigned int ring_used = lcm_ringbuf_used(lcm->ringbuf);
-//    double buf_avail = ((double)(ring_capacity - ring_used)) / ring_capacity;
-//    g_static_rec_mutex_unlock (&lcm->mutex);
-//    if (buf_avail < lcm->udp_low_watermark)
-//        lcm->udp_low_watermark = buf_avail;
-//
-//    GTimeVal tv;
-//    g_get_current_time(&tv);
-//    int elapsedsecs = tv.tv_sec - lcm->udp_last_report_secs;
-//    if (elapsedsecs > 2) {
-//        uint32_t total_bad = lcm->udp_discarded_bad;
-//        if (total_bad > 0 || lcm->udp_low_watermark < 0.5) {
-//            fprintf(stderr, 
-//                    "%d.%03d LCM loss %4.1f%% : %5d err, "
-//                    "buf avail %4.1f%%\n", 
-//                   (int) tv.tv_sec, (int) tv.tv_usec/1000,
-//                   total_bad * 100.0 / (lcm->udp_rx + total_bad),
-//                   lcm->udp_discarded_bad,
-//                   100.0 * lcm->udp_low_watermark);
-//            
-//            lcm->udp_rx = 0;
-//            lcm->udp_discarded_bad = 0;
-//            lcm->udp_last_report_secs = tv.tv_sec;
-//            lcm->udp_low_watermark = HUGE;
-//        }
-//    }
-    
     int got_complete_message = 0;
 
     while (!got_complete_message) {
@@ -442,8 +1109,12 @@ udp_read_packet (lcm_udpm_t *lcm)
         FD_SET (lcm->thread_msg_pipe[0], &fds);
         SOCKET maxfd = MAX(lcm->recvfd, lcm->thread_msg_pipe[0]);
 
-        if (select (maxfd + 1, &fds, NULL, NULL, NULL) <= 0) { 
-            perror ("udp_read_packet -- select:");
+        struct timeval timeout;
+        int status = select (maxfd + 1, &fds, NULL, NULL,
+                _interest_tick (lcm, &timeout));
+        if (status <= 0) {
+            if (status < 0)
+                perror ("udp_read_packet -- select:");
             continue;
         }
 
@@ -467,10 +1138,38 @@ udp_read_packet (lcm_udpm_t *lcm)
         assert (FD_ISSET (lcm->recvfd, &fds));
 
         if (!lcmb) {
-            g_static_rec_mutex_lock (&lcm->mutex);
-            lcmb = lcm_buf_allocate_data(lcm->inbufs_empty, &lcm->ringbuf);
-            g_static_rec_mutex_unlock (&lcm->mutex);
+            _reclaim_bufs (lcm);
+            lcmb = lcm_buf_allocate_data(lcm->inbufs_empty, lcm->ringbuf);
+            if (!lcmb) {
+                // the ringbuffer is at its high watermark.  Drop the packet.
+                lcm_discard_datagram (lcm->recvfd);
+                continue;
+            }
         }
+
+#ifdef LCM_RECV_FRAGMENTS_IN_PLACE
+        // continue a large message without copying its payload, if possible
+        lcm_frag_buf_t *fbuf;
+        sz = lcm_frag_buf_store_recv (lcm->frag_bufs, lcm->recvfd, lcmb, &fbuf,
+                &lcm->udp_kernel_drops);
+        if (sz < 0) {
+            perror ("udp_read_packet -- recvmsg");
+            lcm->udp_discarded_bad++;
+            continue;
+        }
+        if (sz > 0) {
+            lcm->udp_rx++;
+            lcm->udp_rx_bytes += sz;
+            if (fbuf)
+                got_complete_message = _fragment_received (lcm, lcmb, fbuf);
+            else
+                lcm->udp_discarded_bad++;
+            if (!got_complete_message)
+                lcmb->recv_utime = 0;
+            continue;
+        }
+#endif
+
         struct iovec        vec;
         vec.iov_base = lcmb->buf;
         vec.iov_len = 65535;
@@ -498,6 +1197,11 @@ udp_read_packet (lcm_udpm_t *lcm)
             continue;
         }
 
+        lcm->udp_rx++;
+        lcm->udp_rx_bytes += sz;
+        lcmb->recv_utime = lcm_recv_control_parse (&msg,
+                &lcm->udp_kernel_drops);
+
         if (sz < sizeof(lcm2_header_short_t)) { 
             // packet too short to be LCM
             lcm->udp_discarded_bad++;
@@ -506,24 +1210,6 @@ udp_read_packet (lcm_udpm_t *lcm)
 
         lcmb->fromlen = msg.msg_namelen;
 
-        int got_utime = 0;
-#ifdef SO_TIMESTAMP
-        struct cmsghdr * cmsg = CMSG_FIRSTHDR (&msg);
-        /* Get the receive timestamp out of the packet headers if possible */
-        while (!lcmb->recv_utime && cmsg) {
-            if (cmsg->cmsg_level == SOL_SOCKET &&
-                    cmsg->cmsg_type == SCM_TIMESTAMP) {
-                struct timeval * t = (struct timeval*) CMSG_DATA (cmsg);
-                lcmb->recv_utime = (int64_t) t->tv_sec * 1000000 + t->tv_usec;
-                got_utime = 1;
-                break;
-            }
-            cmsg = CMSG_NXTHDR (&msg, cmsg);
-        }
-#endif
-        if (!got_utime)
-            lcmb->recv_utime = lcm_timestamp_now ();
-
         lcm2_header_short_t *hdr2 = (lcm2_header_short_t*) lcmb->buf;
         uint32_t rcvd_magic = ntohl(hdr2->magic);
         if (rcvd_magic == LCM2_MAGIC_SHORT)
@@ -541,15 +1227,128 @@ udp_read_packet (lcm_udpm_t *lcm)
     // allocated to it on the ringbuffer to exactly match the amount of space
     // required.  That way, we do not use 64k of the ringbuffer for every
     // incoming message.
-    if (lcmb->ringbuf) {
-        g_static_rec_mutex_lock (&lcm->mutex);
+    if (lcmb->ringbuf)
         lcm_ringbuf_shrink_last(lcmb->ringbuf, lcmb->buf, sz);
-        g_static_rec_mutex_unlock (&lcm->mutex);
-    }
 
     return lcmb;
 }
 
+#ifdef HAVE_RECVMMSG
+// Receive up to recv_batch datagrams with a single recvmmsg() call and queue
+// all complete messages for lcm_handle () while holding the lock only once.
+// Returns the number of messages queued, or -1 if the read thread should
+// exit.
+static int
+udp_read_packet_batch (lcm_udpm_t *lcm)
+{
+    udpm_recv_batch_t *batch = lcm->recv_batch;
+
+    // wait for either incoming UDP data, or for an abort message
+    fd_set fds;
+    FD_ZERO (&fds);
+    FD_SET (lcm->recvfd, &fds);
+    FD_SET (lcm->thread_msg_pipe[0], &fds);
+    SOCKET maxfd = MAX(lcm->recvfd, lcm->thread_msg_pipe[0]);
+
+    struct timeval timeout;
+    int status = select (maxfd + 1, &fds, NULL, NULL,
+            _interest_tick (lcm, &timeout));
+    if (status <= 0) {
+        if (status < 0)
+            perror ("udp_read_packet_batch -- select:");
+        return 0;
+    }
+
+    if (FD_ISSET (lcm->thread_msg_pipe[0], &fds)) {
+        // received an exit command.
+        dbg (DBG_LCM, "read thread received exit command\n");
+        return -1;
+    }
+
+    // there is incoming UDP data ready.
+    assert (FD_ISSET (lcm->recvfd, &fds));
+
+    for (int i = 0; i < batch->nslots; i++) {
+        struct msghdr *msg = &batch->msgs[i].msg_hdr;
+        msg->msg_namelen = sizeof (struct sockaddr);
+        msg->msg_controllen = LCM_RECV_CONTROL_SIZE;
+        msg->msg_flags = 0;
+    }
+
+    int npackets = recvmmsg (lcm->recvfd, batch->msgs, batch->nslots,
+            MSG_DONTWAIT, NULL);
+    if (npackets < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            perror ("udp_read_packet_batch -- recvmmsg");
+            lcm->udp_discarded_bad++;
+        }
+        return 0;
+    }
+
+    // return the space released by lcm_handle () to the ringbuffer before
+    // copying short messages onto it
+    _reclaim_bufs (lcm);
+
+    // parse each datagram.  Complete messages are staged, short ones after
+    // being copied onto the ringbuffer, and fragments are copied into their
+    // fragment buffers.
+    int nstaged = 0;
+    for (int i = 0; i < npackets; i++) {
+        struct msghdr *msg = &batch->msgs[i].msg_hdr;
+        int sz = batch->msgs[i].msg_len;
+        lcm->udp_rx++;
+        lcm->udp_rx_bytes += sz;
+
+        if (sz < sizeof(lcm2_header_short_t)) {
+            // packet too short to be LCM
+            lcm->udp_discarded_bad++;
+            continue;
+        }
+
+        lcm_buf_t *lcmb = &batch->staged[nstaged];
+        memset (lcmb, 0, sizeof (lcm_buf_t));
+        lcmb->buf = (char *) batch->iovecs[i].iov_base;
+        memcpy (&lcmb->from, &batch->from[i], sizeof (struct sockaddr));
+        lcmb->fromlen = msg->msg_namelen;
+        lcmb->recv_utime = lcm_recv_control_parse (msg,
+                &lcm->udp_kernel_drops);
+
+        lcm2_header_short_t *hdr2 = (lcm2_header_short_t*) lcmb->buf;
+        uint32_t rcvd_magic = ntohl(hdr2->magic);
+        int got_complete_message = 0;
+        if (rcvd_magic == LCM2_MAGIC_SHORT)
+            got_complete_message = _recv_short_message (lcm, lcmb, sz);
+        else if (rcvd_magic == LCM2_MAGIC_LONG)
+            got_complete_message = _recv_message_fragment (lcm, lcmb, sz);
+        else {
+            dbg (DBG_LCM, "LCM: bad magic\n");
+            lcm->udp_discarded_bad++;
+            continue;
+        }
+
+        if (got_complete_message)
+            nstaged++;
+    }
+
+    // queue the complete messages.  Their payloads are on the ringbuffer or
+    // were handed over by a fragment buffer, so only the metadata is copied.
+    for (int i = 0; i < nstaged; i++) {
+        lcm_buf_t *lcmb = lcm_buf_allocate (lcm->inbufs_empty);
+        memcpy (lcmb, &batch->staged[i], sizeof (lcm_buf_t));
+
+        /* Queue the packet for future retrieval by lcm_handle (). */
+        if (_queue_filled_buf (lcm, lcmb) < 0) {
+            // exiting.  Release the payloads of the remaining messages.
+            for (i++; i < nstaged; i++)
+                lcm_buf_free_data (&batch->staged[i]);
+            return -1;
+        }
+    }
+
+    return nstaged;
+}
+#endif
+
 /* This is the receiver thread that runs continuously to retrieve any incoming
  * LCM packets from the network and queues them locally. */
 static void *
@@ -564,25 +1363,22 @@ recv_thread (void * user)
 
     lcm_udpm_t * lcm = (lcm_udpm_t *) user;
 
+#ifdef HAVE_RECVMMSG
+    if (lcm->recv_batch) {
+        while (udp_read_packet_batch (lcm) >= 0) {}
+        dbg (DBG_LCM, "read thread exiting\n");
+        return NULL;
+    }
+#endif
+
     while (1) {
 
         lcm_buf_t *lcmb = udp_read_packet(lcm);
         if (!lcmb) break;
 
-        /* If necessary, notify the reading thread by writing to a pipe.  We
-         * only want one character in the pipe at a time to avoid blocking
-         * writes, so we only do this when the queue transitions from empty to
-         * non-empty. */
-        g_static_rec_mutex_lock (&lcm->mutex);
-
-        if (lcm_buf_queue_is_empty (lcm->inbufs_filled))
-            if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0)
-                perror ("write to notify");
-
         /* Queue the packet for future retrieval by lcm_handle (). */
-        lcm_buf_enqueue (lcm->inbufs_filled, lcmb);
-        
-        g_static_rec_mutex_unlock (&lcm->mutex);
+        if (_queue_filled_buf (lcm, lcmb) < 0)
+            break;
     }
     dbg (DBG_LCM, "read thread exiting\n");
     return NULL;
@@ -597,11 +1393,172 @@ lcm_udpm_get_fileno (lcm_udpm_t *lcm)
     return lcm->notify_pipe[0];
 }
 
+static void
+lcm_udpm_get_stats (lcm_udpm_t *lcm, lcm_stats_t *stats)
+{
+    // the counters are updated by the read thread without synchronization,
+    // so they are only approximately consistent with each other.
+    g_static_rec_mutex_lock (&lcm->mutex);
+    stats->packets_received = lcm->udp_rx;
+    stats->bytes_received = lcm->udp_rx_bytes;
+    stats->packets_bad = lcm->udp_discarded_bad;
+    stats->kernel_drops = lcm->udp_kernel_drops;
+    if (lcm->frag_bufs)
+        stats->fragment_timeouts = lcm->frag_bufs->num_evicted;
+    if (lcm->ringbuf) {
+        lcm_ringbuf_stats_t ring_stats;
+        lcm_ringbuf_get_stats (lcm->ringbuf, &ring_stats);
+        stats->ringbuf_drops = ring_stats.num_overflows;
+        stats->ringbuf_peak_used = ring_stats.peak_used;
+        stats->ringbuf_capacity = ring_stats.capacity;
+        stats->ringbuf_slabs = ring_stats.num_slabs;
+        stats->ringbuf_peak_slabs = ring_stats.peak_slabs;
+    }
+    g_static_rec_mutex_unlock (&lcm->mutex);
+}
+
 static int
 lcm_udpm_subscribe (lcm_udpm_t *lcm, const char *channel)
 {
-    return _setup_recv_parts (lcm);
+    int status = _setup_recv_parts (lcm);
+    // let publishers know about the new subscription right away
+    if (!status && lcm->params.interest &&
+            !_interest_internal_channel (channel))
+        _interest_advertise (lcm, channel);
+    return status;
+}
+
+static int
+lcm_udpm_unsubscribe (lcm_udpm_t *lcm, const char *channel)
+{
+    if (lcm->thread_created && lcm->params.interest &&
+            !_interest_internal_channel (channel))
+        _interest_advertise (lcm, NULL);
+    return 0;
+}
+
+#ifdef HAVE_SENDMMSG
+// make room for at least n datagrams in the send batch.  Caller must hold
+// the transmit lock.
+static void
+_send_batch_reserve (lcm_udpm_t *lcm, int n)
+{
+    udpm_send_batch_t *batch = &lcm->send_batch;
+    if (n <= batch->capacity)
+        return;
+    int capacity = MAX (n, batch->capacity * 2);
+    batch->msgs = (struct mmsghdr *) realloc (batch->msgs,
+            capacity * sizeof (struct mmsghdr));
+    batch->iovecs = (struct iovec *) realloc (batch->iovecs,
+            capacity * 3 * sizeof (struct iovec));
+    batch->hdrs = (lcm2_header_long_t *) realloc (batch->hdrs,
+            capacity * sizeof (lcm2_header_long_t));
+    batch->capacity = capacity;
+}
+
+static void
+_send_batch_set_msg (lcm_udpm_t *lcm, int index, int iovlen)
+{
+    struct msghdr *msg = &lcm->send_batch.msgs[index].msg_hdr;
+    msg->msg_name = (struct sockaddr*) &lcm->dest_addr;
+    msg->msg_namelen = sizeof(lcm->dest_addr);
+    msg->msg_iov = &lcm->send_batch.iovecs[index * 3];
+    msg->msg_iovlen = iovlen;
+    msg->msg_control = NULL;
+    msg->msg_controllen = 0;
+    msg->msg_flags = 0;
+}
+
+// stage a short message as datagram number index of the send batch.
+// Returns the number of datagrams used (always 1).
+static int
+_send_batch_stage_short (lcm_udpm_t *lcm, int index, const char *channel,
+        int channel_size, const void *data, unsigned int datalen)
+{
+    lcm2_header_short_t *hdr =
+        (lcm2_header_short_t *) &lcm->send_batch.hdrs[index];
+    hdr->magic = htonl (LCM2_MAGIC_SHORT);
+    hdr->msg_seqno = htonl (lcm->msg_seqno);
+
+    struct iovec *sendbufs = &lcm->send_batch.iovecs[index * 3];
+    sendbufs[0].iov_base = (char *) hdr;
+    sendbufs[0].iov_len = sizeof (lcm2_header_short_t);
+    sendbufs[1].iov_base = (char *) channel;
+    sendbufs[1].iov_len = channel_size + 1;
+    sendbufs[2].iov_base = (char *) data;
+    sendbufs[2].iov_len = datalen;
+    _send_batch_set_msg (lcm, index, 3);
+
+    lcm->msg_seqno ++;
+    return 1;
+}
+
+// stage all fragments of a large message, starting at datagram number index
+// of the send batch.  Returns the number of datagrams used.
+static int
+_send_batch_stage_fragments (lcm_udpm_t *lcm, int index, const char *channel,
+        int channel_size, const void *data, unsigned int datalen,
+        int nfragments)
+{
+    int fragment_size = LCM_FRAGMENT_MAX_PAYLOAD;
+    uint32_t fragment_offset = 0;
+
+    for (int frag_no = 0; frag_no < nfragments; frag_no++) {
+        lcm2_header_long_t *hdr = &lcm->send_batch.hdrs[index + frag_no];
+        hdr->magic = htonl (LCM2_MAGIC_LONG);
+        hdr->msg_seqno = htonl (lcm->msg_seqno);
+        hdr->msg_size = htonl (datalen);
+        hdr->fragment_offset = htonl (fragment_offset);
+        hdr->fragment_no = htons (frag_no);
+        hdr->fragments_in_msg = htons (nfragments);
+
+        struct iovec *sendbufs = &lcm->send_batch.iovecs[(index + frag_no) * 3];
+        sendbufs[0].iov_base = (char *) hdr;
+        sendbufs[0].iov_len = sizeof (lcm2_header_long_t);
+        if (frag_no == 0) {
+            // first fragment is special.  insert channel before data
+            int firstfrag_datasize = fragment_size - (channel_size + 1);
+            assert (firstfrag_datasize <= datalen);
+            sendbufs[1].iov_base = (char *) channel;
+            sendbufs[1].iov_len = channel_size + 1;
+            sendbufs[2].iov_base = (char *) data;
+            sendbufs[2].iov_len = firstfrag_datasize;
+            _send_batch_set_msg (lcm, index + frag_no, 3);
+            fragment_offset += firstfrag_datasize;
+        } else {
+            int fraglen = MIN (fragment_size, datalen - fragment_offset);
+            sendbufs[1].iov_base = (char *) data + fragment_offset;
+            sendbufs[1].iov_len = fraglen;
+            _send_batch_set_msg (lcm, index + frag_no, 2);
+            fragment_offset += fraglen;
+        }
+    }
+    assert (fragment_offset == datalen);
+
+    lcm->msg_seqno ++;
+    return nfragments;
+}
+
+// transmit the first n datagrams of the send batch.  Caller must hold the
+// transmit lock.  Returns 0 on success, -1 on failure.
+static int
+_send_batch_flush (lcm_udpm_t *lcm, int n)
+{
+    int sent = 0;
+    while (sent < n) {
+        int status = sendmmsg (lcm->sendfd, lcm->send_batch.msgs + sent,
+                MIN (n - sent, LCM_MAX_SEND_BATCH), 0);
+        if (status < 0) {
+            if (errno == EINTR)
+                continue;
+            perror ("lcm_udpm_publish -- sendmmsg");
+            return -1;
+        }
+        sent += status;
+    }
+    return 0;
 }
+#endif
 
 static int 
 lcm_udpm_publish (lcm_udpm_t *lcm, const char *channel, const void *data,
@@ -614,6 +1571,11 @@ lcm_udpm_publish (lcm_udpm_t *lcm, const char *channel, const void *data,
         return -1;
     }
 
+    if (!_interest_wanted (lcm, channel)) {
+        dbg (DBG_LCM_MSG, "not transmitting [%s]: no subscribers\n", channel);
+        return 0;
+    }
+
     int payload_size = channel_size + 1 + datalen;
     if (payload_size <= LCM_SHORT_MESSAGE_MAX_SIZE) {
         // message is short.  send in a single packet
@@ -672,6 +1634,19 @@ lcm_udpm_publish (lcm_udpm_t *lcm, const char *channel, const void *data,
         dbg (DBG_LCM_MSG, "transmitting %d byte [%s] payload in %d fragments\n",
                 payload_size, channel, nfragments);
 
+#ifdef HAVE_SENDMMSG
+        if (lcm->params.send_batch) {
+            // build all of the fragments up front and submit them with as
+            // few system calls as possible.
+            _send_batch_reserve (lcm, nfragments);
+            _send_batch_stage_fragments (lcm, 0, channel, channel_size, data,
+                    datalen, nfragments);
+            int status = _send_batch_flush (lcm, nfragments);
+            g_static_mutex_unlock (&lcm->transmit_lock);
+            return status;
+        }
+#endif
+
         uint32_t fragment_offset = 0;
 
         lcm2_header_long_t hdr;
@@ -744,65 +1719,201 @@ lcm_udpm_publish (lcm_udpm_t *lcm, const char *channel, const void *data,
     return 0;
 }
 
-static int 
-lcm_udpm_handle (lcm_udpm_t *lcm)
+#ifdef HAVE_SENDMMSG
+static int
+_publish_batch (lcm_udpm_t *lcm, const lcm_publish_entry_t *msgs, int nmsgs)
 {
-    int status;
-    char ch;
-    if(0 != _setup_recv_parts (lcm))
-        return -1;
-
-    /* Read one byte from the notify pipe.  This will block if no packets are
-     * available yet and wake up when they are. */
-    status = lcm_internal_pipe_read(lcm->notify_pipe[0], &ch, 1);
-    if (status == 0) {
-        fprintf (stderr, "Error: lcm_handle read 0 bytes from notify_pipe\n");
-        return -1;
+    // validate everything before transmitting anything, and count the
+    // number of datagrams required.
+    int ndatagrams = 0;
+    for (int i = 0; i < nmsgs; i++) {
+        int channel_size = strlen (msgs[i].channel);
+        if (channel_size > LCM_MAX_CHANNEL_NAME_LENGTH) {
+            fprintf (stderr, "LCM Error: channel name too long [%s]\n",
+                    msgs[i].channel);
+            return -1;
+        }
+        int payload_size = channel_size + 1 + msgs[i].datalen;
+        if (payload_size <= LCM_SHORT_MESSAGE_MAX_SIZE) {
+            ndatagrams++;
+        } else {
+            int nfragments = payload_size / LCM_FRAGMENT_MAX_PAYLOAD +
+                !!(payload_size % LCM_FRAGMENT_MAX_PAYLOAD);
+            if (nfragments > 65535) {
+                fprintf (stderr,
+                        "LCM error: too much data for a single message\n");
+                return -1;
+            }
+            ndatagrams += nfragments;
+        }
     }
-    else if (status < 0) {
-        fprintf (stderr, "Error: lcm_handle read: %s\n", strerror (errno));
-        return -1;
+
+    g_static_mutex_lock (&lcm->transmit_lock);
+    _send_batch_reserve (lcm, ndatagrams);
+
+    int index = 0;
+    for (int i = 0; i < nmsgs; i++) {
+        int channel_size = strlen (msgs[i].channel);
+        int payload_size = channel_size + 1 + msgs[i].datalen;
+        if (payload_size <= LCM_SHORT_MESSAGE_MAX_SIZE) {
+            index += _send_batch_stage_short (lcm, index, msgs[i].channel,
+                    channel_size, msgs[i].data, msgs[i].datalen);
+        } else {
+            int nfragments = payload_size / LCM_FRAGMENT_MAX_PAYLOAD +
+                !!(payload_size % LCM_FRAGMENT_MAX_PAYLOAD);
+            index += _send_batch_stage_fragments (lcm, index, msgs[i].channel,
+                    channel_size, msgs[i].data, msgs[i].datalen, nfragments);
+        }
     }
+    assert (index == ndatagrams);
 
-    /* Dequeue the next received packet */
-    g_static_rec_mutex_lock (&lcm->mutex);
-    lcm_buf_t * lcmb = lcm_buf_dequeue (lcm->inbufs_filled);
+    dbg (DBG_LCM_MSG, "transmitting %d messages in %d packets\n",
+            nmsgs, ndatagrams);
+    int status = _send_batch_flush (lcm, ndatagrams);
+    g_static_mutex_unlock (&lcm->transmit_lock);
+    return status;
+}
 
-    if (!lcmb) {
-        fprintf (stderr, 
-                "Error: no packet available despite getting notification.\n");
-        g_static_rec_mutex_unlock (&lcm->mutex);
-        return -1;
+static int
+lcm_udpm_publish_batch (lcm_udpm_t *lcm, const lcm_publish_entry_t *msgs,
+        int nmsgs)
+{
+    if (!lcm->params.send_batch) {
+        for (int i = 0; i < nmsgs; i++) {
+            if (lcm_udpm_publish (lcm, msgs[i].channel, msgs[i].data,
+                        msgs[i].datalen) != 0)
+                return -1;
+        }
+        return 0;
     }
 
-    /* If there are still packets in the queue, put something back in the pipe
-     * so that future invocations will get called. */
-    if (!lcm_buf_queue_is_empty (lcm->inbufs_filled))
-        if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0)
-            perror ("write to notify");
-    g_static_rec_mutex_unlock (&lcm->mutex);
+    if (!lcm->params.interest)
+        return _publish_batch (lcm, msgs, nmsgs);
+
+    // leave out the channels that nobody subscribes to
+    lcm_publish_entry_t *wanted = (lcm_publish_entry_t *) malloc (nmsgs *
+            sizeof (lcm_publish_entry_t));
+    int nwanted = 0;
+    for (int i = 0; i < nmsgs; i++)
+        if (_interest_wanted (lcm, msgs[i].channel))
+            wanted[nwanted++] = msgs[i];
+    int status = nwanted ? _publish_batch (lcm, wanted, nwanted) : 0;
+    free (wanted);
+    return status;
+}
+#endif
 
+static int
+lcm_udpm_has_subscribers (lcm_udpm_t *lcm, const char *channel)
+{
+    return _interest_wanted (lcm, channel);
+}
+
+static void
+_dispatch_buf (lcm_udpm_t *lcm, lcm_buf_t *lcmb)
+{
     lcm_recv_buf_t rbuf;
     rbuf.data = (uint8_t*) lcmb->buf + lcmb->data_offset;
     rbuf.data_size = lcmb->data_size;
     rbuf.recv_utime = lcmb->recv_utime;
     rbuf.lcm = lcm->lcm;
 
+    // reassembled messages are stored in a malloc()ed buffer, which handlers
+    // can take over with lcm_recv_buf_ref().  Ringbuffer space can't be
+    // handed out.
+    void **storage = lcmb->ringbuf ? NULL : (void **) &lcmb->buf;
+
     if(lcm->creating_read_thread) {
         // special case:  If we're creating the read thread and are in
         // self-test mode, then only dispatch the self-test message.
         if(!strcmp(lcmb->channel_name, SELF_TEST_CHANNEL))
-            lcm_dispatch_handlers (lcm->lcm, &rbuf, lcmb->channel_name);
+            lcm_dispatch_handlers_owned (lcm->lcm, &rbuf, lcmb->channel_name,
+                    storage);
     } else {
-        lcm_dispatch_handlers (lcm->lcm, &rbuf, lcmb->channel_name);
+        lcm_dispatch_handlers_owned (lcm->lcm, &rbuf, lcmb->channel_name,
+                storage);
     }
 
-    g_static_rec_mutex_lock (&lcm->mutex);
-    lcm_buf_free_data(lcmb, lcm->ringbuf);
-    lcm_buf_enqueue (lcm->inbufs_empty, lcmb);
-    g_static_rec_mutex_unlock (&lcm->mutex);
+    /* Hand the buffer back to the read thread, which owns the ringbuffer.
+     * This cannot fail, since inbufs_recycled is large enough to hold every
+     * buffer that can be outstanding. */
+    int recycled = lcm_buf_ring_push (lcm->inbufs_recycled, lcmb);
+    assert (recycled);
+    (void) recycled;
+}
 
-    return 0;
+// Takes the packet to dispatch next out of a window at the head of
+// inbufs_filled, favoring channels with higher priority subscriptions.
+static lcm_buf_t *
+_pop_by_priority (lcm_udpm_t *lcm)
+{
+    while (lcm->num_pending < LCM_PRIORITY_WINDOW) {
+        lcm_buf_t * lcmb = lcm_buf_ring_pop (lcm->inbufs_filled);
+        if (!lcmb)
+            break;
+        lcm->pending[lcm->num_pending++] = lcmb;
+    }
+    if (!lcm->num_pending)
+        return NULL;
+
+    const char *channels[LCM_PRIORITY_WINDOW];
+    for (int i = 0; i < lcm->num_pending; i++)
+        channels[i] = lcm->pending[i]->channel_name;
+    int index = lcm_select_by_priority (lcm->lcm, channels, lcm->num_pending);
+
+    lcm_buf_t * lcmb = lcm->pending[index];
+    lcm->num_pending--;
+    memmove (&lcm->pending[index], &lcm->pending[index + 1],
+            (lcm->num_pending - index) * sizeof (lcm_buf_t *));
+    return lcmb;
+}
+
+static int 
+lcm_udpm_handle_batch (lcm_udpm_t *lcm, int max_msgs)
+{
+    if(0 != _setup_recv_parts (lcm))
+        return -1;
+
+    /* Wait for a notification.  This will block if no packets are available
+     * yet and wake up when they are. */
+    if (_notify_wait (lcm) < 0)
+        return -1;
+
+    /* Dispatch up to max_msgs of the received packets */
+    int nhandled = 0;
+    while (nhandled < max_msgs) {
+        lcm_buf_t * lcmb;
+        if (lcm->num_pending || lcm_has_priorities (lcm->lcm))
+            lcmb = _pop_by_priority (lcm);
+        else
+            lcmb = lcm_buf_ring_pop (lcm->inbufs_filled);
+        if (!lcmb)
+            break;
+        _space_signal (lcm);
+        _dispatch_buf (lcm, lcmb);
+        nhandled++;
+    }
+
+    if (!nhandled) {
+        fprintf (stderr, 
+                "Error: no packet available despite getting notification.\n");
+        return -1;
+    }
+
+    /* If there are still packets in the queue, re-arm the notification so
+     * that future invocations will get called.  Packets whose notification
+     * is still pending in the read thread may have been dispatched above, so
+     * the counter can briefly go negative. */
+    if (g_atomic_int_exchange_and_add (&lcm->num_filled, -nhandled) > nhandled)
+        _notify_signal (lcm);
+
+    return nhandled;
+}
+
+static int 
+lcm_udpm_handle (lcm_udpm_t *lcm)
+{
+    return lcm_udpm_handle_batch (lcm, 1) < 0 ? -1 : 0;
 }
 
 static void
@@ -918,7 +2029,8 @@ _setup_recv_parts (lcm_udpm_t *lcm)
 
     // allocate the fragment buffer hashtable
     lcm->frag_bufs = lcm_frag_buf_store_new(MAX_FRAG_BUF_TOTAL_SIZE,
-            MAX_NUM_FRAG_BUFS);
+            MAX_NUM_FRAG_BUFS, MAX_NUM_FRAG_BUFS_PER_SENDER);
+    lcm->buf_pool = lcm_buf_pool_new();
 
     // allocate multicast socket
     lcm->recvfd = socket (AF_INET, SOCK_DGRAM, 0);
@@ -1007,6 +2119,12 @@ _setup_recv_parts (lcm_udpm_t *lcm)
     setsockopt (lcm->recvfd, SOL_SOCKET, SO_TIMESTAMP, &opt, sizeof (opt));
 #endif
 
+    /* Have the kernel report how many packets it drops on the socket */
+#ifdef SO_RXQ_OVFL
+    opt = 1;
+    setsockopt (lcm->recvfd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof (opt));
+#endif
+
     if (bind (lcm->recvfd, (struct sockaddr*)&addr, sizeof (addr)) < 0) {
         perror ("bind");
         goto setup_recv_thread_fail;
@@ -1024,8 +2142,10 @@ _setup_recv_parts (lcm_udpm_t *lcm)
     }
 
     lcm->inbufs_empty = lcm_buf_queue_new ();
-    lcm->inbufs_filled = lcm_buf_queue_new ();
-    lcm->ringbuf = lcm_ringbuf_new (LCM_RINGBUF_SIZE);
+    lcm->inbufs_filled = lcm_buf_ring_new (LCM_BUF_RING_SIZE);
+    lcm->inbufs_recycled = lcm_buf_ring_new (2 * LCM_BUF_RING_SIZE);
+    lcm->num_filled = 0;
+    lcm->ringbuf = lcm_ringbuf_params_create (&lcm->params.ringbuf);
 
     int i;
     for (i = 0; i < LCM_DEFAULT_RECV_BUFS; i++) {
@@ -1035,6 +2155,11 @@ _setup_recv_parts (lcm_udpm_t *lcm)
         lcm_buf_enqueue (lcm->inbufs_empty, lcmb);
     }
 
+#ifdef HAVE_RECVMMSG
+    if (lcm->params.recv_batch > 1)
+        lcm->recv_batch = _recv_batch_new (lcm->params.recv_batch);
+#endif
+
     // setup a pipe for notifying the reader thread when to quit
     if(0 != lcm_internal_pipe_create(lcm->thread_msg_pipe)) {
         perror(__FILE__ " pipe(setup)");
@@ -1042,6 +2167,22 @@ _setup_recv_parts (lcm_udpm_t *lcm)
     }
     fcntl (lcm->thread_msg_pipe[1], F_SETFL, O_NONBLOCK);
 
+    // and one for waking it up once the application makes room for more
+    // packets
+#ifdef HAVE_SYS_EVENTFD_H
+    lcm->space_pipe[0] = lcm->space_pipe[1] = eventfd (0, 0);
+    if (lcm->space_pipe[0] < 0) {
+        perror(__FILE__ " eventfd(setup)");
+        goto setup_recv_thread_fail;
+    }
+#else
+    if(0 != lcm_internal_pipe_create(lcm->space_pipe)) {
+        perror(__FILE__ " pipe(setup)");
+        goto setup_recv_thread_fail;
+    }
+    fcntl (lcm->space_pipe[1], F_SETFL, O_NONBLOCK);
+#endif
+
     /* Start the reader thread */
     lcm->read_thread = g_thread_create (recv_thread, lcm, TRUE, NULL);
     if (!lcm->read_thread) {
@@ -1058,6 +2199,14 @@ _setup_recv_parts (lcm_udpm_t *lcm)
 
     if (0 == self_test_results) {
         dbg (DBG_LCM, "LCM: self test successful\n");
+        if (lcm->params.interest) {
+            // ask everyone to advertise their subscriptions now, instead of
+            // waiting for their next periodic advertisement
+            g_static_mutex_lock (&lcm->interest_lock);
+            lcm->interest_listen_utime = lcm_timestamp_now ();
+            g_static_mutex_unlock (&lcm->interest_lock);
+            lcm_udpm_publish (lcm, INTEREST_REQUEST_CHANNEL, "", 0);
+        }
     } else {
         // self test failed.  destroy the read thread
         fprintf (stderr, "LCM self test failed!!\n"
@@ -1085,6 +2234,8 @@ lcm_udpm_create (lcm_t * parent, const char *network, const GHashTable *args)
 {
     udpm_params_t params;
     memset (&params, 0, sizeof (udpm_params_t));
+    params.send_batch = 1;
+    lcm_ringbuf_params_init (&params.ringbuf);
 
     g_hash_table_foreach ((GHashTable*) args, new_argument, &params);
 
@@ -1099,12 +2250,13 @@ lcm_udpm_create (lcm_t * parent, const char *network, const GHashTable *args)
     lcm->recvfd = -1;
     lcm->sendfd = -1;
     lcm->thread_msg_pipe[0] = lcm->thread_msg_pipe[1] = -1;
-    lcm->udp_low_watermark = 1.0;
+    lcm->space_pipe[0] = lcm->space_pipe[1] = -1;
 
     lcm->kernel_rbuf_sz = 0;
     lcm->warned_about_small_kernel_buf = 0;
 
     lcm->frag_bufs = NULL;
+    lcm->buf_pool = NULL;
 
     // synchronization variables used when allocating receive resources
     lcm->creating_read_thread = 0;
@@ -1112,16 +2264,35 @@ lcm_udpm_create (lcm_t * parent, const char *network, const GHashTable *args)
     lcm->create_read_thread_cond = NULL;
 
     // internal notification pipe
+#ifdef HAVE_SYS_EVENTFD_H
+    lcm->notify_pipe[0] = lcm->notify_pipe[1] = eventfd (0, 0);
+    if (lcm->notify_pipe[0] < 0) {
+        perror(__FILE__ " eventfd(create)");
+        lcm_udpm_destroy (lcm);
+        return NULL;
+    }
+#else
     if(0 != lcm_internal_pipe_create(lcm->notify_pipe)) {
         perror(__FILE__ " pipe(create)");
         lcm_udpm_destroy (lcm);
         return NULL;
     }
     fcntl (lcm->notify_pipe[1], F_SETFL, O_NONBLOCK);
+#endif
 
     g_static_rec_mutex_init (&lcm->mutex);
     g_static_mutex_init (&lcm->transmit_lock);
 
+    g_static_mutex_init (&lcm->interest_lock);
+    if (params.interest) {
+        lcm->interest_sender_id =
+            ((int64_t) g_random_int () << 32) | g_random_int ();
+        lcm->interest_peers = g_hash_table_new_full (g_str_hash, g_str_equal,
+                g_free, _interest_peer_free);
+        lcm->interest_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+                g_free, NULL);
+    }
+
     dbg (DBG_LCM, "Initializing LCM UDPM context...\n");
     dbg (DBG_LCM, "Multicast %s:%d\n", inet_ntoa(params.mc_addr), ntohs (params.mc_port));
 
@@ -1211,6 +2382,11 @@ lcm_udpm_create (lcm_t * parent, const char *network, const GHashTable *args)
 #endif
     }
 
+    // publishers need the read thread to hear which channels are wanted.  If
+    // it can't be started, every channel is transmitted.
+    if (params.interest)
+        _setup_recv_parts (lcm);
+
     return lcm;
 }
 
@@ -1225,10 +2401,18 @@ lcm_udpm_provider_init (GPtrArray * providers)
     udpm_vtable.create      = lcm_udpm_create;
     udpm_vtable.destroy     = lcm_udpm_destroy;
     udpm_vtable.subscribe   = lcm_udpm_subscribe;
-    udpm_vtable.unsubscribe = NULL;
+    udpm_vtable.unsubscribe = lcm_udpm_unsubscribe;
     udpm_vtable.publish     = lcm_udpm_publish;
+#ifdef HAVE_SENDMMSG
+    udpm_vtable.publish_batch = lcm_udpm_publish_batch;
+#else
+    udpm_vtable.publish_batch = NULL;
+#endif
     udpm_vtable.handle      = lcm_udpm_handle;
+    udpm_vtable.handle_batch = lcm_udpm_handle_batch;
     udpm_vtable.get_fileno  = lcm_udpm_get_fileno;
+    udpm_vtable.get_stats   = lcm_udpm_get_stats;
+    udpm_vtable.has_subscribers = lcm_udpm_has_subscribers;
 
     udpm_info.name = "udpm";
     udpm_info.vtable = &udpm_vtable;
@@ -0,0 +1,194 @@
+// THIS IS AN AUTOMATICALLY GENERATED FILE.  DO NOT MODIFY
+// BY HAND!!
+//
+// Generated by lcm-gen
+
+#include <string.h>
+#include "channel_interest_t.h"
+
+static int __channel_interest_t_hash_computed;
+static int64_t __channel_interest_t_hash;
+
+int64_t __channel_interest_t_hash_recursive(const __lcm_hash_ptr *p)
+{
+    const __lcm_hash_ptr *fp;
+    for (fp = p; fp != NULL; fp = fp->parent)
+        if (fp->v == __channel_interest_t_get_hash)
+            return 0;
+
+    __lcm_hash_ptr cp;
+    cp.parent =  p;
+    cp.v = (void*)__channel_interest_t_get_hash;
+    (void) cp;
+
+    int64_t hash = (int64_t)0x5908bdef162c4302LL
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int32_t_hash_recursive(&cp)
+         + __string_hash_recursive(&cp)
+        ;
+
+    return (hash<<1) + ((hash>>63)&1);
+}
+
+int64_t __channel_interest_t_get_hash(void)
+{
+    if (!__channel_interest_t_hash_computed) {
+        __channel_interest_t_hash = __channel_interest_t_hash_recursive(NULL);
+        __channel_interest_t_hash_computed = 1;
+    }
+
+    return __channel_interest_t_hash;
+}
+
+int __channel_interest_t_encode_array(void *buf, int offset, int maxlen, const channel_interest_t *p, int elements)
+{
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].sender_id), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].lifetime_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_channels), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __string_encode_array(buf, offset + pos, maxlen - pos, p[element].channels, p[element].num_channels);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+int channel_interest_t_encode(void *buf, int offset, int maxlen, const channel_interest_t *p)
+{
+    int pos = 0, thislen;
+    int64_t hash = __channel_interest_t_get_hash();
+
+    thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    thislen = __channel_interest_t_encode_array(buf, offset + pos, maxlen - pos, p, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+int __channel_interest_t_encoded_array_size(const channel_interest_t *p, int elements)
+{
+    int size = 0, element;
+    for (element = 0; element < elements; element++) {
+
+        size += __int64_t_encoded_array_size(&(p[element].sender_id), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].lifetime_usec), 1);
+
+        size += __int32_t_encoded_array_size(&(p[element].num_channels), 1);
+
+        size += __string_encoded_array_size(p[element].channels, p[element].num_channels);
+
+    }
+    return size;
+}
+
+int channel_interest_t_encoded_size(const channel_interest_t *p)
+{
+    return 8 + __channel_interest_t_encoded_array_size(p, 1);
+}
+
+int __channel_interest_t_decode_array(const void *buf, int offset, int maxlen, channel_interest_t *p, int elements)
+{
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].sender_id), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].lifetime_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_channels), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        p[element].channels = (char**) lcm_malloc(sizeof(char*) * p[element].num_channels);
+        thislen = __string_decode_array(buf, offset + pos, maxlen - pos, p[element].channels, p[element].num_channels);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+int __channel_interest_t_decode_array_cleanup(channel_interest_t *p, int elements)
+{
+    int element;
+    for (element = 0; element < elements; element++) {
+
+        __int64_t_decode_array_cleanup(&(p[element].sender_id), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].lifetime_usec), 1);
+
+        __int32_t_decode_array_cleanup(&(p[element].num_channels), 1);
+
+        __string_decode_array_cleanup(p[element].channels, p[element].num_channels);
+        if (p[element].channels) free(p[element].channels);
+
+    }
+    return 0;
+}
+
+int channel_interest_t_decode(const void *buf, int offset, int maxlen, channel_interest_t *p)
+{
+    int pos = 0, thislen;
+    int64_t hash = __channel_interest_t_get_hash();
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    thislen = __channel_interest_t_decode_array(buf, offset + pos, maxlen - pos, p, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+int channel_interest_t_decode_cleanup(channel_interest_t *p)
+{
+    return __channel_interest_t_decode_array_cleanup(p, 1);
+}
+
+int __channel_interest_t_clone_array(const channel_interest_t *p, channel_interest_t *q, int elements)
+{
+    int element;
+    for (element = 0; element < elements; element++) {
+
+        __int64_t_clone_array(&(p[element].sender_id), &(q[element].sender_id), 1);
+
+        __int64_t_clone_array(&(p[element].lifetime_usec), &(q[element].lifetime_usec), 1);
+
+        __int32_t_clone_array(&(p[element].num_channels), &(q[element].num_channels), 1);
+
+        q[element].channels = (char**) lcm_malloc(sizeof(char*) * q[element].num_channels);
+        __string_clone_array(p[element].channels, q[element].channels, p[element].num_channels);
+
+    }
+    return 0;
+}
+
+channel_interest_t *channel_interest_t_copy(const channel_interest_t *p)
+{
+    channel_interest_t *q = (channel_interest_t*) malloc(sizeof(channel_interest_t));
+    __channel_interest_t_clone_array(p, q, 1);
+    return q;
+}
+
+void channel_interest_t_destroy(channel_interest_t *p)
+{
+    __channel_interest_t_decode_array_cleanup(p, 1);
+    free(p);
+}
+
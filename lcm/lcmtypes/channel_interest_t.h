@@ -0,0 +1,91 @@
+/**
+ * Generated by running lcm-gen -c --c-no-pubsub channel_interest.lcm
+ *
+ * and then modified by hand to replace
+ * #include <lcm/lcm_coretypes.h>
+ * with
+ * #include "../lcm_coretypes.h"
+ **/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "../lcm_coretypes.h"
+
+#ifndef _channel_interest_t_h
+#define _channel_interest_t_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _channel_interest_t channel_interest_t;
+struct _channel_interest_t
+{
+    int64_t    sender_id;
+    int64_t    lifetime_usec;
+    int32_t    num_channels;
+    char*      *channels;
+};
+
+/**
+ * Create a deep copy of a channel_interest_t.
+ * When no longer needed, destroy it with channel_interest_t_destroy()
+ */
+channel_interest_t* channel_interest_t_copy(const channel_interest_t* to_copy);
+
+/**
+ * Destroy an instance of channel_interest_t created by channel_interest_t_copy()
+ */
+void channel_interest_t_destroy(channel_interest_t* to_destroy);
+
+/**
+ * Encode a message of type channel_interest_t into binary form.
+ *
+ * @param buf The output buffer.
+ * @param offset Encoding starts at this byte offset into @p buf.
+ * @param maxlen Maximum number of bytes to write.  This should generally
+ *               be equal to channel_interest_t_encoded_size().
+ * @param msg The message to encode.
+ * @return The number of bytes encoded, or <0 if an error occured.
+ */
+int channel_interest_t_encode(void *buf, int offset, int maxlen, const channel_interest_t *p);
+
+/**
+ * Decode a message of type channel_interest_t from binary form.
+ * When decoding messages containing strings or variable-length arrays, this
+ * function may allocate memory.  When finished with the decoded message,
+ * release allocated resources with channel_interest_t_decode_cleanup().
+ *
+ * @param buf The buffer containing the encoded message
+ * @param offset The byte offset into @p buf where the encoded message starts.
+ * @param maxlen The maximum number of bytes to read while decoding.
+ * @param msg Output parameter where the decoded message is stored
+ * @return The number of bytes decoded, or <0 if an error occured.
+ */
+int channel_interest_t_decode(const void *buf, int offset, int maxlen, channel_interest_t *msg);
+
+/**
+ * Release resources allocated by channel_interest_t_decode()
+ * @return 0
+ */
+int channel_interest_t_decode_cleanup(channel_interest_t *p);
+
+/**
+ * Check how many bytes are required to encode a message of type channel_interest_t
+ */
+int channel_interest_t_encoded_size(const channel_interest_t *p);
+
+// LCM support functions. Users should not call these
+int64_t __channel_interest_t_get_hash(void);
+int64_t __channel_interest_t_hash_recursive(const __lcm_hash_ptr *p);
+int     __channel_interest_t_encode_array(void *buf, int offset, int maxlen, const channel_interest_t *p, int elements);
+int     __channel_interest_t_decode_array(const void *buf, int offset, int maxlen, channel_interest_t *p, int elements);
+int     __channel_interest_t_decode_array_cleanup(channel_interest_t *p, int elements);
+int     __channel_interest_t_encoded_array_size(const channel_interest_t *p, int elements);
+int     __channel_interest_t_clone_array(const channel_interest_t *p, channel_interest_t *q, int elements);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,32 +5,57 @@
 #include <assert.h>
 #include <stdint.h>
 
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
 #include "ringbuffer.h"
 
 // must be power of 2
 #define ALIGNMENT 32
 
+// slabs backed by huge pages are rounded up to a multiple of this size
+#define HUGEPAGE_SIZE (2*1024*1024)
+
 #define MAGIC 0x067f8687
 typedef struct _lcm_ringbuf_rec lcm_ringbuf_rec_t;
+typedef struct _lcm_ringbuf_slab lcm_ringbuf_slab_t;
 
 #define EXTRA_RETENTIVE 0
 
+struct _lcm_ringbuf_slab
+{
+    lcm_ringbuf_slab_t *prev;   // links in either the active or the idle list
+    lcm_ringbuf_slab_t *next;
+    char          *data;
+    unsigned int  size;         // allocated size of data
+    unsigned int  pos;          // offset of the next chunk
+    unsigned int  used;         // total bytes currently allocated
+    unsigned int  nrecs;        // number of chunks currently allocated
+    int           mapped;       // data was obtained with mmap()
+};
+
 struct _lcm_ringbuf_rec
 {
-    int32_t           magic;
-    lcm_ringbuf_rec_t *prev;
-    lcm_ringbuf_rec_t *next;
+    int32_t       magic;
     unsigned int  length;
+    lcm_ringbuf_slab_t *slab;
     char          buf[];
 };
 
 struct _lcm_ringbuf {
-    char *data;
-    unsigned int   size;                 // allocated size of data
-    unsigned int   used;                 // total bytes currently allocated
-
-    lcm_ringbuf_rec_t *head;
-    lcm_ringbuf_rec_t *tail;
+    unsigned int   slab_size;
+    unsigned int   low_watermark;
+    unsigned int   high_watermark;
+    int            flags;
+
+    lcm_ringbuf_slab_t *cur;    // slab that chunks are allocated from
+    lcm_ringbuf_slab_t *active; // slabs with chunks allocated, and cur
+    lcm_ringbuf_slab_t *idle;   // empty slabs kept for reuse
+    lcm_ringbuf_rec_t  *last;   // most recent chunk, if not yet released
+
+    unsigned int   idle_size;   // total size of the idle slabs
+    lcm_ringbuf_stats_t stats;
 };
 
 static inline void ringbuf_self_test(lcm_ringbuf_t *ring)
@@ -38,122 +63,235 @@ static inline void ringbuf_self_test(lcm_ringbuf_t *ring)
     if (!EXTRA_RETENTIVE)
         return;
 
-    lcm_ringbuf_rec_t *prev = NULL;
-    lcm_ringbuf_rec_t *rec = ring->head;
-    
-    if (rec == NULL) {
-        assert(ring->tail == NULL);
-        assert(ring->used == 0);
-        return;
+    unsigned int total_used = 0;
+    unsigned int total_size = 0;
+    unsigned int nslabs = 0;
+    int found_cur = (ring->cur == NULL);
+
+    lcm_ringbuf_slab_t *prev = NULL;
+    lcm_ringbuf_slab_t *slab;
+    for (slab = ring->active; slab; slab = slab->next) {
+        assert(slab->prev == prev);
+        assert(slab->pos <= slab->size);
+        assert(slab->used <= slab->pos);
+        assert(slab->nrecs || slab == ring->cur);
+        if (slab == ring->cur)
+            found_cur = 1;
+        total_used += slab->used;
+        total_size += slab->size;
+        nslabs++;
+        prev = slab;
+    }
+    assert(found_cur);
+    assert(total_used == ring->stats.used);
+
+    unsigned int nidle = 0;
+    for (slab = ring->idle; slab; slab = slab->next) {
+        assert(slab->nrecs == 0 && slab->used == 0);
+        total_size += slab->size;
+        nidle++;
     }
-    
-    int total_length = 0;
+    assert(nidle == ring->stats.num_idle_slabs);
+    assert(nslabs + nidle == ring->stats.num_slabs);
+    assert(total_size == ring->stats.capacity);
 
-    while (1) {
-        assert(rec->prev == prev);
-        assert(rec->magic == MAGIC);
+    if (ring->last) {
+        assert(ring->last->magic == MAGIC);
+        assert(ring->last->slab == ring->cur);
+    }
+}
 
-        total_length += rec->length;
+static void
+slab_list_remove(lcm_ringbuf_slab_t **list, lcm_ringbuf_slab_t *slab)
+{
+    if (slab->prev)
+        slab->prev->next = slab->next;
+    else
+        *list = slab->next;
+    if (slab->next)
+        slab->next->prev = slab->prev;
+    slab->prev = slab->next = NULL;
+}
 
-        if (!rec->next)
-            break;
+static void
+slab_list_push(lcm_ringbuf_slab_t **list, lcm_ringbuf_slab_t *slab)
+{
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list)
+        (*list)->prev = slab;
+    *list = slab;
+}
 
-        prev = rec;
-        rec = rec->next;
+static char *
+slab_data_alloc(unsigned int size, int flags, int *mapped)
+{
+#ifdef __linux__
+    if (flags & LCM_RINGBUF_HUGEPAGES) {
+        void *data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        // explicitly reserved huge pages
+        data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (data == MAP_FAILED) {
+            // otherwise, ask for transparent huge pages
+            data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (data != MAP_FAILED)
+                madvise(data, size, MADV_HUGEPAGE);
+#endif
+        }
+        if (data != MAP_FAILED) {
+            *mapped = 1;
+            return (char*) data;
+        }
     }
+#endif
+    *mapped = 0;
+    return (char*) malloc(size);
+}
+
+static lcm_ringbuf_slab_t *
+slab_new(lcm_ringbuf_t *ring, unsigned int size)
+{
+    if (ring->high_watermark &&
+            ring->stats.capacity + size > ring->high_watermark)
+        return NULL;
+
+    lcm_ringbuf_slab_t *slab =
+        (lcm_ringbuf_slab_t*) calloc(1, sizeof(lcm_ringbuf_slab_t));
+    slab->data = slab_data_alloc(size, ring->flags, &slab->mapped);
+    if (!slab->data) {
+        free(slab);
+        return NULL;
+    }
+    slab->size = size;
+
+    ring->stats.num_slabs++;
+    ring->stats.capacity += size;
+    if (ring->stats.num_slabs > ring->stats.peak_slabs)
+        ring->stats.peak_slabs = ring->stats.num_slabs;
+    return slab;
+}
 
-    assert(ring->tail == rec);
-    assert(total_length == ring->used);
+static void
+slab_destroy(lcm_ringbuf_t *ring, lcm_ringbuf_slab_t *slab)
+{
+    ring->stats.num_slabs--;
+    ring->stats.capacity -= slab->size;
+#ifdef __linux__
+    if (slab->mapped)
+        munmap(slab->data, slab->size);
+    else
+#endif
+        free(slab->data);
+    free(slab);
+}
 
-    // check for loops?
+// called when the last chunk of a slab other than cur is released
+static void
+slab_release(lcm_ringbuf_t *ring, lcm_ringbuf_slab_t *slab)
+{
+    slab_list_remove(&ring->active, slab);
+    slab->pos = 0;
+
+    // oversized slabs are never reused
+    if (slab->size == ring->slab_size &&
+            ring->idle_size + slab->size <= ring->low_watermark) {
+        slab_list_push(&ring->idle, slab);
+        ring->idle_size += slab->size;
+        ring->stats.num_idle_slabs++;
+    } else {
+        slab_destroy(ring, slab);
+    }
 }
 
 lcm_ringbuf_t *
-lcm_ringbuf_new (unsigned int ring_size)
+lcm_ringbuf_new (unsigned int slab_size, unsigned int low_watermark,
+        unsigned int high_watermark, int flags)
 {
     lcm_ringbuf_t * ring;
 
-    ring = (lcm_ringbuf_t *) malloc (sizeof (lcm_ringbuf_t));
-    ring->data = (char*) malloc (ring_size);
-    ring->size = ring_size;
-    ring->used = 0;
-    ring->head = NULL;
-    ring->tail = NULL;
+#ifdef __linux__
+    if (flags & LCM_RINGBUF_HUGEPAGES)
+        slab_size = (slab_size + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1);
+#endif
+
+    ring = (lcm_ringbuf_t *) calloc (1, sizeof (lcm_ringbuf_t));
+    ring->slab_size = slab_size;
+    ring->low_watermark = low_watermark;
+    ring->high_watermark = high_watermark;
+    ring->flags = flags;
     return ring;
 }
 
 void
 lcm_ringbuf_free (lcm_ringbuf_t * ring)
 {
-    free (ring->data);
+    while (ring->active) {
+        lcm_ringbuf_slab_t *slab = ring->active;
+        slab_list_remove(&ring->active, slab);
+        slab_destroy(ring, slab);
+    }
+    while (ring->idle) {
+        lcm_ringbuf_slab_t *slab = ring->idle;
+        slab_list_remove(&ring->idle, slab);
+        slab_destroy(ring, slab);
+    }
     free (ring);
 }
 
 char * lcm_ringbuf_alloc (lcm_ringbuf_t *ring, unsigned int len)
 {
-    // Two possible configurations of the ring buffer:
-    //
-    // [         XXXXXXXXXXXX                  ]
-    //           ^head      ^tail
-    //
-    // [XXXXX                             XXXXX]
-    //      ^tail                         ^head
     ringbuf_self_test(ring);
- 
+
     len += sizeof(lcm_ringbuf_rec_t);
     len = (len + ALIGNMENT - 1) & (~(ALIGNMENT - 1));
 
-    if (!ring->head) {
-        assert (!ring->tail);
-        if (len > ring->size) {
-            return NULL;
+    lcm_ringbuf_slab_t *slab = ring->cur;
+    if (!slab || slab->pos + len > slab->size) {
+        // the current slab is full.  Start a new one, preferably an idle
+        // one.  The old slab is released once its last chunk is.
+        if (len <= ring->slab_size && ring->idle) {
+            slab = ring->idle;
+            slab_list_remove(&ring->idle, slab);
+            ring->idle_size -= slab->size;
+            ring->stats.num_idle_slabs--;
+        } else {
+            unsigned int size = len > ring->slab_size ? len : ring->slab_size;
+#ifdef __linux__
+            if (ring->flags & LCM_RINGBUF_HUGEPAGES)
+                size = (size + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1);
+#endif
+            slab = slab_new(ring, size);
+            if (!slab) {
+                ring->stats.num_overflows++;
+                return NULL; // no space!
+            }
         }
+        slab_list_push(&ring->active, slab);
 
-        lcm_ringbuf_rec_t *rec = (lcm_ringbuf_rec_t*) ring->data;
-        ring->tail = ring->head = rec;
-        rec->prev = rec->next = NULL;
-        rec->length = len;
-        ring->used  += len;
-        rec->magic = MAGIC;
-
-        ringbuf_self_test(ring);
-        return rec->buf;
+        lcm_ringbuf_slab_t *old = ring->cur;
+        ring->cur = slab;
+        if (old && !old->nrecs)
+            slab_release(ring, old);
     }
 
-    assert (ring->head && ring->tail);
-
-    lcm_ringbuf_rec_t *rec;
-
-    // Try to allocate from the current alloc_pos first; if that
-    // fails, try to allocate from offset 0.
-    char *candidate1 = ((char*) ring->tail) + ring->tail->length;
+    lcm_ringbuf_rec_t *rec = (lcm_ringbuf_rec_t*) (slab->data + slab->pos);
+    rec->magic = MAGIC;
+    rec->length = len;
+    rec->slab = slab;
 
-    if (ring->head > ring->tail) {
-        if (candidate1 + len <= (char*)ring->head) {
-            rec = (lcm_ringbuf_rec_t*) candidate1;
-        } else {
-            return NULL; // no space!
-        }
-    } else {
-        if (candidate1 + len <= ring->data + ring->size) {
-            rec = (lcm_ringbuf_rec_t*) candidate1;
-        } else if (ring->data + len < (char*)ring->head) {
-            rec = (lcm_ringbuf_rec_t*)ring->data;
-        } else {
-            return NULL; // no space!
-        }
-    }
+    slab->pos  += len;
+    slab->used += len;
+    slab->nrecs++;
+    ring->last = rec;
 
-    rec->length = len;
-    ring->used  += len;
-
-    // update links
-    rec->prev = ring->tail;
-    rec->next = NULL;
-    if (rec->prev) 
-        rec->prev->next = rec;
-    ring->tail = rec;
-    rec->magic = MAGIC;
+    ring->stats.used += len;
+    if (ring->stats.used > ring->stats.peak_used)
+        ring->stats.peak_used = ring->stats.used;
 
     ringbuf_self_test(ring);
     return rec->buf;
@@ -162,25 +300,31 @@ char * lcm_ringbuf_alloc (lcm_ringbuf_t *ring, unsigned int len)
 unsigned int
 lcm_ringbuf_capacity(lcm_ringbuf_t *ring)
 {
-    return ring->size;
+    return ring->stats.capacity;
 }
 
-unsigned int 
+unsigned int
 lcm_ringbuf_used(lcm_ringbuf_t *ring)
 {
-    return ring->used;
+    return ring->stats.used;
+}
+
+void
+lcm_ringbuf_get_stats(lcm_ringbuf_t *ring, lcm_ringbuf_stats_t *stats)
+{
+    *stats = ring->stats;
 }
 
-void 
-lcm_ringbuf_shrink_last(lcm_ringbuf_t *ring, const char *buf, 
+void
+lcm_ringbuf_shrink_last(lcm_ringbuf_t *ring, const char *buf,
         unsigned int newlen)
 {
     ringbuf_self_test(ring);
 
-    lcm_ringbuf_rec_t *rec = 
+    lcm_ringbuf_rec_t *rec =
         (lcm_ringbuf_rec_t*) (buf - offsetof(lcm_ringbuf_rec_t, buf));
     // make sure this is the most recent alloc
-    assert (rec == ring->tail);
+    assert (rec == ring->last);
     assert (rec->magic == MAGIC);
 
     // compute the new size
@@ -191,48 +335,41 @@ lcm_ringbuf_shrink_last(lcm_ringbuf_t *ring, const char *buf,
 
     unsigned int shrink_amount = rec->length - newlen;
 
-    rec->length      = newlen;
-    ring->used      -= shrink_amount;
+    rec->length       = newlen;
+    rec->slab->pos   -= shrink_amount;
+    rec->slab->used  -= shrink_amount;
+    ring->stats.used -= shrink_amount;
 
-    assert(ring->used >= 0);
     ringbuf_self_test(ring);
 }
 
-/* 
- * Releases a previously-allocated chunk of the ring buffer.  Only the most
- * recently allocated, or the least recently allocated chunk can be released.
- */
 void lcm_ringbuf_dealloc (lcm_ringbuf_t * ring, char * buf)
 {
     ringbuf_self_test(ring);
 
-    lcm_ringbuf_rec_t *rec = 
+    lcm_ringbuf_rec_t *rec =
         (lcm_ringbuf_rec_t*) (buf - offsetof(lcm_ringbuf_rec_t, buf));
 
-    assert (rec == ring->head || rec == ring->tail);
-
     assert (rec->magic == MAGIC);
+    rec->magic = 0;
 
-    ring->used -= rec->length;
-
-    if (rec == ring->head) {
-        ring->head = rec->next;
-        if (!ring->head) 
-            ring->tail = NULL;
-        else 
-            ring->head->prev = NULL;
-    } else if (rec == ring->tail) {
-        ring->tail = rec->prev;
-        if (!ring->tail) 
-            ring->head = NULL;
-        else 
-            ring->tail->next = NULL;
+    lcm_ringbuf_slab_t *slab = rec->slab;
+    slab->used -= rec->length;
+    slab->nrecs--;
+    ring->stats.used -= rec->length;
+
+    // the most recent chunk can be reused right away
+    if (rec == ring->last) {
+        slab->pos -= rec->length;
+        ring->last = NULL;
     }
 
-    assert ((!ring->head && !ring->tail) || 
-           (ring->head->prev == NULL && ring->tail->next == NULL));
-    if (0 == ring->used) { assert (!ring->head && !ring->tail); }
+    if (!slab->nrecs) {
+        if (slab == ring->cur)
+            slab->pos = 0;
+        else
+            slab_release(ring, slab);
+    }
 
-    rec->magic = 0;
     ringbuf_self_test(ring);
 }
@@ -7,14 +7,46 @@ extern "C" {
 
 #include <stdint.h>
 
+/*
+ * The ring buffer is a chain of fixed-size slabs.  Chunks are carved out of
+ * the current slab in order, and a new slab is started when it fills up.
+ * Slabs are recycled once every chunk allocated from them has been released,
+ * so the ring grows in slab-sized steps under a burst instead of being
+ * reallocated, and shrinks back down afterwards.
+ */
 typedef struct _lcm_ringbuf lcm_ringbuf_t;
 
-lcm_ringbuf_t * lcm_ringbuf_new (unsigned int ring_size);
+/* Back slabs with huge pages, if the operating system supports it. */
+#define LCM_RINGBUF_HUGEPAGES 1
+
+typedef struct _lcm_ringbuf_stats {
+    unsigned int num_slabs;       // slabs currently allocated, including idle
+    unsigned int num_idle_slabs;  // empty slabs kept for reuse
+    unsigned int peak_slabs;      // largest value of num_slabs so far
+    unsigned int capacity;        // total size of all slabs, in bytes
+    unsigned int used;            // bytes currently allocated
+    unsigned int peak_used;       // largest value of used so far
+    uint64_t num_overflows;       // allocations refused at the high watermark
+} lcm_ringbuf_stats_t;
+
+/*
+ * Creates a ring buffer made of slab_size byte slabs.
+ *
+ * low_watermark: total size of the empty slabs kept around for reuse.  Slabs
+ *                beyond that are returned to the operating system as soon as
+ *                they are emptied.
+ * high_watermark: maximum total size of all slabs.  Allocations that would
+ *                need more memory fail.  0 indicates no limit.
+ * flags: 0 or LCM_RINGBUF_HUGEPAGES.
+ */
+lcm_ringbuf_t * lcm_ringbuf_new (unsigned int slab_size,
+        unsigned int low_watermark, unsigned int high_watermark, int flags);
 void lcm_ringbuf_free (lcm_ringbuf_t * ring);
 
-/* 
+/*
  * Allocates a variable-sized chunk of the ring buffer for use by the
- * application.  Returns the pointer to the available chunk. 
+ * application.  Returns the pointer to the available chunk, or NULL if the
+ * ring buffer has reached its high watermark.
  */
 char * lcm_ringbuf_alloc (lcm_ringbuf_t * ring, unsigned int len);
 
@@ -22,16 +54,19 @@ char * lcm_ringbuf_alloc (lcm_ringbuf_t * ring, unsigned int len);
  * resizes the most recently allocated chunk of the ring buffer.  The newly
  * requested size must be smaller than the original chunk size.
  */
-void lcm_ringbuf_shrink_last(lcm_ringbuf_t *ring, const char *buf, 
+void lcm_ringbuf_shrink_last(lcm_ringbuf_t *ring, const char *buf,
         unsigned int len);
 
 unsigned int lcm_ringbuf_capacity(lcm_ringbuf_t *ring);
 
 unsigned int lcm_ringbuf_used(lcm_ringbuf_t *ring);
 
-/* 
- * Releases a previously-allocated chunk of the ring buffer.  Only the most
- * recently allocated, or the least recently allocated chunk can be released.
+void lcm_ringbuf_get_stats(lcm_ringbuf_t *ring, lcm_ringbuf_stats_t *stats);
+
+/*
+ * Releases a previously-allocated chunk of the ring buffer.  Chunks may be
+ * released in any order, but a slab is only recycled once all of its chunks
+ * have been released.
  */
 void lcm_ringbuf_dealloc (lcm_ringbuf_t * ring, char * buf);
 
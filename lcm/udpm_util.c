@@ -1,5 +1,6 @@
 #include "udpm_util.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -9,17 +10,100 @@
 
 #define LCM_MAX_UNFRAGMENTED_PACKET_SIZE 65536
 
+/******************** reassembly buffer pool **********************/
+static inline uint32_t
+_pool_class_size (int size_class)
+{
+    return (uint32_t) 1 << (LCM_BUF_POOL_MIN_SIZE_LOG2 + size_class);
+}
+
+// smallest size class that fits size bytes, or the largest size class
+static int
+_pool_size_class (uint32_t size)
+{
+    int size_class = 0;
+    while (size_class < LCM_BUF_POOL_NUM_CLASSES - 1 &&
+            _pool_class_size (size_class) < size)
+        size_class++;
+    return size_class;
+}
+
+lcm_buf_pool_t *
+lcm_buf_pool_new (void)
+{
+    lcm_buf_pool_t *pool = (lcm_buf_pool_t *) calloc (1,
+            sizeof (lcm_buf_pool_t));
+    pool->mutex = g_mutex_new ();
+    return pool;
+}
+
+void
+lcm_buf_pool_destroy (lcm_buf_pool_t *pool)
+{
+    int size_class;
+    for (size_class = 0; size_class < LCM_BUF_POOL_NUM_CLASSES; size_class++) {
+        int i;
+        for (i = 0; i < pool->num_free[size_class]; i++)
+            free (pool->free_bufs[size_class][i]);
+    }
+    g_mutex_free (pool->mutex);
+    free (pool);
+}
+
+char *
+lcm_buf_pool_get (lcm_buf_pool_t *pool, uint32_t size, uint32_t *capacity)
+{
+    int size_class = _pool_size_class (size);
+    uint32_t class_size = _pool_class_size (size_class);
+    if (class_size < size) {
+        // too large for the pool
+        *capacity = size;
+        return (char *) malloc (size);
+    }
+
+    char *buf = NULL;
+    g_mutex_lock (pool->mutex);
+    if (pool->num_free[size_class]) {
+        buf = pool->free_bufs[size_class][--pool->num_free[size_class]];
+        pool->free_size -= class_size;
+    }
+    g_mutex_unlock (pool->mutex);
+
+    if (!buf)
+        buf = (char *) malloc (class_size);
+    *capacity = class_size;
+    return buf;
+}
+
+void
+lcm_buf_pool_put (lcm_buf_pool_t *pool, char *buf, uint32_t capacity)
+{
+    int size_class = _pool_size_class (capacity);
+    if (_pool_class_size (size_class) == capacity) {
+        g_mutex_lock (pool->mutex);
+        if (pool->num_free[size_class] < LCM_BUF_POOL_MAX_FREE &&
+                pool->free_size + capacity <= LCM_BUF_POOL_MAX_SIZE) {
+            pool->free_bufs[size_class][pool->num_free[size_class]++] = buf;
+            pool->free_size += capacity;
+            buf = NULL;
+        }
+        g_mutex_unlock (pool->mutex);
+    }
+    free (buf);
+}
+
 /******************** fragment buffer **********************/
 lcm_frag_buf_t *
-lcm_frag_buf_new (struct sockaddr_in from, const char *channel, 
-        uint32_t msg_seqno, uint32_t data_size, uint16_t nfragments,
-        int64_t first_packet_utime)
+lcm_frag_buf_new (lcm_buf_pool_t *pool, struct sockaddr_in from,
+        const char *channel, uint32_t msg_seqno, uint32_t data_size,
+        uint16_t nfragments, int64_t first_packet_utime)
 {
-    lcm_frag_buf_t *fbuf = (lcm_frag_buf_t*) malloc (sizeof (lcm_frag_buf_t));
+    lcm_frag_buf_t *fbuf = (lcm_frag_buf_t*) calloc (1, sizeof (lcm_frag_buf_t));
     strncpy (fbuf->channel, channel, sizeof (fbuf->channel));
     fbuf->from = from;
     fbuf->msg_seqno = msg_seqno;
-    fbuf->data = (char*)malloc (data_size);
+    fbuf->pool = pool;
+    fbuf->data = lcm_buf_pool_get (pool, data_size, &fbuf->data_capacity);
     fbuf->data_size = data_size;
     fbuf->fragments_remaining = nfragments;
     fbuf->last_packet_utime = first_packet_utime;
@@ -29,14 +113,36 @@ lcm_frag_buf_new (struct sockaddr_in from, const char *channel,
 void
 lcm_frag_buf_destroy (lcm_frag_buf_t *fbuf)
 {
-    free (fbuf->data);
+    if (fbuf->data)
+        lcm_buf_pool_put (fbuf->pool, fbuf->data, fbuf->data_capacity);
     free (fbuf);
 }
 
+void
+lcm_frag_buf_transfer (lcm_frag_buf_t *fbuf, lcm_buf_t *lcmb)
+{
+    // transfer ownership of the message's payload buffer
+    lcmb->buf = fbuf->data;
+    lcmb->buf_size = fbuf->data_capacity;
+    lcmb->pool = fbuf->pool;
+    fbuf->data = NULL;
+
+    strcpy (lcmb->channel_name, fbuf->channel);
+    lcmb->channel_size = strlen (lcmb->channel_name);
+    lcmb->data_offset = 0;
+    lcmb->data_size = fbuf->data_size;
+    lcmb->recv_utime = fbuf->last_packet_utime;
+}
+
 
 
 /******************** fragment buffer store **********************/
 
+struct _lcm_frag_sender {
+    struct sockaddr_in from;
+    GQueue frag_bufs;            // least recently updated first
+};
+
 static guint
 _sockaddr_in_hash (const void * key)
 {
@@ -56,63 +162,189 @@ _sockaddr_in_equal (const void * a, const void *b)
            a_addr->sin_family      == b_addr->sin_family;
 }
 
-static void
-_find_lru_frag_buf (gpointer key, gpointer value, void *user_data)
+static guint
+_frag_buf_hash (const void * key)
 {
-    lcm_frag_buf_t **lru_fbuf = (lcm_frag_buf_t**) user_data;
-    lcm_frag_buf_t *c_fbuf = (lcm_frag_buf_t*) value;
-    if (! *lru_fbuf ||
-        (c_fbuf->last_packet_utime < (*lru_fbuf)->last_packet_utime)) {
-        *lru_fbuf = c_fbuf;
-    }
+    lcm_frag_buf_t *fbuf = (lcm_frag_buf_t*) key;
+    return _sockaddr_in_hash (&fbuf->from) ^ (fbuf->msg_seqno * 2654435761u);
+}
+
+static gboolean
+_frag_buf_equal (const void * a, const void *b)
+{
+    lcm_frag_buf_t *a_fbuf = (lcm_frag_buf_t*) a;
+    lcm_frag_buf_t *b_fbuf = (lcm_frag_buf_t*) b;
+
+    return a_fbuf->msg_seqno == b_fbuf->msg_seqno &&
+           _sockaddr_in_equal (&a_fbuf->from, &b_fbuf->from);
 }
 
 lcm_frag_buf_store * lcm_frag_buf_store_new(uint32_t max_total_size,
-        uint32_t max_n_frag_bufs) {
+        uint32_t max_n_frag_bufs, uint32_t max_n_frag_bufs_per_sender) {
     lcm_frag_buf_store * store = (lcm_frag_buf_store *) calloc(1,
             sizeof(lcm_frag_buf_store));
     store->total_size = 0;
     store->max_total_size = max_total_size;
     store->max_n_frag_bufs = max_n_frag_bufs;
+    store->max_n_frag_bufs_per_sender = max_n_frag_bufs_per_sender;
 
-    store->frag_bufs = g_hash_table_new_full(_sockaddr_in_hash,
-                                       _sockaddr_in_equal, NULL,
+    store->frag_bufs = g_hash_table_new_full(_frag_buf_hash,
+                                       _frag_buf_equal, NULL,
                                        (GDestroyNotify) lcm_frag_buf_destroy);
+    store->senders = g_hash_table_new_full(_sockaddr_in_hash,
+                                       _sockaddr_in_equal, NULL, free);
+    g_queue_init (&store->lru);
     return store;
 }
 
 void lcm_frag_buf_store_destroy(lcm_frag_buf_store * store){
     g_hash_table_destroy (store->frag_bufs);
+    g_hash_table_destroy (store->senders);
     free(store);
 }
 
 lcm_frag_buf_t * lcm_frag_buf_store_lookup(lcm_frag_buf_store * store,
-        struct sockaddr* key) {
-    return (lcm_frag_buf_t *) g_hash_table_lookup(store->frag_bufs, key);
+        struct sockaddr* from, uint32_t msg_seqno) {
+    lcm_frag_buf_t key;
+    key.from = *((struct sockaddr_in*) from);
+    key.msg_seqno = msg_seqno;
+
+    lcm_frag_buf_t *fbuf =
+        (lcm_frag_buf_t *) g_hash_table_lookup(store->frag_bufs, &key);
+    if (fbuf) {
+        // move to the back of both LRU lists
+        g_queue_unlink (&store->lru, &fbuf->lru_link);
+        g_queue_push_tail_link (&store->lru, &fbuf->lru_link);
+        g_queue_unlink (&fbuf->sender->frag_bufs, &fbuf->sender_link);
+        g_queue_push_tail_link (&fbuf->sender->frag_bufs, &fbuf->sender_link);
+    }
+    return fbuf;
 }
 
 void
 lcm_frag_buf_store_add (lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
 {
-    while (store->total_size > store->max_total_size ||
-            g_hash_table_size (store->frag_bufs) > store->max_n_frag_bufs) {
-        // find and remove the least recently updated fragment buffer
-        lcm_frag_buf_t *lru_fbuf = NULL;
-        g_hash_table_foreach (store->frag_bufs, _find_lru_frag_buf, &lru_fbuf);
-        if (lru_fbuf){
-            lcm_frag_buf_store_remove (store, lru_fbuf);
-        }
+    lcm_frag_sender_t *sender;
+
+    // make room by evicting the least recently updated fragment buffers,
+    // first from the same sender, then from all senders.  Removing the last
+    // buffer of a sender also frees the sender, so look it up every time.
+    while ((sender = (lcm_frag_sender_t *)
+                g_hash_table_lookup (store->senders, &fbuf->from)) &&
+            sender->frag_bufs.length >= store->max_n_frag_bufs_per_sender) {
+        lcm_frag_buf_t *lru_fbuf =
+            (lcm_frag_buf_t *) g_queue_peek_head (&sender->frag_bufs);
+        dbg (DBG_LCM, "Dropping message %u (missing %d fragments)\n",
+                lru_fbuf->msg_seqno, lru_fbuf->fragments_remaining);
+        lcm_frag_buf_store_remove (store, lru_fbuf);
+        store->num_evicted++;
     }
-    g_hash_table_insert (store->frag_bufs, &fbuf->from, fbuf);
+    while (!g_queue_is_empty (&store->lru) &&
+            (store->total_size + fbuf->data_size > store->max_total_size ||
+             store->lru.length >= store->max_n_frag_bufs)) {
+        lcm_frag_buf_t *lru_fbuf =
+            (lcm_frag_buf_t *) g_queue_peek_head (&store->lru);
+        lcm_frag_buf_store_remove (store, lru_fbuf);
+        store->num_evicted++;
+    }
+
+    sender = (lcm_frag_sender_t *)
+        g_hash_table_lookup (store->senders, &fbuf->from);
+    if (!sender) {
+        sender = (lcm_frag_sender_t *) calloc (1, sizeof (lcm_frag_sender_t));
+        sender->from = fbuf->from;
+        g_queue_init (&sender->frag_bufs);
+        g_hash_table_insert (store->senders, &sender->from, sender);
+    }
+
+    fbuf->sender = sender;
+    fbuf->lru_link.data = fbuf;
+    g_queue_push_tail_link (&store->lru, &fbuf->lru_link);
+    fbuf->sender_link.data = fbuf;
+    g_queue_push_tail_link (&sender->frag_bufs, &fbuf->sender_link);
+
+    g_hash_table_insert (store->frag_bufs, fbuf, fbuf);
     store->total_size += fbuf->data_size;
 }
 
 void
 lcm_frag_buf_store_remove (lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
 {
+    lcm_frag_sender_t *sender = fbuf->sender;
+    g_queue_unlink (&store->lru, &fbuf->lru_link);
+    g_queue_unlink (&sender->frag_bufs, &fbuf->sender_link);
+    if (g_queue_is_empty (&sender->frag_bufs))
+        g_hash_table_remove (store->senders, &sender->from);
+
     store->total_size -= fbuf->data_size;
-    g_hash_table_remove (store->frag_bufs, &fbuf->from);
+    g_hash_table_remove (store->frag_bufs, fbuf);
+}
+
+#ifdef LCM_RECV_FRAGMENTS_IN_PLACE
+int
+lcm_frag_buf_store_recv (lcm_frag_buf_store *store, SOCKET fd,
+        lcm_buf_t *lcmb, lcm_frag_buf_t **fbuf_out, uint32_t *kernel_drops)
+{
+    *fbuf_out = NULL;
+
+    // only worth checking while messages are being reassembled
+    if (g_queue_is_empty (&store->lru))
+        return 0;
+
+    // peek at the header of the next datagram.  If that fails, leave it to
+    // the caller to receive the datagram and report the error.
+    lcm2_header_long_t hdr;
+    struct sockaddr_in from;
+    socklen_t fromlen = sizeof (from);
+    ssize_t sz = recvfrom (fd, &hdr, sizeof (hdr), MSG_PEEK,
+            (struct sockaddr*) &from, &fromlen);
+    if (sz < (ssize_t) sizeof (hdr) || ntohl (hdr.magic) != LCM2_MAGIC_LONG ||
+            hdr.fragment_no == 0)
+        return 0;
+
+    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup (store,
+            (struct sockaddr*) &from, ntohl (hdr.msg_seqno));
+    uint32_t fragment_offset = ntohl (hdr.fragment_offset);
+    if (!fbuf || fbuf->data_size != ntohl (hdr.msg_size) ||
+            fragment_offset >= fbuf->data_size)
+        return 0;
+
+    // receive the header on its own, and the payload in place
+    struct iovec vec[2];
+    vec[0].iov_base = &hdr;
+    vec[0].iov_len = sizeof (hdr);
+    vec[1].iov_base = fbuf->data + fragment_offset;
+    vec[1].iov_len = fbuf->data_size - fragment_offset;
+
+    struct msghdr msg;
+    memset (&msg, 0, sizeof (struct msghdr));
+    msg.msg_name = &lcmb->from;
+    msg.msg_namelen = sizeof (struct sockaddr);
+    msg.msg_iov = vec;
+    msg.msg_iovlen = 2;
+#ifdef MSG_EXT_HDR
+    char controlbuf[64];
+    msg.msg_control = controlbuf;
+    msg.msg_controllen = sizeof (controlbuf);
+#endif
+    sz = recvmsg (fd, &msg, 0);
+    if (sz < 0)
+        return -1;
+    lcmb->fromlen = msg.msg_namelen;
+
+    lcmb->recv_utime = lcm_recv_control_parse (&msg, kernel_drops);
+
+    if (msg.msg_flags & MSG_TRUNC) {
+        dbg (DBG_LCM, "dropping invalid fragment (off: %d, %d / %d)\n",
+                fragment_offset, (int) sz, fbuf->data_size);
+        lcm_frag_buf_store_remove (store, fbuf);
+        return sz;
+    }
+
+    *fbuf_out = fbuf;
+    return sz;
 }
+#endif
 
 
 /*** Functions for managing a queue of lcm buffers ***/
@@ -155,77 +387,81 @@ lcm_buf_enqueue (lcm_buf_queue_t * q, lcm_buf_t * el)
 }
 
  void
-lcm_buf_free_data(lcm_buf_t *lcmb, lcm_ringbuf_t *ringbuf)
-{
-    if(!lcmb->buf)
-        return;
-    if (lcmb->ringbuf) {
-        lcm_ringbuf_dealloc (lcmb->ringbuf, lcmb->buf);
-
-        // if the packet was allocated from an obsolete and empty ringbuffer,
-        // then deallocate the old ringbuffer as well.
-        if(lcmb->ringbuf != ringbuf && !lcm_ringbuf_used(lcmb->ringbuf)) {
-            lcm_ringbuf_free(lcmb->ringbuf);
-            dbg(DBG_LCM, "Destroying unused orphan ringbuffer %p\n",
-                    lcmb->ringbuf);
+lcm_buf_free_data(lcm_buf_t *lcmb)
+{
+    if (lcmb->buf) {
+        if (lcmb->ringbuf) {
+            lcm_ringbuf_dealloc (lcmb->ringbuf, lcmb->buf);
+        } else if (lcmb->pool) {
+            lcm_buf_pool_put (lcmb->pool, lcmb->buf, lcmb->buf_size);
+        } else {
+            free (lcmb->buf);
         }
-    } else {
-        free (lcmb->buf);
     }
     lcmb->buf = NULL;
     lcmb->buf_size = 0;
     lcmb->ringbuf = NULL;
+    lcmb->pool = NULL;
 }
 
 lcm_buf_t *
-lcm_buf_allocate_data(lcm_buf_queue_t * inbufs_empty, lcm_ringbuf_t **ringbuf) {
-     lcm_buf_t * lcmb = NULL;
-     // first allocate a buffer struct for the packet metadata
-     if (lcm_buf_queue_is_empty(inbufs_empty)) {
-         // allocate additional buffer structs if needed
-         int i;
-         for (i = 0; i < LCM_DEFAULT_RECV_BUFS; i++) {
-             lcm_buf_t * nbuf = (lcm_buf_t *) calloc(1, sizeof(lcm_buf_t));
-             lcm_buf_enqueue(inbufs_empty, nbuf);
-         }
-     }
-
-     lcmb = lcm_buf_dequeue(inbufs_empty);
-     assert(lcmb);
-
-    // allocate space on the ringbuffer for the packet data.
+lcm_buf_allocate(lcm_buf_queue_t * inbufs_empty)
+{
+    if (lcm_buf_queue_is_empty(inbufs_empty)) {
+        // allocate additional buffer structs if needed
+        int i;
+        for (i = 0; i < LCM_DEFAULT_RECV_BUFS; i++) {
+            lcm_buf_t * nbuf = (lcm_buf_t *) calloc(1, sizeof(lcm_buf_t));
+            lcm_buf_enqueue(inbufs_empty, nbuf);
+        }
+    }
+
+    lcm_buf_t * lcmb = lcm_buf_dequeue(inbufs_empty);
+    assert(lcmb);
+    return lcmb;
+}
+
+lcm_buf_t *
+lcm_buf_allocate_data_size(lcm_buf_queue_t * inbufs_empty,
+        lcm_ringbuf_t *ringbuf, unsigned int data_size)
+{
+    // allocate space on the ringbuffer for the packet data.  The ringbuffer
+    // grows as needed, up to its high watermark.
+    char *buf = lcm_ringbuf_alloc(ringbuf, data_size);
+    if (buf == NULL) {
+        dbg(DBG_LCM, "Ringbuffer %p is at its high watermark (%u bytes)\n",
+                ringbuf, lcm_ringbuf_capacity(ringbuf));
+        return NULL;
+    }
+
+    // allocate a buffer struct for the packet metadata
+    lcm_buf_t * lcmb = lcm_buf_allocate(inbufs_empty);
+    lcmb->buf = buf;
+    lcmb->ringbuf = ringbuf;
+    lcmb->buf_size = data_size;
+    return lcmb;
+}
+
+lcm_buf_t *
+lcm_buf_allocate_data(lcm_buf_queue_t * inbufs_empty, lcm_ringbuf_t *ringbuf)
+{
     // give it the maximum possible size for an unfragmented packet
-    lcmb->buf = lcm_ringbuf_alloc(*ringbuf, LCM_MAX_UNFRAGMENTED_PACKET_SIZE);
-    if (lcmb->buf == NULL) {
-         // ringbuffer is full.  allocate a larger ringbuffer
-
-         // Can't free the old ringbuffer yet because it's in use (i.e., full)
-         // Must wait until later to free it.
-         assert(lcm_ringbuf_used(*ringbuf) > 0);
-         dbg(DBG_LCM, "Orphaning ringbuffer %p\n", *ringbuf);
-
-         unsigned int old_capacity = lcm_ringbuf_capacity(*ringbuf);
-         unsigned int new_capacity = (unsigned int) (old_capacity * 1.5);
-         // replace the passed in ringbuf with the new one
-         *ringbuf = lcm_ringbuf_new(new_capacity);
-         lcmb->buf = lcm_ringbuf_alloc(*ringbuf, 65536);
-         assert(lcmb->buf);
-         dbg(DBG_LCM, "Allocated new ringbuffer size %u\n", new_capacity);
-     }
-     // save a pointer to the ringbuf, in case it gets replaced by another call
-     lcmb->ringbuf = *ringbuf;
-
-     // zero the last byte so that strlen never segfaults
-     lcmb->buf[65535] = 0;
-     return lcmb;
- }
+    lcm_buf_t * lcmb = lcm_buf_allocate_data_size(inbufs_empty, ringbuf,
+            LCM_MAX_UNFRAGMENTED_PACKET_SIZE);
+    if (!lcmb)
+        return NULL;
+
+    // zero the last byte so that strlen never segfaults
+    lcmb->buf[65535] = 0;
+    return lcmb;
+}
 
  void
-lcm_buf_queue_free (lcm_buf_queue_t * q, lcm_ringbuf_t *ringbuf)
+lcm_buf_queue_free (lcm_buf_queue_t * q)
 {
     lcm_buf_t * el;
     while ( (el = lcm_buf_dequeue (q))) {
-        lcm_buf_free_data(el, ringbuf);
+        lcm_buf_free_data(el);
         free (el);
     }
     free (q);
@@ -237,6 +473,120 @@ lcm_buf_queue_is_empty (lcm_buf_queue_t * q)
     return q->head == NULL ? 1 : 0;
 }
 
+/*** Functions for the lock-free ring of message buffers ***/
+lcm_buf_ring_t *
+lcm_buf_ring_new (unsigned int capacity)
+{
+    assert (capacity && !(capacity & (capacity - 1)));
+    lcm_buf_ring_t * r = (lcm_buf_ring_t *) calloc (1, sizeof (lcm_buf_ring_t));
+    r->slots = (lcm_buf_t **) calloc (capacity, sizeof (lcm_buf_t *));
+    r->capacity = capacity;
+    return r;
+}
+
+void
+lcm_buf_ring_free (lcm_buf_ring_t * r)
+{
+    lcm_buf_t * el;
+    while ( (el = lcm_buf_ring_pop (r))) {
+        lcm_buf_free_data(el);
+        free (el);
+    }
+    free (r->slots);
+    free (r);
+}
+
+int
+lcm_buf_ring_push (lcm_buf_ring_t * r, lcm_buf_t * el)
+{
+    // only the producer writes head, so it can be read without a barrier
+    guint head = (guint) r->head;
+    guint tail = (guint) g_atomic_int_get (&r->tail);
+    if (head - tail >= r->capacity)
+        return 0;
+    r->slots[head & (r->capacity - 1)] = el;
+    // publish the slot contents before the new head
+    g_atomic_int_set (&r->head, (gint) (head + 1));
+    return 1;
+}
+
+lcm_buf_t *
+lcm_buf_ring_pop (lcm_buf_ring_t * r)
+{
+    // only the consumer writes tail, so it can be read without a barrier
+    guint tail = (guint) r->tail;
+    guint head = (guint) g_atomic_int_get (&r->head);
+    if (head == tail)
+        return NULL;
+    lcm_buf_t * el = r->slots[tail & (r->capacity - 1)];
+    // release the slot only after it has been read
+    g_atomic_int_set (&r->tail, (gint) (tail + 1));
+    return el;
+}
+
+/*** Options for the receive ringbuffer ***/
+void
+lcm_ringbuf_params_init (lcm_ringbuf_params_t *params)
+{
+    params->slab_size = LCM_RINGBUF_SIZE;
+    params->low_watermark = LCM_RINGBUF_LOW_WATERMARK;
+    params->high_watermark = 0;
+    params->flags = 0;
+}
+
+static int
+_parse_size (const char *key, const char *value, unsigned int *result)
+{
+    char *endptr = NULL;
+    unsigned long size = strtoul (value, &endptr, 0);
+    if (endptr == value) {
+        fprintf (stderr, "Warning: Invalid value for %s\n", key);
+        return -1;
+    }
+    *result = (unsigned int) size;
+    return 0;
+}
+
+int
+lcm_ringbuf_params_parse (lcm_ringbuf_params_t *params, const char *key,
+        const char *value)
+{
+    if (!strcmp (key, "ringbuf_slab_size")) {
+        if (_parse_size (key, value, &params->slab_size) == 0 &&
+                params->slab_size < LCM_RINGBUF_MIN_SLAB_SIZE) {
+            fprintf (stderr, "Warning: ringbuf_slab_size must be >= %d.  "
+                    "Setting to %d\n", LCM_RINGBUF_MIN_SLAB_SIZE,
+                    LCM_RINGBUF_MIN_SLAB_SIZE);
+            params->slab_size = LCM_RINGBUF_MIN_SLAB_SIZE;
+        }
+    }
+    else if (!strcmp (key, "ringbuf_low_watermark")) {
+        _parse_size (key, value, &params->low_watermark);
+    }
+    else if (!strcmp (key, "ringbuf_high_watermark")) {
+        _parse_size (key, value, &params->high_watermark);
+    }
+    else if (!strcmp (key, "ringbuf_hugepages")) {
+        if (atoi (value))
+            params->flags |= LCM_RINGBUF_HUGEPAGES;
+        else
+            params->flags &= ~LCM_RINGBUF_HUGEPAGES;
+    }
+    else {
+        return 0;
+    }
+    return 1;
+}
+
+lcm_ringbuf_t *
+lcm_ringbuf_params_create (const lcm_ringbuf_params_t *params)
+{
+    unsigned int low_watermark = params->low_watermark;
+    if (params->high_watermark && low_watermark > params->high_watermark)
+        low_watermark = params->high_watermark;
+    return lcm_ringbuf_new (params->slab_size, low_watermark,
+            params->high_watermark, params->flags);
+}
 
 
 #ifdef __linux__
@@ -7,6 +7,7 @@ extern "C" {
 
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifndef WIN32
 #include <unistd.h>
@@ -25,6 +26,9 @@ typedef int SOCKET;
 #include <winsock2.h>
 #include <Ws2tcpip.h>
 #define MSG_EXT_HDR
+#else
+// fragments can be received directly into their reassembly buffer
+#define LCM_RECV_FRAGMENTS_IN_PLACE
 #endif
 
 #include <glib.h>
@@ -44,12 +48,25 @@ typedef int SOCKET;
 #define LCM_FRAGMENT_MAX_PAYLOAD 65487
 #endif
 
+// default slab size of the receive ringbuffer
 #define LCM_RINGBUF_SIZE (200*1024)
+// smallest slab size accepted by the ringbuf_slab_size option.  Each slab
+// must hold at least one maximum-size datagram.
+#define LCM_RINGBUF_MIN_SLAB_SIZE (128*1024)
+// default amount of empty slabs kept for reuse after a burst
+#define LCM_RINGBUF_LOW_WATERMARK (4*LCM_RINGBUF_SIZE)
 
 #define LCM_DEFAULT_RECV_BUFS 2000
 
+// capacity of the ring used to hand received messages to lcm_handle().  Must
+// be a power of two.
+#define LCM_BUF_RING_SIZE 4096
+
 #define MAX_FRAG_BUF_TOTAL_SIZE (1 << 24)// 16 megabytes
 #define MAX_NUM_FRAG_BUFS 1000
+// number of large messages from a single sender that can be reassembled at
+// the same time
+#define MAX_NUM_FRAG_BUFS_PER_SENDER 8
 
 // HUGE is not defined on cygwin as of 2008-03-05
 #ifndef HUGE
@@ -95,6 +112,21 @@ lcm_close_socket(SOCKET fd)
 #endif
 }
 
+// read and discard the next datagram waiting on fd.  Returns 0 on success, or
+// -1 if no datagram could be read.
+static inline int
+lcm_discard_datagram(SOCKET fd)
+{
+    char c;
+    int status = recv(fd, &c, 1, 0);
+#ifdef WIN32
+    // the rest of a truncated datagram is discarded, but reported as an error
+    if (status < 0 && WSAGetLastError() == WSAEMSGSIZE)
+        return 0;
+#endif
+    return status < 0 ? -1 : 0;
+}
+
 static inline int
 lcm_timeval_compare (const GTimeVal *a, const GTimeVal *b) {
     if (a->tv_sec == b->tv_sec && a->tv_usec == b->tv_usec) return 0;
@@ -134,6 +166,61 @@ lcm_timestamp_now()
     return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
+// Reads the control messages of a datagram received with recvmsg().  Returns
+// the kernel receive timestamp, or the current time if the kernel did not
+// provide one.  If the kernel reported how many datagrams it has dropped on
+// the socket so far (SO_RXQ_OVFL), the count is stored in *kernel_drops.
+static inline int64_t
+lcm_recv_control_parse(struct msghdr *msg, uint32_t *kernel_drops)
+{
+    int64_t recv_utime = 0;
+#if defined(SO_TIMESTAMP) || defined(SO_RXQ_OVFL)
+    struct cmsghdr *cmsg;
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+#ifdef SO_TIMESTAMP
+        if (cmsg->cmsg_type == SCM_TIMESTAMP) {
+            struct timeval *t = (struct timeval*) CMSG_DATA(cmsg);
+            recv_utime = (int64_t) t->tv_sec * 1000000 + t->tv_usec;
+        }
+#endif
+#ifdef SO_RXQ_OVFL
+        if (cmsg->cmsg_type == SO_RXQ_OVFL)
+            memcpy(kernel_drops, CMSG_DATA(cmsg), sizeof(uint32_t));
+#endif
+    }
+#endif
+    return recv_utime ? recv_utime : lcm_timestamp_now();
+}
+
+
+/******************** reassembly buffer pool **********************/
+// Buffers for reassembling fragmented messages are recycled through a pool
+// with power of two size classes, instead of being allocated and freed for
+// every message.  Pooled buffers are allocated with malloc(), so a buffer
+// taken from the pool may also be released with free().  The pool is
+// thread-safe.
+#define LCM_BUF_POOL_MIN_SIZE_LOG2 16   // smallest size class, 64 KB
+#define LCM_BUF_POOL_NUM_CLASSES 13     // up to LCM_MAX_MESSAGE_SIZE
+#define LCM_BUF_POOL_MAX_FREE 4         // unused buffers kept per size class
+#define LCM_BUF_POOL_MAX_SIZE (1 << 25) // unused bytes kept in total, 32 MB
+
+typedef struct _lcm_buf_pool {
+    GMutex *mutex;
+    char *free_bufs[LCM_BUF_POOL_NUM_CLASSES][LCM_BUF_POOL_MAX_FREE];
+    int num_free[LCM_BUF_POOL_NUM_CLASSES];
+    uint32_t free_size;                 // total size of the unused buffers
+} lcm_buf_pool_t;
+
+lcm_buf_pool_t * lcm_buf_pool_new(void);
+void lcm_buf_pool_destroy(lcm_buf_pool_t *pool);
+
+// returns a buffer of at least size bytes.  Its actual size is stored in
+// *capacity, and must be passed back to lcm_buf_pool_put().
+char * lcm_buf_pool_get(lcm_buf_pool_t *pool, uint32_t size,
+        uint32_t *capacity);
+void lcm_buf_pool_put(lcm_buf_pool_t *pool, char *buf, uint32_t capacity);
 
 /******************** message buffer **********************/
 typedef struct _lcm_buf {
@@ -149,6 +236,7 @@ typedef struct _lcm_buf {
     int   data_size;         // size of payload
     lcm_ringbuf_t *ringbuf;  // the ringbuffer used to allocate buf.  NULL if
                              // not allocated from ringbuf
+    lcm_buf_pool_t *pool;    // the pool used to allocate buf, or NULL
 
     int   packet_size;       // total bytes received
     int   buf_size;          // bytes allocated
@@ -171,51 +259,140 @@ lcm_buf_queue_t * lcm_buf_queue_new(void);
 lcm_buf_t * lcm_buf_dequeue(lcm_buf_queue_t * q);
 void lcm_buf_enqueue(lcm_buf_queue_t * q, lcm_buf_t * el);
 
-void lcm_buf_queue_free(lcm_buf_queue_t * q, lcm_ringbuf_t *ringbuf);
+void lcm_buf_queue_free(lcm_buf_queue_t * q);
 int lcm_buf_queue_is_empty(lcm_buf_queue_t * q);
 
-// allocate a lcm_buf from the ringbuf. If there is no more space in the ringbuf
-// it is replaced with a bigger one. In this case, the old ringbuffer will be
-// cleaned up when lcm_buf_free_data() is called;
+/******* Lock-free single-producer, single-consumer ring of message buffers *******/
+// At most one thread may push and at most one thread may pop at any time.
+// head and tail are free-running counters, masked to index into slots.
+typedef struct _lcm_buf_ring {
+    lcm_buf_t ** slots;
+    unsigned int capacity;
+    volatile gint head;      // next slot written by the producer
+    volatile gint tail;      // next slot read by the consumer
+} lcm_buf_ring_t;
+
+// capacity must be a power of two
+lcm_buf_ring_t * lcm_buf_ring_new(unsigned int capacity);
+
+// frees the ring and any buffers still in it
+void lcm_buf_ring_free(lcm_buf_ring_t * r);
+
+// returns 1 on success, 0 if the ring is full
+int lcm_buf_ring_push(lcm_buf_ring_t * r, lcm_buf_t * el);
+
+// returns NULL if the ring is empty
+lcm_buf_t * lcm_buf_ring_pop(lcm_buf_ring_t * r);
+
+// take an lcm_buf struct from inbufs_empty, allocating more structs if the
+// queue is empty.  No data is allocated for the buffer.
 lcm_buf_t *
-lcm_buf_allocate_data(lcm_buf_queue_t * inbufs_empty, lcm_ringbuf_t **ringbuf);
+lcm_buf_allocate(lcm_buf_queue_t * inbufs_empty);
+
+// allocate a lcm_buf from the ringbuf.  Returns NULL if the ringbuf has
+// reached its high watermark, in which case the packet should be dropped.
+lcm_buf_t *
+lcm_buf_allocate_data(lcm_buf_queue_t * inbufs_empty, lcm_ringbuf_t *ringbuf);
+
+// same as lcm_buf_allocate_data(), but only reserves data_size bytes on the
+// ringbuffer.  Used when the packet size is already known.
+lcm_buf_t *
+lcm_buf_allocate_data_size(lcm_buf_queue_t * inbufs_empty,
+        lcm_ringbuf_t *ringbuf, unsigned int data_size);
+
+void lcm_buf_free_data(lcm_buf_t *lcmb);
 
-void lcm_buf_free_data(lcm_buf_t *lcmb, lcm_ringbuf_t *ringbuf);
+/******************** receive ringbuffer options **********************/
+// Configuration of the receive ringbuffer, set with the ringbuf_* provider
+// URL options.  See lcm_ringbuf_new() for their meaning.
+typedef struct _lcm_ringbuf_params {
+    unsigned int slab_size;
+    unsigned int low_watermark;
+    unsigned int high_watermark;
+    int flags;
+} lcm_ringbuf_params_t;
+
+void lcm_ringbuf_params_init(lcm_ringbuf_params_t *params);
+
+// returns 1 if key is a ringbuffer option, 0 otherwise
+int lcm_ringbuf_params_parse(lcm_ringbuf_params_t *params, const char *key,
+        const char *value);
+
+lcm_ringbuf_t * lcm_ringbuf_params_create(const lcm_ringbuf_params_t *params);
 
 /******************** fragment buffer **********************/
+typedef struct _lcm_frag_sender lcm_frag_sender_t;
+
 typedef struct _lcm_frag_buf {
     char      channel[LCM_MAX_CHANNEL_NAME_LENGTH+1];
     struct    sockaddr_in from;
     char      *data;
     uint32_t  data_size;
+    lcm_buf_pool_t *pool;        // pool that data was taken from
+    uint32_t  data_capacity;     // allocated size of data
     uint16_t  fragments_remaining;
     uint32_t  msg_seqno;
     int64_t   last_packet_utime;
+
+    // bookkeeping for lcm_frag_buf_store
+    lcm_frag_sender_t *sender;
+    GList     lru_link;          // link in the store's LRU list
+    GList     sender_link;       // link in the sender's LRU list
 } lcm_frag_buf_t;
 
-lcm_frag_buf_t * lcm_frag_buf_new(struct sockaddr_in from, const char *channel,
+lcm_frag_buf_t * lcm_frag_buf_new(lcm_buf_pool_t *pool,
+        struct sockaddr_in from, const char *channel,
         uint32_t msg_seqno, uint32_t data_size, uint16_t nfragments,
         int64_t first_packet_utime);
 void lcm_frag_buf_destroy(lcm_frag_buf_t *fbuf);
 
+// hands the reassembled message over to lcmb
+void lcm_frag_buf_transfer(lcm_frag_buf_t *fbuf, lcm_buf_t *lcmb);
+
 
 /******************** fragment buffer store **********************/
+// Fragment buffers are keyed on the sender and the message sequence number, so
+// that a sender can interleave the fragments of several messages.  When a
+// limit is reached, the least recently updated fragment buffer (of the sender,
+// or overall) is evicted.
 typedef struct _lcm_frag_buf_store {
     uint32_t total_size;
     uint32_t max_total_size;
     uint32_t max_n_frag_bufs;
-    GHashTable *frag_bufs;
+    uint32_t max_n_frag_bufs_per_sender;
+    GHashTable *frag_bufs;       // keyed on (from, msg_seqno)
+    GHashTable *senders;         // lcm_frag_sender_t, keyed on from
+    GQueue lru;                  // least recently updated first
+    uint64_t num_evicted;        // incomplete messages evicted to make room
 } lcm_frag_buf_store;
 
 lcm_frag_buf_store * lcm_frag_buf_store_new(uint32_t max_total_size,
-        uint32_t max_n_frag_bufs);
+        uint32_t max_n_frag_bufs, uint32_t max_n_frag_bufs_per_sender);
 void lcm_frag_buf_store_destroy(lcm_frag_buf_store * store);
+
+// finds the fragment buffer of message msg_seqno from the sender, and marks
+// it as the most recently updated.
 lcm_frag_buf_t * lcm_frag_buf_store_lookup(lcm_frag_buf_store * store,
-        struct sockaddr* key);
+        struct sockaddr* from, uint32_t msg_seqno);
 
 void lcm_frag_buf_store_remove(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf);
 void lcm_frag_buf_store_add(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf);
 
+#ifdef LCM_RECV_FRAGMENTS_IN_PLACE
+// If the next datagram waiting on fd is a fragment, other than the first, of
+// a message in the store, receives it with its payload placed directly at
+// its offset in the fragment buffer.  This saves copying the payload out of
+// a receive buffer.  The sender and receive time are stored in lcmb, and the
+// fragment buffer in *fbuf.  *fbuf is set to NULL if the fragment is invalid,
+// in which case the fragment buffer is discarded.  The socket's drop count is
+// stored in *kernel_drops, as with lcm_recv_control_parse().
+//
+// Returns the size of the datagram, 0 if the datagram was left on the socket,
+// or -1 on error.
+int lcm_frag_buf_store_recv(lcm_frag_buf_store *store, SOCKET fd,
+        lcm_buf_t *lcmb, lcm_frag_buf_t **fbuf, uint32_t *kernel_drops);
+#endif
+
 
 /************************* Linux Specific Functions *******************/
 #ifdef __linux__
@@ -23,6 +23,7 @@
 
 // flags for emit_c_array_loops_start
 #define FLAG_EMIT_MALLOCS 1
+#define FLAG_EMIT_ARENA_ALLOCS 4
 
 // flags for emit_c_array_loops_end
 #define FLAG_EMIT_FREES   2
@@ -78,6 +79,7 @@ void setup_c_options(getopt_t *gopt)
     getopt_add_string (gopt, 0, "cinclude",   "",       "Generated #include lines reference this folder");
     getopt_add_bool   (gopt, 0, "c-no-pubsub",   0,     "Do not generate _publish and _subscribe functions");
     getopt_add_bool   (gopt, 0, "c-typeinfo",   0,      "Generate typeinfo functions for each type");
+    getopt_add_bool   (gopt, 0, "c-arena",      0,      "Generate _decode_arena functions that allocate from an lcm_arena_t");
 }
 
 /** Emit output that is common to every header file **/
@@ -328,6 +330,19 @@ static void emit_header_prototypes(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
     emit(0, " */");
     emit(0,"int %s_decode_cleanup(%s *p);", tn_, tn_);
     emit(0, "");
+    if (getopt_get_bool(lcmgen->gopt, "c-arena")) {
+        emit(0, "/**");
+        emit(0, " * Decode a message of type %s from binary form, allocating its strings", tn_);
+        emit(0, " * and variable-length arrays from @p arena.  Do not pass the decoded");
+        emit(0, " * message to %s_decode_cleanup(); it is released along with the", tn_);
+        emit(0, " * arena, e.g. by lcm_arena_reset().");
+        emit(0, " *");
+        emit(0, " * @return The number of bytes decoded, or <0 if an error occured or");
+        emit(0, " * @p arena ran out of space.");
+        emit(0, " */");
+        emit(0,"int %s_decode_arena(const void *buf, int offset, int maxlen, %s *msg, lcm_arena_t *arena);", tn_, tn_);
+        emit(0, "");
+    }
     emit(0, "/**");
     emit(0, " * Check how many bytes are required to encode a message of type %s", tn_);
     emit(0, " */");
@@ -346,6 +361,8 @@ static void emit_header_prototypes(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
     emit(0,"int     __%s_encode_array(void *buf, int offset, int maxlen, const %s *p, int elements);", tn_, tn_);
     emit(0,"int     __%s_decode_array(const void *buf, int offset, int maxlen, %s *p, int elements);", tn_, tn_);
     emit(0,"int     __%s_decode_array_cleanup(%s *p, int elements);", tn_, tn_);
+    if (getopt_get_bool(lcmgen->gopt, "c-arena"))
+        emit(0,"int     __%s_decode_array_arena(const void *buf, int offset, int maxlen, %s *p, int elements, lcm_arena_t *arena);", tn_, tn_);
     emit(0,"int     __%s_encoded_array_size(const %s *p, int elements);", tn_, tn_);
     emit(0,"int     __%s_clone_array(const %s *p, %s *q, int elements);", tn_, tn_, tn_);
     emit(0,"");
@@ -434,6 +451,17 @@ static char *make_array_size(lcm_member_t *lm, const char *n, int dim)
     return NULL;
 }
 
+// A zero-length array may legitimately get a NULL pointer from the arena.
+static void emit_c_arena_alloc_check(FILE *f, int indent, lcm_member_t *lm, const char *n, int dim)
+{
+    lcm_dimension_t *ld = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, dim);
+    if (ld->mode == LCM_CONST)
+        emit(indent, "if (!%s) return -1;", make_accessor(lm, n, dim));
+    else
+        emit(indent, "if (%s && !%s) return -1;",
+             make_array_size(lm, n, dim), make_accessor(lm, n, dim));
+}
+
 static void emit_c_array_loops_start(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, const char *n, int flags)
 {
     if (g_ptr_array_size(lm->dimensions) == 0)
@@ -442,20 +470,31 @@ static void emit_c_array_loops_start(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, c
     for (unsigned int i = 0; i < g_ptr_array_size(lm->dimensions) - 1; i++) {
         char var = 'a' + i;
 
-        if (flags & FLAG_EMIT_MALLOCS) {
+        if (flags & (FLAG_EMIT_MALLOCS | FLAG_EMIT_ARENA_ALLOCS)) {
             char stars[1000];
             for (unsigned int s = 0; s < g_ptr_array_size(lm->dimensions) - 1 - i; s++) {
                 stars[s] = '*';
                 stars[s+1] = 0;
             }
 
-            emit(2+i, "%s = (%s%s*) lcm_malloc(sizeof(%s%s) * %s);",
-                 make_accessor(lm, n, i),
-                 map_type_name(lm->type->lctypename),
-                 stars,
-                 map_type_name(lm->type->lctypename),
-                 stars,
-                 make_array_size(lm, n, i));
+            if (flags & FLAG_EMIT_MALLOCS) {
+                emit(2+i, "%s = (%s%s*) lcm_malloc(sizeof(%s%s) * %s);",
+                     make_accessor(lm, n, i),
+                     map_type_name(lm->type->lctypename),
+                     stars,
+                     map_type_name(lm->type->lctypename),
+                     stars,
+                     make_array_size(lm, n, i));
+            } else {
+                emit(2+i, "%s = (%s%s*) lcm_arena_alloc(arena, sizeof(%s%s) * %s);",
+                     make_accessor(lm, n, i),
+                     map_type_name(lm->type->lctypename),
+                     stars,
+                     map_type_name(lm->type->lctypename),
+                     stars,
+                     make_array_size(lm, n, i));
+                emit_c_arena_alloc_check(f, 2+i, lm, n, i);
+            }
         }
 
         emit(2+i, "{ int %c;", var);
@@ -468,6 +507,14 @@ static void emit_c_array_loops_start(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, c
              map_type_name(lm->type->lctypename),
              map_type_name(lm->type->lctypename),
              make_array_size(lm, n, g_ptr_array_size(lm->dimensions) - 1));
+    } else if (flags & FLAG_EMIT_ARENA_ALLOCS) {
+        int indent = 2 + g_ptr_array_size(lm->dimensions) - 1;
+        emit(indent, "%s = (%s*) lcm_arena_alloc(arena, sizeof(%s) * %s);",
+             make_accessor(lm, n, g_ptr_array_size(lm->dimensions) - 1),
+             map_type_name(lm->type->lctypename),
+             map_type_name(lm->type->lctypename),
+             make_array_size(lm, n, g_ptr_array_size(lm->dimensions) - 1));
+        emit_c_arena_alloc_check(f, indent, lm, n, g_ptr_array_size(lm->dimensions) - 1);
     }
 }
 
@@ -630,6 +677,61 @@ static void emit_c_decode(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     emit(0,"");
 }
 
+static void emit_c_decode_array_arena(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    char *tn = ls->structname->lctypename;
+    char *tn_ = dots_to_underscores(tn);
+
+    emit(0,"int __%s_decode_array_arena(const void *buf, int offset, int maxlen, %s *p, int elements, lcm_arena_t *arena)", tn_, tn_);
+    emit(0,"{");
+    emit(1,    "int pos = 0, thislen, element;");
+    emit(0,"");
+    emit(1,    "for (element = 0; element < elements; element++) {");
+    emit(0,"");
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+
+        emit_c_array_loops_start(lcm, f, lm, "p", lcm_is_constant_size_array(lm) ? FLAG_NONE : FLAG_EMIT_ARENA_ALLOCS);
+
+        int indent = 2+imax(0, g_ptr_array_size(lm->dimensions) - 1);
+        emit(indent, "thislen = __%s_decode_array_arena(buf, offset + pos, maxlen - pos, %s, %s, arena);",
+             dots_to_underscores (lm->type->lctypename),
+             make_accessor(lm, "p", g_ptr_array_size(lm->dimensions) - 1),
+             make_array_size(lm, "p", g_ptr_array_size(lm->dimensions) - 1));
+        emit(indent, "if (thislen < 0) return thislen; else pos += thislen;");
+
+        emit_c_array_loops_end(lcm, f, lm, "p", FLAG_NONE);
+        emit(0,"");
+    }
+    emit(1,   "}");
+    emit(1, "return pos;");
+    emit(0,"}");
+    emit(0,"");
+}
+
+static void emit_c_decode_arena(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    char *tn = ls->structname->lctypename;
+    char *tn_ = dots_to_underscores(tn);
+
+    emit(0,"int %s_decode_arena(const void *buf, int offset, int maxlen, %s *p, lcm_arena_t *arena)", tn_, tn_);
+    emit(0,"{");
+    emit(1,    "int pos = 0, thislen;");
+    emit(1,    "int64_t hash = __%s_get_hash();", tn_);
+    emit(0,"");
+    emit(1,    "int64_t this_hash;");
+    emit(1,    "thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);");
+    emit(1,    "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(1,    "if (this_hash != hash) return -1;");
+    emit(0,"");
+    emit(1,    "thislen = __%s_decode_array_arena(buf, offset + pos, maxlen - pos, p, 1, arena);", tn_);
+    emit(1,    "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(0,"");
+    emit(1, "return pos;");
+    emit(0,"}");
+    emit(0,"");
+}
+
 static void emit_c_decode_cleanup(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 {
     char *tn = ls->structname->lctypename;
@@ -869,17 +971,15 @@ static void emit_c_struct_publish(lcmgen_t *lcm, FILE *f, lcm_struct_t *lr)
     fprintf(f,
             "int %s_publish(lcm_t *lc, const char *channel, const %s *p)\n"
             "{\n"
+            "      if (!lcm_channel_has_subscribers (lc, channel))\n"
+            "          return 0;\n"
             "      int max_data_size = %s_encoded_size (p);\n"
-            "      uint8_t *buf = (uint8_t*) malloc (max_data_size);\n"
+            "      uint8_t *buf = (uint8_t*) lcm_get_encode_buffer (max_data_size);\n"
             "      if (!buf) return -1;\n"
             "      int data_size = %s_encode (buf, 0, max_data_size, p);\n"
-            "      if (data_size < 0) {\n"
-            "          free (buf);\n"
+            "      if (data_size < 0)\n"
             "          return data_size;\n"
-            "      }\n"
-            "      int status = lcm_publish (lc, channel, buf, data_size);\n"
-            "      free (buf);\n"
-            "      return status;\n"
+            "      return lcm_publish (lc, channel, buf, data_size);\n"
             "}\n\n", tn_, tn_, tn_, tn_);
 }
 
@@ -1061,6 +1161,14 @@ int emit_enum(lcmgen_t *lcmgen, lcm_enum_t *le)
         emit(0, "}");
         emit(0, "");
 
+        if (getopt_get_bool(lcmgen->gopt, "c-arena")) {
+            emit(0, "static inline int __%s_decode_array_arena(const void *_buf, int offset, int maxlen, %s *p, int elements, lcm_arena_t *arena)", tn_, tn_);
+            emit(0, "{");
+            emit(1,    "return __%s_decode_array(_buf, offset, maxlen, p, elements);", tn_);
+            emit(0, "}");
+            emit(0, "");
+        }
+
         emit(0, "static inline int __%s_clone_array(const %s *p, %s *q, int elements)", tn_, tn_, tn_);
         emit(0, "{");
         emit(1,    "memcpy(q, p, elements * sizeof(%s));", tn_);
@@ -1197,6 +1305,11 @@ int emit_struct(lcmgen_t *lcmgen, lcm_struct_t *lr)
         emit_c_decode(lcmgen, f, lr);
         emit_c_decode_cleanup(lcmgen, f, lr);
 
+        if(getopt_get_bool(lcmgen->gopt, "c-arena")) {
+            emit_c_decode_array_arena(lcmgen, f, lr);
+            emit_c_decode_arena(lcmgen, f, lr);
+        }
+
         emit_c_clone_array(lcmgen, f, lr);
         emit_c_copy(lcmgen, f, lr);
         emit_c_destroy(lcmgen, f, lr);
@@ -126,11 +126,71 @@ map_type_name(const char *t)
     return dots_to_double_colons (t);
 }
 
+// encoded size of a primitive type other than string
+static int primitive_encoded_size(const char *t)
+{
+    if (!strcmp(t, "int8_t") || !strcmp(t, "boolean") || !strcmp(t, "byte"))
+        return 1;
+    if (!strcmp(t, "int16_t"))
+        return 2;
+    if (!strcmp(t, "int32_t") || !strcmp(t, "float"))
+        return 4;
+    return 8;
+}
+
+// Returns the encoded size (without the fingerprint) of a type that has no
+// strings or variable-length arrays, or -1.  Types declared outside of this
+// run of lcm-gen are treated as variable-length.
+static int fixed_encoded_size(lcmgen_t *lcmgen, const char *lctypename, int depth)
+{
+    lcm_struct_t *ls = NULL;
+    for (unsigned int i = 0; i < g_ptr_array_size(lcmgen->structs); i++) {
+        lcm_struct_t *s = (lcm_struct_t *) g_ptr_array_index(lcmgen->structs, i);
+        if (!strcmp(s->structname->lctypename, lctypename))
+            ls = s;
+    }
+    if (!ls || depth > 100)
+        return -1;
+
+    int64_t size = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        const char *tn = lm->type->lctypename;
+        if (!lcm_is_constant_size_array(lm) || !strcmp(tn, "string"))
+            return -1;
+
+        int64_t elem_size = lcm_is_primitive_type(tn) ?
+            primitive_encoded_size(tn) : fixed_encoded_size(lcmgen, tn, depth + 1);
+        if (elem_size < 0)
+            return -1;
+        for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+            elem_size *= strtol(dim->size, NULL, 0);
+            if (elem_size > INT32_MAX)
+                return -1;
+        }
+        size += elem_size;
+        if (size > INT32_MAX)
+            return -1;
+    }
+    return (int) size;
+}
+
+// The encoded size of a type whose encode and decode functions are
+// specialized for a fixed layout, or -1.
+static int cpp_fixed_size(lcmgen_t *lcmgen, lcm_struct_t *ls)
+{
+    if (!g_ptr_array_size(ls->members))
+        return -1;
+    return fixed_encoded_size(lcmgen, ls->structname->lctypename, 0);
+}
+
 void setup_cpp_options(getopt_t *gopt)
 {
     getopt_add_string (gopt, 0, "cpp-std",    "c++98",      "C++ standard(c++98, c++11)");
     getopt_add_string (gopt, 0, "cpp-hpath",    ".",      "Location for .hpp files");
     getopt_add_string (gopt, 0, "cpp-include",   "",       "Generated #include lines reference this folder");
+    getopt_add_bool   (gopt, 0, "cpp-views",     0,        "Also generate read-only view classes that decode fields on access");
 }
 
 static void emit_auto_generated_warning(FILE *f)
@@ -198,6 +258,8 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
     emit_auto_generated_warning(f);
 
     fprintf(f, "#include <lcm/lcm_coretypes.h>\n");
+    if (getopt_get_bool(lcmgen->gopt, "cpp-views"))
+        fprintf(f, "#include <lcm/lcm_coretypes_view.hpp>\n");
     fprintf(f, "\n");
     fprintf(f, "#ifndef __%s_hpp__\n", tn_);
     fprintf(f, "#define __%s_hpp__\n", tn_);
@@ -369,6 +431,13 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
     emit(2, "inline int _getEncodedSizeNoHash() const;");
     emit(2, "inline int _decodeNoHash(const void *buf, int offset, int maxlen);");
     emit(2, "inline static int64_t _computeHash(const __lcm_hash_ptr *p);");
+    int fixed_size = cpp_fixed_size(lcmgen, ls);
+    if (fixed_size >= 0) {
+        if (!strcmp(getopt_get_string(lcmgen->gopt, "cpp-std"), "c++11"))
+            emit(2, "static constexpr int _encodedSizeNoHash = %d;", fixed_size);
+        else
+            emit(2, "static const int _encodedSizeNoHash = %d;", fixed_size);
+    }
     emit(0, "};");
     emit(0, "");
 
@@ -525,6 +594,69 @@ static void _encode_recursive(lcmgen_t* lcm, FILE* f, lcm_member_t* lm, int dept
     emit(indent, "}");
 }
 
+// Straight-line encode or decode ("op") of a type with a fixed layout.  The
+// caller has already checked that the whole message fits, so the offset of
+// every field is known and no further checks are needed.
+static void emit_fixed_members(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls, const char *op)
+{
+    int pos = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        const char *tn = lm->type->lctypename;
+        int ndim = g_ptr_array_size(lm->dimensions);
+
+        int count = 1;
+        for (int d = 0; d < ndim; d++) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+            count *= strtol(dim->size, NULL, 0);
+        }
+
+        if (lcm_is_primitive_type(tn)) {
+            // multidimensional arrays are contiguous, so one call covers them
+            char *off = pos ? g_strdup_printf("offset + %d", pos) : g_strdup("offset");
+            char *len = pos ? g_strdup_printf("maxlen - %d", pos) : g_strdup("maxlen");
+            emit_start(1, "__%s_%s_array(buf, %s, %s, &this->%s", tn, op, off, len,
+                    lm->membername);
+            for (int d = 0; d < ndim; d++)
+                emit_continue("[0]");
+            emit_end(", %d);", count);
+            g_free(len);
+            g_free(off);
+            pos += primitive_encoded_size(tn) * count;
+            continue;
+        }
+
+        int elem_size = fixed_encoded_size(lcm, tn, 0);
+        if (ndim == 0) {
+            char *off = pos ? g_strdup_printf("offset + %d", pos) : g_strdup("offset");
+            char *len = pos ? g_strdup_printf("maxlen - %d", pos) : g_strdup("maxlen");
+            emit(1, "this->%s._%sNoHash(buf, %s, %s);", lm->membername, op, off, len);
+            g_free(len);
+            g_free(off);
+        } else {
+            char *index = g_strdup("a0");
+            for (int d = 0; d < ndim; d++) {
+                lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+                emit(1 + d, "for (int a%d = 0; a%d < %s; a%d++) {", d, d, dim->size, d);
+                if (d > 0) {
+                    char *next = g_strdup_printf("(%s) * %s + a%d", index, dim->size, d);
+                    g_free(index);
+                    index = next;
+                }
+            }
+            emit(1 + ndim, "int elem_pos = %d + (%s) * %d;", pos, index, elem_size);
+            emit_start(1 + ndim, "this->%s", lm->membername);
+            for (int d = 0; d < ndim; d++)
+                emit_continue("[a%d]", d);
+            emit_end("._%sNoHash(buf, offset + elem_pos, maxlen - elem_pos);", op);
+            for (int d = ndim - 1; d >= 0; d--)
+                emit(1 + d, "}");
+            g_free(index);
+        }
+        pos += elem_size * count;
+    }
+}
+
 static void emit_encode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 {
     const char* sn = ls->structname->shortname;
@@ -538,6 +670,16 @@ static void emit_encode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     }
     emit(0, "int %s::_encodeNoHash(void *buf, int offset, int maxlen) const", sn);
     emit(0, "{");
+    if (cpp_fixed_size(lcm, ls) >= 0) {
+        emit(1, "if(maxlen < _encodedSizeNoHash) return -1;");
+        emit(0, "");
+        emit_fixed_members(lcm, f, ls, "encode");
+        emit(0, "");
+        emit(1, "return _encodedSizeNoHash;");
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
     emit(1,     "int pos = 0, tlen;");
     emit(0, "");
     for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
@@ -593,6 +735,12 @@ static void emit_encoded_size_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
         emit(0,"");
         return;
     }
+    if (cpp_fixed_size(lcm, ls) >= 0) {
+        emit(1, "return _encodedSizeNoHash;");
+        emit(0,"}");
+        emit(0,"");
+        return;
+    }
     emit(1,     "int enc_size = 0;");
     for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
         lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
@@ -646,11 +794,13 @@ static void _decode_recursive(lcmgen_t* lcm, FILE* f, lcm_member_t* lm, int dept
 
         int decode_indent = 1 + depth;
         if(!lcm_is_constant_size_array(lm)) {
-            emit(1 + depth, "if(%s%s) {", dim_size_prefix(dim->size), dim->size);
-            emit_start(2 + depth, "this->%s", lm->membername);
+            // always resize, so that a message decoded into a reused
+            // instance does not keep the elements of the previous one
+            emit_start(1 + depth, "this->%s", lm->membername);
             for(int i=0; i<depth; i++)
                 emit_continue("[a%d]", i);
             emit_end(".resize(%s%s);", dim_size_prefix(dim->size), dim->size);
+            emit(1 + depth, "if(%s%s) {", dim_size_prefix(dim->size), dim->size);
             decode_indent++;
         }
 
@@ -713,6 +863,16 @@ static void emit_decode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     }
     emit(0, "int %s::_decodeNoHash(const void *buf, int offset, int maxlen)", sn);
     emit(0, "{");
+    if (cpp_fixed_size(lcm, ls) >= 0) {
+        emit(1, "if(maxlen < _encodedSizeNoHash) return -1;");
+        emit(0, "");
+        emit_fixed_members(lcm, f, ls, "decode");
+        emit(0, "");
+        emit(1, "return _encodedSizeNoHash;");
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
     emit(1,     "int pos = 0, tlen;");
     emit(0, "");
     for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
@@ -741,6 +901,317 @@ static void emit_decode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     emit(0, "");
 }
 
+/** Emit view class (--cpp-views) **/
+
+static int view_is_primitive_array(lcm_member_t *lm)
+{
+    return g_ptr_array_size(lm->dimensions) > 0 &&
+        lcm_is_primitive_type(lm->type->lctypename) &&
+        strcmp(lm->type->lctypename, "string");
+}
+
+static int view_is_struct(lcm_member_t *lm)
+{
+    return !lcm_is_primitive_type(lm->type->lctypename);
+}
+
+// The size of a dimension, as an expression valid inside the view class.
+// Variable dimensions are read from the view's accessor for the size field.
+static char *view_dim_size(lcm_member_t *lm, int d)
+{
+    lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, d);
+    if (is_dim_size_fixed(dim->size))
+        return g_strdup(dim->size);
+    return g_strdup_printf("(int) this->%s()", dim->size);
+}
+
+// The number of elements in dimensions [0, ndim) of a member, for use once
+// the view has been validated.
+static char *view_count(lcm_member_t *lm, int ndim)
+{
+    char *count = g_strdup("1");
+    for (int d = 0; d < ndim; d++) {
+        char *size = view_dim_size(lm, d);
+        char *next = d == 0 ? g_strdup(size) :
+            g_strdup_printf("%s * %s", count, size);
+        g_free(size);
+        g_free(count);
+        count = next;
+    }
+    return count;
+}
+
+// Like view_count(), but checks each dimension and evaluates to -1 if any
+// size is invalid.
+static char *view_checked_count(lcm_member_t *lm)
+{
+    char *count = g_strdup("1");
+    for (int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+        lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, d);
+        char *next = g_strdup_printf("lcm::_viewCount(%s, %s%s%s)", count,
+                dim_size_prefix(dim->size), dim->size,
+                is_dim_size_fixed(dim->size) ? "" : "()");
+        g_free(count);
+        count = next;
+    }
+    return count;
+}
+
+// The row-major index of element [a0]...[a(nidx-1)] of a member.
+static char *view_flat_index(lcm_member_t *lm, int nidx)
+{
+    char *index = g_strdup("a0");
+    for (int d = 1; d < nidx; d++) {
+        char *size = view_dim_size(lm, d);
+        char *next = g_strdup_printf("(int64_t) (%s) * %s + a%d", index, size, d);
+        g_free(size);
+        g_free(index);
+        index = next;
+    }
+    return index;
+}
+
+// "int a0, int a1, ..." for the first nidx dimensions of a member
+static void view_emit_index_params(FILE *f, int nidx)
+{
+    for (int d = 0; d < nidx; d++)
+        emit_continue("%sint a%d", d ? ", " : "", d);
+}
+
+static void emit_view_accessor(lcmgen_t *lcm, FILE *f, lcm_member_t *lm)
+{
+    const char *mn = lm->membername;
+    const char *tn = lm->type->lctypename;
+    int ndim = g_ptr_array_size(lm->dimensions);
+
+    emit_comment(f, 2, lm->comment);
+    if (view_is_primitive_array(lm)) {
+        char *mapped_typename = map_type_name(tn);
+        char *count = view_count(lm, ndim);
+        emit(2, "lcm::ArrayView<%s> %s() const", mapped_typename, mn);
+        emit(2, "{");
+        emit(3,     "return lcm::ArrayView<%s>(this->_buf + this->_off_%s, %s);",
+                mapped_typename, mn, count);
+        emit(2, "}");
+        if (ndim > 1) {
+            // one row of the innermost dimension
+            char *index = view_flat_index(lm, ndim - 1);
+            char *row_size = view_dim_size(lm, ndim - 1);
+            emit_start(2, "lcm::ArrayView<%s> %s(", mapped_typename, mn);
+            view_emit_index_params(f, ndim - 1);
+            emit_end(") const");
+            emit(2, "{");
+            emit(3,     "return lcm::ArrayView<%s>(this->_buf + this->_off_%s +",
+                    mapped_typename, mn);
+            emit(5,             "(size_t) (%s) * %s * %d, %s);", index, row_size,
+                    primitive_encoded_size(tn), row_size);
+            emit(2, "}");
+            g_free(row_size);
+            g_free(index);
+        }
+        g_free(count);
+        free(mapped_typename);
+    } else if (ndim > 0) {
+        char *index = view_flat_index(lm, ndim);
+        char *elem_typename = NULL;
+        if (view_is_struct(lm)) {
+            char *tn_cpp = dots_to_double_colons(tn);
+            elem_typename = g_strdup_printf("%sView", tn_cpp);
+            free(tn_cpp);
+            emit_start(2, "%s %s(", elem_typename, mn);
+        } else {
+            emit_start(2, "const char *%s(", mn);
+        }
+        view_emit_index_params(f, ndim);
+        emit_end(") const");
+        emit(2, "{");
+        emit(3,     "int64_t __index = %s;", index);
+        emit(3,     "int pos = this->_off_%s;", mn);
+        if (elem_typename) {
+            emit(3, "%s __elem;", elem_typename);
+            emit(3, "for (int64_t __i = 0; __i <= __index; __i++)");
+            emit(4,     "pos += __elem._decodeNoHash(this->_buf, pos, this->_size - pos);");
+            emit(3, "return __elem;");
+        } else {
+            emit(3, "for (int64_t __i = 0; __i < __index; __i++)");
+            emit(4,     "pos += 4 + lcm::ViewDecoder<int32_t>::get(this->_buf + pos);");
+            emit(3, "return (const char*) this->_buf + pos + 4;");
+        }
+        emit(2, "}");
+        g_free(elem_typename);
+        g_free(index);
+    } else if (view_is_struct(lm)) {
+        char *tn_cpp = dots_to_double_colons(tn);
+        emit(2, "const %sView& %s() const { return this->_view_%s; }", tn_cpp, mn, mn);
+        free(tn_cpp);
+    } else if (!strcmp(tn, "string")) {
+        emit(2, "const char *%s() const { return (const char*) this->_buf + this->_off_%s + 4; }",
+                mn, mn);
+    } else {
+        char *mapped_typename = map_type_name(tn);
+        emit(2, "%s %s() const { return lcm::ViewDecoder<%s>::get(this->_buf + this->_off_%s); }",
+                mapped_typename, mn, mapped_typename, mn);
+        free(mapped_typename);
+    }
+}
+
+static void emit_view_class(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+    int nmembers = g_ptr_array_size(ls->members);
+
+    emit(0, "/**");
+    emit(0, " * Read-only view of an encoded %s.  Fields are decoded from the encoded", sn);
+    emit(0, " * message each time they are accessed, so the buffer passed to decode() must");
+    emit(0, " * outlive the view.  Primitive arrays are returned as lcm::ArrayView.  Looking");
+    emit(0, " * up an element of an array of strings or structs walks the array from its");
+    emit(0, " * start.");
+    emit(0, " */");
+    emit(0, "class %sView", sn);
+    emit(0, "{");
+    emit(1, "public:");
+    emit_start(2, "%sView() : _buf(NULL), _size(0)", sn);
+    for (unsigned int m = 0; m < nmembers; m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (!view_is_struct(lm) || g_ptr_array_size(lm->dimensions))
+            emit_continue(", _off_%s(0)", lm->membername);
+    }
+    emit_end(" {}");
+    emit(0, "");
+    emit(2, "/**");
+    emit(2, " * Check an encoded message and point this view at it.  No fields are");
+    emit(2, " * decoded.");
+    emit(2, " *");
+    emit(2, " * @param buf The buffer containing the encoded message.");
+    emit(2, " * @param offset The byte offset into @p buf where the encoded message starts.");
+    emit(2, " * @param maxlen The maximum number of bytes to read.");
+    emit(2, " * @return The number of bytes in the encoded message, or <0 if an error occured.");
+    emit(2, " */");
+    emit(2, "inline int decode(const void *buf, int offset, int maxlen);");
+    emit(0, "");
+    emit(2, "/**");
+    emit(2, " * Decode every field of the viewed message into @p msg.");
+    emit(2, " *");
+    emit(2, " * @return The number of bytes decoded, or <0 if an error occured.");
+    emit(2, " */");
+    emit(2, "inline int copyTo(%s *msg) const;", sn);
+    emit(0, "");
+    emit(2, "inline static int64_t getHash() { return %s::getHash(); }", sn);
+    emit(2, "inline static const char* getTypeName() { return %s::getTypeName(); }", sn);
+
+    for (unsigned int m = 0; m < nmembers; m++) {
+        emit(0, "");
+        emit_view_accessor(lcm, f, (lcm_member_t *) g_ptr_array_index(ls->members, m));
+    }
+
+    emit(0, "");
+    emit(2, "// LCM support functions. Users should not call these");
+    emit(2, "inline int _decodeNoHash(const void *buf, int offset, int maxlen);");
+    emit(0, "");
+    emit(1, "private:");
+    emit(2, "const uint8_t *_buf;");
+    emit(2, "int _size;");
+    for (unsigned int m = 0; m < nmembers; m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (view_is_struct(lm) && !g_ptr_array_size(lm->dimensions)) {
+            char *tn_cpp = dots_to_double_colons(lm->type->lctypename);
+            emit(2, "%sView _view_%s;", tn_cpp, lm->membername);
+            free(tn_cpp);
+        } else {
+            emit(2, "int _off_%s;", lm->membername);
+        }
+    }
+    emit(0, "};");
+    emit(0, "");
+}
+
+static void emit_view_methods(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+    int nmembers = g_ptr_array_size(ls->members);
+
+    emit(0, "int %sView::decode(const void *buf, int offset, int maxlen)", sn);
+    emit(0, "{");
+    emit(1,     "int pos = 0, thislen;");
+    emit(0, "");
+    emit(1,     "int64_t msg_hash;");
+    emit(1,     "thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &msg_hash, 1);");
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(1,     "if (msg_hash != getHash()) return -1;");
+    emit(0, "");
+    emit(1,     "thislen = this->_decodeNoHash(buf, offset + pos, maxlen - pos);");
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(0, "");
+    emit(1,  "return pos;");
+    emit(0, "}");
+    emit(0, "");
+
+    emit(0, "int %sView::copyTo(%s *msg) const", sn, sn);
+    emit(0, "{");
+    emit(1,     "return msg->_decodeNoHash(this->_buf, 0, this->_size);");
+    emit(0, "}");
+    emit(0, "");
+
+    int has_struct = 0;
+    for (unsigned int m = 0; m < nmembers; m++)
+        has_struct |= view_is_struct((lcm_member_t *) g_ptr_array_index(ls->members, m));
+
+    emit(0, "int %sView::_decodeNoHash(const void *buf, int offset, int maxlen)", sn);
+    emit(0, "{");
+    emit(1,     "int pos = 0%s;", has_struct ? ", tlen" : "");
+    emit(1,     "this->_buf = (const uint8_t*) buf + offset;");
+    emit(0, "");
+    for (unsigned int m = 0; m < nmembers; m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        const char *mn = lm->membername;
+        const char *tn = lm->type->lctypename;
+        int ndim = g_ptr_array_size(lm->dimensions);
+
+        if (view_is_struct(lm) && !ndim) {
+            emit(1, "tlen = this->_view_%s._decodeNoHash(buf, offset + pos, maxlen - pos);", mn);
+            emit(1, "if(tlen < 0) return tlen; else pos += tlen;");
+        } else if (!ndim && !strcmp(tn, "string")) {
+            emit(1, "this->_off_%s = pos;", mn);
+            emit(1, "pos = lcm::_viewSkipString(this->_buf, pos, maxlen);");
+            emit(1, "if(pos < 0) return -1;");
+        } else if (!ndim || view_is_primitive_array(lm)) {
+            char *count = ndim ? view_checked_count(lm) : g_strdup("1");
+            emit(1, "this->_off_%s = pos;", mn);
+            emit(1, "pos = lcm::_viewSkip(pos, maxlen, %s, %d);", count,
+                    primitive_encoded_size(tn));
+            emit(1, "if(pos < 0) return -1;");
+            g_free(count);
+        } else {
+            // arrays of strings or structs have to be walked
+            char *count = view_checked_count(lm);
+            emit(1, "this->_off_%s = pos;", mn);
+            emit(1, "{");
+            emit(2,     "int64_t __n = %s;", count);
+            emit(2,     "if(__n < 0) return -1;");
+            if (view_is_struct(lm)) {
+                char *tn_cpp = dots_to_double_colons(tn);
+                emit(2, "%sView __elem;", tn_cpp);
+                emit(2, "for (int64_t __i = 0; __i < __n; __i++) {");
+                emit(3,     "tlen = __elem._decodeNoHash(buf, offset + pos, maxlen - pos);");
+                emit(3,     "if(tlen < 0) return tlen; else pos += tlen;");
+                free(tn_cpp);
+            } else {
+                emit(2, "for (int64_t __i = 0; __i < __n; __i++) {");
+                emit(3,     "pos = lcm::_viewSkipString(this->_buf, pos, maxlen);");
+                emit(3,     "if(pos < 0) return -1;");
+            }
+            emit(2, "}");
+            emit(1, "}");
+            g_free(count);
+        }
+        emit(0, "");
+    }
+    emit(1, "this->_size = pos;");
+    emit(1, "return pos;");
+    emit(0, "}");
+    emit(0, "");
+}
+
 int emit_cpp(lcmgen_t *lcmgen)
 {
     // iterate through all defined message types
@@ -780,6 +1251,11 @@ int emit_cpp(lcmgen_t *lcmgen)
             emit_encoded_size_nohash(lcmgen, f, lr);
             emit_compute_hash(lcmgen, f, lr);
 
+            if (getopt_get_bool(lcmgen->gopt, "cpp-views")) {
+                emit_view_class(lcmgen, f, lr);
+                emit_view_methods(lcmgen, f, lr);
+            }
+
             emit_package_namespace_close(lcmgen, f, lr);
             emit(0, "#endif");
 
@@ -0,0 +1,206 @@
+// Measures the throughput of encoding and decoding large primitive arrays
+// with the helpers in lcm_coretypes.h, next to the portable byte-at-a-time
+// loops they replace.  Build with -DLCM_NO_SIMD to measure the portable code
+// only.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <lcm/lcm_coretypes.h>
+
+#define NUM_BYTES (8 * 1024 * 1024)
+#define MIN_SECONDS 0.5
+
+typedef void (*bench_func_t)(uint8_t *buf, void *values, int elements);
+
+static void
+scalar_encode16(uint8_t *buf, void *values, int elements)
+{
+    const int16_t *p = (const int16_t*) values;
+    int pos = 0;
+    for (int i = 0; i < elements; i++) {
+        int16_t v = p[i];
+        buf[pos++] = (v>>8) & 0xff;
+        buf[pos++] = (v & 0xff);
+    }
+}
+
+static void
+scalar_decode16(uint8_t *buf, void *values, int elements)
+{
+    int16_t *p = (int16_t*) values;
+    for (int i = 0; i < elements; i++)
+        p[i] = (buf[2*i]<<8) + buf[2*i+1];
+}
+
+static void
+scalar_encode32(uint8_t *buf, void *values, int elements)
+{
+    const int32_t *p = (const int32_t*) values;
+    int pos = 0;
+    for (int i = 0; i < elements; i++) {
+        int32_t v = p[i];
+        buf[pos++] = (v>>24)&0xff;
+        buf[pos++] = (v>>16)&0xff;
+        buf[pos++] = (v>>8)&0xff;
+        buf[pos++] = (v & 0xff);
+    }
+}
+
+static void
+scalar_decode32(uint8_t *buf, void *values, int elements)
+{
+    int32_t *p = (int32_t*) values;
+    for (int i = 0; i < elements; i++) {
+        const uint8_t *b = &buf[4*i];
+        p[i] = (((int32_t)b[0])<<24) + (((int32_t)b[1])<<16) +
+            (((int32_t)b[2])<<8) + ((int32_t)b[3]);
+    }
+}
+
+static void
+scalar_encode64(uint8_t *buf, void *values, int elements)
+{
+    const int64_t *p = (const int64_t*) values;
+    int pos = 0;
+    for (int i = 0; i < elements; i++) {
+        int64_t v = p[i];
+        for (int shift = 56; shift >= 0; shift -= 8)
+            buf[pos++] = (v>>shift)&0xff;
+    }
+}
+
+static void
+scalar_decode64(uint8_t *buf, void *values, int elements)
+{
+    int64_t *p = (int64_t*) values;
+    for (int i = 0; i < elements; i++) {
+        const uint8_t *b = &buf[8*i];
+        int64_t a = (((int32_t)b[0])<<24) + (((int32_t)b[1])<<16) +
+            ((int32_t)b[2]<<8) + (int32_t)b[3];
+        int64_t c = (((int32_t)b[4])<<24) + (((int32_t)b[5])<<16) +
+            ((int32_t)b[6]<<8) + (int32_t)b[7];
+        p[i] = (a<<32) + (c&0xffffffff);
+    }
+}
+
+static void
+lcm_encode16(uint8_t *buf, void *values, int elements)
+{
+    __int16_t_encode_array(buf, 0, NUM_BYTES, (const int16_t*) values, elements);
+}
+
+static void
+lcm_decode16(uint8_t *buf, void *values, int elements)
+{
+    __int16_t_decode_array(buf, 0, NUM_BYTES, (int16_t*) values, elements);
+}
+
+static void
+lcm_encode_float(uint8_t *buf, void *values, int elements)
+{
+    __float_encode_array(buf, 0, NUM_BYTES, (const float*) values, elements);
+}
+
+static void
+lcm_decode_float(uint8_t *buf, void *values, int elements)
+{
+    __float_decode_array(buf, 0, NUM_BYTES, (float*) values, elements);
+}
+
+static void
+lcm_encode_double(uint8_t *buf, void *values, int elements)
+{
+    __double_encode_array(buf, 0, NUM_BYTES, (const double*) values, elements);
+}
+
+static void
+lcm_decode_double(uint8_t *buf, void *values, int elements)
+{
+    __double_decode_array(buf, 0, NUM_BYTES, (double*) values, elements);
+}
+
+// returns the throughput of func, in GB/s
+static double
+measure(bench_func_t func, uint8_t *buf, void *values, int elements)
+{
+    GTimer *timer = g_timer_new();
+    int iterations = 0;
+    double elapsed;
+    do {
+        func(buf, values, elements);
+        iterations++;
+        elapsed = g_timer_elapsed(timer, NULL);
+    } while (elapsed < MIN_SECONDS);
+    g_timer_destroy(timer);
+    return (double) iterations * NUM_BYTES / elapsed / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    struct {
+        const char *name;
+        int size;
+        bench_func_t scalar;
+        bench_func_t lcm;
+    } benches[] = {
+        { "int16_t encode", 2, scalar_encode16, lcm_encode16 },
+        { "int16_t decode", 2, scalar_decode16, lcm_decode16 },
+        { "float encode",   4, scalar_encode32, lcm_encode_float },
+        { "float decode",   4, scalar_decode32, lcm_decode_float },
+        { "double encode",  8, scalar_encode64, lcm_encode_double },
+        { "double decode",  8, scalar_decode64, lcm_decode_double },
+    };
+
+    uint8_t *buf = (uint8_t*) malloc(NUM_BYTES);
+    uint8_t *values = (uint8_t*) malloc(NUM_BYTES);
+    uint8_t *check_buf = (uint8_t*) malloc(NUM_BYTES);
+    uint8_t *check_values = (uint8_t*) malloc(NUM_BYTES);
+    for (int i = 0; i < NUM_BYTES; i++)
+        values[i] = rand();
+
+    double memcpy_rate = 0;
+    {
+        GTimer *timer = g_timer_new();
+        int iterations = 0;
+        double elapsed;
+        do {
+            memcpy(buf, values, NUM_BYTES);
+            iterations++;
+            elapsed = g_timer_elapsed(timer, NULL);
+        } while (elapsed < MIN_SECONDS);
+        g_timer_destroy(timer);
+        memcpy_rate = (double) iterations * NUM_BYTES / elapsed / 1e9;
+    }
+
+    printf("%d byte arrays, GB/s\n", NUM_BYTES);
+    printf("%-16s %10s %10s %8s\n", "", "portable", "lcm", "speedup");
+    for (int b = 0; b < (int) (sizeof(benches) / sizeof(benches[0])); b++) {
+        int elements = NUM_BYTES / benches[b].size;
+
+        // both implementations must produce the same output
+        benches[b].scalar(buf, values, elements);
+        memcpy(check_buf, buf, NUM_BYTES);
+        memcpy(check_values, values, NUM_BYTES);
+        benches[b].lcm(buf, values, elements);
+        if (memcmp(check_buf, buf, NUM_BYTES) ||
+                memcmp(check_values, values, NUM_BYTES)) {
+            fprintf(stderr, "%s: mismatch\n", benches[b].name);
+            return 1;
+        }
+
+        double scalar_rate = measure(benches[b].scalar, buf, values, elements);
+        double lcm_rate = measure(benches[b].lcm, buf, values, elements);
+        printf("%-16s %10.2f %10.2f %7.1fx\n", benches[b].name,
+                scalar_rate, lcm_rate, lcm_rate / scalar_rate);
+    }
+    printf("%-16s %10.2f\n", "memcpy", memcpy_rate);
+
+    free(check_values);
+    free(check_buf);
+    free(values);
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,132 @@
+// Measures how quickly the udpm provider transmits large (fragmented)
+// messages, and bursts of short messages passed to lcm_publish_batch(), with
+// and without sendmmsg().  The send_batch URL option selects between the
+// two.  Nothing needs to be subscribed: the packets are sent to the local
+// host only.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <lcm/lcm.h>
+
+#define DEFAULT_NETWORK "239.255.76.67:7667"
+#define MIN_SECONDS 1.0
+
+#define LARGE_MSG_SIZE (1024 * 1024)
+#define BATCH_SIZE 64
+#define BATCH_MSG_SIZE 200
+
+typedef int (*bench_func_t)(lcm_t *lcm, void *user);
+
+typedef struct {
+    uint8_t *data;
+} large_bench_t;
+
+typedef struct {
+    lcm_publish_entry_t msgs[BATCH_SIZE];
+} batch_bench_t;
+
+static int
+send_large(lcm_t *lcm, void *user)
+{
+    large_bench_t *bench = (large_bench_t*) user;
+    if (lcm_publish(lcm, "SEND_BENCH_LARGE", bench->data, LARGE_MSG_SIZE))
+        return -1;
+    return 1;
+}
+
+static int
+send_batch(lcm_t *lcm, void *user)
+{
+    batch_bench_t *bench = (batch_bench_t*) user;
+    if (lcm_publish_batch(lcm, bench->msgs, BATCH_SIZE))
+        return -1;
+    return BATCH_SIZE;
+}
+
+// returns the number of messages transmitted per second by func, or a
+// negative number on failure.
+static double
+measure(const char *network, int use_sendmmsg, bench_func_t func, void *user)
+{
+    char url[256];
+    snprintf(url, sizeof(url), "udpm://%s?ttl=0&send_batch=%d", network,
+            use_sendmmsg);
+    lcm_t *lcm = lcm_create(url);
+    if (!lcm) {
+        fprintf(stderr, "couldn't create %s\n", url);
+        return -1;
+    }
+
+    GTimer *timer = g_timer_new();
+    double nmsgs = 0;
+    double elapsed;
+    do {
+        int status = func(lcm, user);
+        if (status < 0) {
+            g_timer_destroy(timer);
+            lcm_destroy(lcm);
+            return -1;
+        }
+        nmsgs += status;
+        elapsed = g_timer_elapsed(timer, NULL);
+    } while (elapsed < MIN_SECONDS);
+    g_timer_destroy(timer);
+    lcm_destroy(lcm);
+    return nmsgs / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    const char *network = argc > 1 ? argv[1] : DEFAULT_NETWORK;
+
+    large_bench_t large;
+    large.data = (uint8_t*) malloc(LARGE_MSG_SIZE);
+    for (int i = 0; i < LARGE_MSG_SIZE; i++)
+        large.data[i] = rand();
+
+    batch_bench_t batch;
+    uint8_t *batch_data = (uint8_t*) malloc(BATCH_SIZE * BATCH_MSG_SIZE);
+    for (int i = 0; i < BATCH_SIZE * BATCH_MSG_SIZE; i++)
+        batch_data[i] = rand();
+    for (int i = 0; i < BATCH_SIZE; i++) {
+        batch.msgs[i].channel = "SEND_BENCH_BATCH";
+        batch.msgs[i].data = batch_data + i * BATCH_MSG_SIZE;
+        batch.msgs[i].datalen = BATCH_MSG_SIZE;
+    }
+
+    struct {
+        const char *name;
+        int msg_size;
+        bench_func_t func;
+        void *user;
+    } benches[] = {
+        { "large message", LARGE_MSG_SIZE, send_large, &large },
+        { "publish_batch", BATCH_MSG_SIZE, send_batch, &batch },
+    };
+
+    printf("udpm://%s, messages/s (MB/s)\n", network);
+    printf("%-14s %8s %20s %20s %8s\n", "", "size", "sendmsg", "sendmmsg",
+            "speedup");
+    for (int b = 0; b < (int) (sizeof(benches) / sizeof(benches[0])); b++) {
+        double single_rate = measure(network, 0, benches[b].func,
+                benches[b].user);
+        double batch_rate = measure(network, 1, benches[b].func,
+                benches[b].user);
+        if (single_rate < 0 || batch_rate < 0) {
+            fprintf(stderr, "%s: transmit failed\n", benches[b].name);
+            return 1;
+        }
+        double mb = benches[b].msg_size / 1e6;
+        printf("%-14s %8d %10.0f (%7.1f) %10.0f (%7.1f) %7.2fx\n",
+                benches[b].name, benches[b].msg_size,
+                single_rate, single_rate * mb, batch_rate, batch_rate * mb,
+                batch_rate / single_rate);
+    }
+
+    free(batch_data);
+    free(large.data);
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+// 8-byte aligned storage for the arenas
+static uint64_t g_arena_storage[4096];
+
+// Decodes an encoded message into an arena, and checks that arenas smaller
+// than the space it needs and truncated buffers are both rejected.  Returns
+// the amount of arena space the message needs.
+template <class T>
+static size_t DecodeIntoArena(const std::vector<uint8_t>& buf, T* msg,
+        int (*decode_arena)(const void*, int, int, T*, lcm_arena_t*)) {
+    lcm_arena_t arena;
+    lcm_arena_init(&arena, g_arena_storage, sizeof(g_arena_storage));
+    EXPECT_EQ((int) buf.size(),
+            decode_arena(&buf[0], 0, buf.size(), msg, &arena));
+    size_t used = arena.used;
+
+    for (size_t size = 0; size < used; ++size) {
+        T tmp;
+        lcm_arena_t small;
+        lcm_arena_init(&small, g_arena_storage + 2048, size);
+        EXPECT_GT(0, decode_arena(&buf[0], 0, buf.size(), &tmp, &small))
+            << "arena size " << size;
+    }
+
+    for (int len = 0; len < (int) buf.size(); ++len) {
+        T tmp;
+        lcm_arena_t other;
+        lcm_arena_init(&other, g_arena_storage + 2048,
+                sizeof(g_arena_storage) / 2);
+        EXPECT_GT(0, decode_arena(&buf[0], 0, len, &tmp, &other))
+            << "length " << len;
+    }
+    return used;
+}
+
+TEST(LCM_C, ArenaMultidimArray) {
+    lcmtest_multidim_array_t msg;
+    fill_lcmtest_multidim_array_t(3, &msg);
+    std::vector<uint8_t> buf(lcmtest_multidim_array_t_encoded_size(&msg));
+    EXPECT_EQ((int) buf.size(),
+            lcmtest_multidim_array_t_encode(&buf[0], 0, buf.size(), &msg));
+    clear_lcmtest_multidim_array_t(&msg);
+
+    lcmtest_multidim_array_t decoded;
+    size_t used = DecodeIntoArena(buf, &decoded,
+            lcmtest_multidim_array_t_decode_arena);
+    EXPECT_LT(0, used);
+    EXPECT_TRUE(check_lcmtest_multidim_array_t(&decoded, 3));
+}
+
+TEST(LCM_C, ArenaNode) {
+    lcmtest_node_t msg;
+    fill_lcmtest_node_t(3, &msg);
+    std::vector<uint8_t> buf(lcmtest_node_t_encoded_size(&msg));
+    EXPECT_EQ((int) buf.size(),
+            lcmtest_node_t_encode(&buf[0], 0, buf.size(), &msg));
+    clear_lcmtest_node_t(&msg);
+
+    lcmtest_node_t decoded;
+    size_t used = DecodeIntoArena(buf, &decoded, lcmtest_node_t_decode_arena);
+    EXPECT_LT(0, used);
+    EXPECT_TRUE(check_lcmtest_node_t(&decoded, 3));
+}
+
+TEST(LCM_C, ArenaReset) {
+    // decode several messages into the same arena, one at a time
+    lcm_arena_t arena;
+    lcm_arena_init(&arena, g_arena_storage, sizeof(g_arena_storage));
+    size_t first_used = 0;
+    for (int iter = 0; iter < 3; ++iter) {
+        lcmtest_primitives_list_t msg;
+        fill_lcmtest_primitives_list_t(4, &msg);
+        std::vector<uint8_t> buf(lcmtest_primitives_list_t_encoded_size(&msg));
+        EXPECT_EQ((int) buf.size(),
+                lcmtest_primitives_list_t_encode(&buf[0], 0, buf.size(), &msg));
+        clear_lcmtest_primitives_list_t(&msg);
+
+        lcm_arena_reset(&arena);
+        EXPECT_EQ(0, arena.used);
+        lcmtest_primitives_list_t decoded;
+        EXPECT_EQ((int) buf.size(), lcmtest_primitives_list_t_decode_arena(
+                    &buf[0], 0, buf.size(), &decoded, &arena));
+        EXPECT_TRUE(check_lcmtest_primitives_list_t(&decoded, 4));
+        EXPECT_EQ((void*) g_arena_storage, (void*) decoded.items);
+        if (!iter)
+            first_used = arena.used;
+        EXPECT_EQ(first_used, arena.used);
+    }
+}
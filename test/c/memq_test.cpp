@@ -1,5 +1,7 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <gtest/gtest.h>
 
 #include <lcm/lcm.h>
@@ -113,3 +115,682 @@ TEST(LCM_C, MemqTimeout) {
 
   lcm_destroy(lcm);
 }
+
+TEST(LCM_C, MemqPublishBatch) {
+    // Publish several messages with a single call, then read them all back
+    // in order.
+    lcm_t* lcm = lcm_create("memq://");
+    std::vector<std::vector<uint8_t> > received_buffers;
+
+    lcm_subscribe(lcm, "channel", MemqBufferedHandler, &received_buffers);
+
+    int num_bufs = 20;
+    int buf_size = 100;
+    std::vector<std::vector<uint8_t> > buffers(num_bufs);
+    std::vector<lcm_publish_entry_t> entries(num_bufs);
+    for (int buf_num = 0; buf_num < num_bufs; ++buf_num) {
+        std::vector<uint8_t>& buf = buffers[buf_num];
+        buf.resize(buf_size);
+        for (int byte_index = 0; byte_index < buf_size; ++byte_index) {
+            buf[byte_index] = rand() % 255;
+        }
+        entries[buf_num].channel = "channel";
+        entries[buf_num].data = &buf[0];
+        entries[buf_num].datalen = buf.size();
+    }
+
+    EXPECT_EQ(0, lcm_publish_batch(lcm, &entries[0], num_bufs));
+
+    for (int buf_num = 0; buf_num < num_bufs; ++buf_num) {
+        lcm_handle(lcm);
+    }
+
+    EXPECT_EQ(buffers, received_buffers);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqHandleBatch) {
+    // Publish several messages, then dispatch them a few at a time.
+    lcm_t* lcm = lcm_create("memq://");
+    std::vector<std::vector<uint8_t> > received_buffers;
+
+    // No messages available.  Call should timeout immediately.
+    EXPECT_EQ(0, lcm_handle_batch(lcm, 10, 0));
+
+    // Invalid batch size should result in an error.
+    EXPECT_GT(0, lcm_handle_batch(lcm, 0, 0));
+
+    lcm_subscribe(lcm, "channel", MemqBufferedHandler, &received_buffers);
+
+    int num_bufs = 10;
+    std::vector<std::vector<uint8_t> > buffers(num_bufs);
+    for (int buf_num = 0; buf_num < num_bufs; ++buf_num) {
+        buffers[buf_num].resize(10, buf_num);
+        lcm_publish(lcm, "channel", &buffers[buf_num][0],
+                buffers[buf_num].size());
+    }
+
+    EXPECT_EQ(4, lcm_handle_batch(lcm, 4, 0));
+    EXPECT_EQ(4, received_buffers.size());
+    EXPECT_EQ(6, lcm_handle_batch(lcm, 100, 0));
+    EXPECT_EQ(0, lcm_handle_batch(lcm, 100, 0));
+
+    EXPECT_EQ(buffers, received_buffers);
+
+    lcm_destroy(lcm);
+}
+
+static void
+MemqRetainHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user) {
+    std::vector<lcm_recv_buf_t*>* retained =
+        static_cast<std::vector<lcm_recv_buf_t*>*>(user);
+    retained->push_back(lcm_recv_buf_ref(rbuf));
+}
+
+TEST(LCM_C, MemqRecvBufRef) {
+    // Retain a message from within a handler, and check that it is still
+    // valid after the handler returns and the LCM instance is destroyed.
+    lcm_t* lcm = lcm_create("memq://");
+    std::vector<lcm_recv_buf_t*> retained;
+
+    // Two subscriptions on the same channel share the retained buffer.
+    lcm_subscribe(lcm, "channel", MemqRetainHandler, &retained);
+    lcm_subscribe(lcm, "channel", MemqRetainHandler, &retained);
+
+    std::vector<uint8_t> buf(100);
+    for (size_t byte_index = 0; byte_index < buf.size(); ++byte_index) {
+        buf[byte_index] = rand() % 255;
+    }
+    lcm_publish(lcm, "channel", &buf[0], buf.size());
+    EXPECT_EQ(0, lcm_handle(lcm));
+    ASSERT_EQ(2, retained.size());
+    ASSERT_TRUE(retained[0] != NULL);
+    EXPECT_EQ(retained[0], retained[1]);
+
+    lcm_destroy(lcm);
+
+    lcm_recv_buf_t* rbuf = retained[0];
+    EXPECT_TRUE(rbuf->lcm == NULL);
+    ASSERT_EQ(buf.size(), rbuf->data_size);
+    EXPECT_EQ(0, memcmp(&buf[0], rbuf->data, buf.size()));
+
+    // A retained buffer can be referenced again outside of a handler.
+    EXPECT_EQ(rbuf, lcm_recv_buf_ref(rbuf));
+    lcm_recv_buf_unref(rbuf);
+    lcm_recv_buf_unref(rbuf);
+    lcm_recv_buf_unref(rbuf);
+}
+
+TEST(LCM_C, MemqStats) {
+    lcm_t* lcm = lcm_create("memq://");
+    std::vector<uint8_t> received_buf;
+    lcm_subscription_t* subs =
+        lcm_subscribe(lcm, "channel", MemqSimpleHandler, &received_buf);
+    lcm_subscription_set_queue_capacity(subs, 5);
+
+    std::vector<uint8_t> buf(100);
+    for (int iter = 0; iter < 3; ++iter) {
+        lcm_publish(lcm, "channel", &buf[0], buf.size());
+        EXPECT_EQ(0, lcm_handle(lcm));
+    }
+
+    lcm_subscription_stats_t subs_stats;
+    EXPECT_EQ(0, lcm_subscription_get_stats(subs, &subs_stats));
+    EXPECT_EQ(0, subs_stats.queue_depth);
+    EXPECT_EQ(5, subs_stats.queue_capacity);
+    EXPECT_EQ(0, subs_stats.queue_drops);
+
+    // memq has no transport counters, so everything should be zero.
+    lcm_stats_t stats;
+    memset(&stats, 0xff, sizeof(stats));
+    EXPECT_EQ(0, lcm_get_stats(lcm, &stats));
+    EXPECT_EQ(0, stats.packets_received);
+    EXPECT_EQ(0, stats.packets_bad);
+    EXPECT_EQ(0, stats.ringbuf_drops);
+    EXPECT_EQ(0, stats.ringbuf_slabs);
+    EXPECT_EQ(0, stats.queue_drops);
+
+    lcm_destroy(lcm);
+}
+
+static std::vector<int> g_matched_subscriptions;
+
+void MemqMatchHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    g_matched_subscriptions.push_back(*(int*)user_data);
+}
+
+static std::vector<int> MemqPublishAndMatch(lcm_t* lcm, const char* channel) {
+    g_matched_subscriptions.clear();
+    uint8_t byte = 0;
+    lcm_publish(lcm, channel, &byte, 1);
+    while (lcm_handle_timeout(lcm, 0) > 0) {
+    }
+    return g_matched_subscriptions;
+}
+
+TEST(LCM_C, MemqChannelMatching) {
+    lcm_t* lcm = lcm_create("memq://");
+    int ids[] = { 0, 1, 2, 3 };
+
+    // a literal channel, a prefix wildcard, a general regex, and everything.
+    lcm_subscribe(lcm, "FOO_BAR", MemqMatchHandler, &ids[0]);
+    lcm_subscription_t* prefix_subs =
+        lcm_subscribe(lcm, "FOO_.*", MemqMatchHandler, &ids[1]);
+    lcm_subscribe(lcm, "FOO_B[A-Z]R", MemqMatchHandler, &ids[2]);
+    lcm_subscribe(lcm, ".*", MemqMatchHandler, &ids[3]);
+
+    // handlers are called in the order they subscribed.
+    std::vector<int> expected;
+    expected.push_back(0);
+    expected.push_back(1);
+    expected.push_back(2);
+    expected.push_back(3);
+    EXPECT_EQ(expected, MemqPublishAndMatch(lcm, "FOO_BAR"));
+
+    expected.clear();
+    expected.push_back(1);
+    expected.push_back(3);
+    EXPECT_EQ(expected, MemqPublishAndMatch(lcm, "FOO_X"));
+
+    expected.clear();
+    expected.push_back(3);
+    EXPECT_EQ(expected, MemqPublishAndMatch(lcm, "FOO"));
+    EXPECT_EQ(expected, MemqPublishAndMatch(lcm, "XFOO_BAR"));
+
+    // channels that have already been seen are updated on unsubscribe.
+    lcm_unsubscribe(lcm, prefix_subs);
+    expected.clear();
+    expected.push_back(0);
+    expected.push_back(2);
+    expected.push_back(3);
+    EXPECT_EQ(expected, MemqPublishAndMatch(lcm, "FOO_BAR"));
+
+    // and on subscribe, in subscription order.
+    lcm_subscribe(lcm, "FOO_BAR", MemqMatchHandler, &ids[1]);
+    expected.push_back(1);
+    EXPECT_EQ(expected, MemqPublishAndMatch(lcm, "FOO_BAR"));
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqChannelCache) {
+    lcm_t* lcm = lcm_create("memq://");
+    int ids[] = { 0, 1 };
+    EXPECT_EQ(0, lcm_set_max_cached_channels(lcm, 2));
+
+    lcm_subscribe(lcm, "CH_.*", MemqMatchHandler, &ids[0]);
+
+    // channel names evicted from the cache are looked up again.
+    std::vector<int> expected;
+    expected.push_back(0);
+    char channel[16];
+    for (int round = 0; round < 2; ++round) {
+        for (int i = 0; i < 5; ++i) {
+            snprintf(channel, sizeof(channel), "CH_%d", i);
+            EXPECT_EQ(expected, MemqPublishAndMatch(lcm, channel));
+        }
+    }
+
+    // subscriptions made while a channel is not cached still apply to it.
+    lcm_subscription_t* subs =
+        lcm_subscribe(lcm, "CH_0", MemqMatchHandler, &ids[1]);
+    expected.push_back(1);
+    EXPECT_EQ(expected, MemqPublishAndMatch(lcm, "CH_0"));
+    EXPECT_EQ(std::vector<int>(1, 0), MemqPublishAndMatch(lcm, "CH_1"));
+    EXPECT_EQ(std::vector<int>(1, 0), MemqPublishAndMatch(lcm, "CH_2"));
+
+    lcm_unsubscribe(lcm, subs);
+    EXPECT_EQ(std::vector<int>(1, 0), MemqPublishAndMatch(lcm, "CH_0"));
+
+    lcm_destroy(lcm);
+}
+
+struct MemqUnsubscribeState {
+    lcm_t* lcm;
+    lcm_subscription_t* subs[2];
+    int num_calls[2];
+};
+
+void MemqUnsubscribeHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqUnsubscribeState* state = (MemqUnsubscribeState*)user_data;
+    state->num_calls[0]++;
+    // unsubscribe this handler and the one after it while they're being
+    // dispatched.
+    lcm_unsubscribe(state->lcm, state->subs[0]);
+    lcm_unsubscribe(state->lcm, state->subs[1]);
+}
+
+void MemqCountHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqUnsubscribeState* state = (MemqUnsubscribeState*)user_data;
+    state->num_calls[1]++;
+}
+
+TEST(LCM_C, MemqUnsubscribeInHandler) {
+    MemqUnsubscribeState state;
+    memset(&state, 0, sizeof(state));
+    state.lcm = lcm_create("memq://");
+    state.subs[0] =
+        lcm_subscribe(state.lcm, "channel", MemqUnsubscribeHandler, &state);
+    state.subs[1] =
+        lcm_subscribe(state.lcm, "channel", MemqCountHandler, &state);
+
+    uint8_t byte = 0;
+    lcm_publish(state.lcm, "channel", &byte, 1);
+    lcm_publish(state.lcm, "channel", &byte, 1);
+    EXPECT_EQ(2, lcm_handle_batch(state.lcm, 2, 0));
+    EXPECT_EQ(1, state.num_calls[0]);
+    EXPECT_EQ(0, state.num_calls[1]);
+
+    lcm_destroy(state.lcm);
+}
+
+TEST(LCM_C, MemqChannelHasSubscribers) {
+    lcm_t* lcm = lcm_create("memq://");
+    int id = 0;
+    EXPECT_EQ(0, lcm_channel_has_subscribers(lcm, "CH_0"));
+
+    lcm_subscription_t* subs =
+        lcm_subscribe(lcm, "CH_.*", MemqMatchHandler, &id);
+    EXPECT_NE(0, lcm_channel_has_subscribers(lcm, "CH_0"));
+    EXPECT_EQ(0, lcm_channel_has_subscribers(lcm, "OTHER"));
+
+    lcm_unsubscribe(lcm, subs);
+    EXPECT_EQ(0, lcm_channel_has_subscribers(lcm, "CH_0"));
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, EncodeBuffer) {
+    // the buffer is reused until a larger one is needed
+    char* buf = (char*) lcm_get_encode_buffer(100);
+    ASSERT_TRUE(buf != NULL);
+    memset(buf, 0, 100);
+    EXPECT_EQ(buf, lcm_get_encode_buffer(10));
+    EXPECT_EQ(buf, lcm_get_encode_buffer(100));
+
+    char* larger = (char*) lcm_get_encode_buffer(100000);
+    ASSERT_TRUE(larger != NULL);
+    memset(larger, 0, 100000);
+    EXPECT_EQ(larger, lcm_get_encode_buffer(100));
+}
+
+struct MemqDispatchRecord {
+    std::vector<int> values;
+    std::vector<lcm_recv_buf_t*> retained;
+};
+
+void MemqDispatchHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqDispatchRecord* record = (MemqDispatchRecord*)user_data;
+    record->values.push_back(*(int*)rbuf->data);
+    record->retained.push_back(lcm_recv_buf_ref(rbuf));
+}
+
+TEST(LCM_C, MemqDispatchThreads) {
+    lcm_t* lcm = lcm_create("memq://");
+    ASSERT_EQ(0, lcm_set_dispatch_threads(lcm, 2));
+
+    // Three subscriptions on two dispatch threads, the last two sharing one.
+    const int num_subs = 3;
+    MemqDispatchRecord records[num_subs];
+    for (int sub_index = 0; sub_index < num_subs; ++sub_index) {
+        lcm_subscription_t* subs = lcm_subscribe(lcm, "channel",
+                MemqDispatchHandler, &records[sub_index]);
+        lcm_subscription_set_queue_capacity(subs, 0);
+        if (sub_index > 0) {
+            EXPECT_EQ(0, lcm_subscription_set_dispatch_group(subs, 1));
+        }
+    }
+
+    const int num_msgs = 100;
+    for (int msg_index = 0; msg_index < num_msgs; ++msg_index) {
+        lcm_publish(lcm, "channel", &msg_index, sizeof(msg_index));
+    }
+    EXPECT_EQ(num_msgs, lcm_handle_batch(lcm, num_msgs, 0));
+
+    // Waits for the dispatch threads to finish.
+    EXPECT_EQ(0, lcm_set_dispatch_threads(lcm, 0));
+
+    for (int sub_index = 0; sub_index < num_subs; ++sub_index) {
+        MemqDispatchRecord& record = records[sub_index];
+        ASSERT_EQ(num_msgs, record.values.size());
+        for (int msg_index = 0; msg_index < num_msgs; ++msg_index) {
+            EXPECT_EQ(msg_index, record.values[msg_index]);
+            // every subscription was handed the same buffer
+            lcm_recv_buf_t* rbuf = record.retained[msg_index];
+            ASSERT_TRUE(rbuf != NULL);
+            EXPECT_EQ(rbuf, records[0].retained[msg_index]);
+            EXPECT_EQ(msg_index, *(int*)rbuf->data);
+        }
+    }
+    for (int sub_index = 0; sub_index < num_subs; ++sub_index) {
+        for (int msg_index = 0; msg_index < num_msgs; ++msg_index) {
+            lcm_recv_buf_unref(records[sub_index].retained[msg_index]);
+        }
+    }
+
+    lcm_destroy(lcm);
+}
+
+void MemqRecordChannelHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    ((std::vector<std::string>*)user_data)->push_back(channel);
+}
+
+TEST(LCM_C, MemqPriority) {
+    lcm_t* lcm = lcm_create("memq://");
+    std::vector<std::string> received;
+    lcm_subscription_t* low =
+        lcm_subscribe(lcm, "LOW", MemqRecordChannelHandler, &received);
+    lcm_subscription_t* high =
+        lcm_subscribe(lcm, "HIGH", MemqRecordChannelHandler, &received);
+    EXPECT_EQ(0, lcm_subscription_set_priority(high, 1));
+
+    uint8_t byte = 0;
+    lcm_publish(lcm, "LOW", &byte, 1);
+    lcm_publish(lcm, "HIGH", &byte, 1);
+    lcm_publish(lcm, "LOW", &byte, 1);
+    lcm_publish(lcm, "HIGH", &byte, 1);
+
+    // The backlog of HIGH messages is handled first, in order.
+    EXPECT_EQ(0, lcm_handle(lcm));
+    EXPECT_EQ(3, lcm_handle_batch(lcm, 3, 0));
+    const char* expected[] = { "HIGH", "HIGH", "LOW", "LOW" };
+    EXPECT_EQ(std::vector<std::string>(expected, expected + 4), received);
+
+    // Changing a priority applies to channels that were already received.
+    EXPECT_EQ(0, lcm_subscription_set_priority(low, 2));
+    received.clear();
+    lcm_publish(lcm, "HIGH", &byte, 1);
+    lcm_publish(lcm, "LOW", &byte, 1);
+    EXPECT_EQ(2, lcm_handle_batch(lcm, 2, 0));
+    const char* reordered[] = { "LOW", "HIGH" };
+    EXPECT_EQ(std::vector<std::string>(reordered, reordered + 2), received);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqLatencyBudget) {
+    lcm_t* lcm = lcm_create("memq://");
+    std::vector<std::string> received;
+    lcm_subscribe(lcm, "channel", MemqRecordChannelHandler, &received);
+    lcm_subscription_t* subs =
+        lcm_subscribe(lcm, "channel", MemqRecordChannelHandler, &received);
+    EXPECT_EQ(0, lcm_subscription_set_latency_budget(subs, 100000));
+
+    // Only the subscription without a budget handles the late message.
+    uint8_t byte = 0;
+    lcm_publish(lcm, "channel", &byte, 1);
+    usleep(200000);
+    EXPECT_EQ(0, lcm_handle(lcm));
+    EXPECT_EQ(1, received.size());
+
+    lcm_subscription_stats_t subs_stats;
+    lcm_subscription_get_stats(subs, &subs_stats);
+    EXPECT_EQ(1, subs_stats.stale_drops);
+    EXPECT_EQ(0, subs_stats.queue_depth);
+    lcm_stats_t stats;
+    lcm_get_stats(lcm, &stats);
+    EXPECT_EQ(1, stats.stale_drops);
+
+    // Messages handled in time are not dropped.
+    lcm_publish(lcm, "channel", &byte, 1);
+    EXPECT_EQ(0, lcm_handle(lcm));
+    EXPECT_EQ(3, received.size());
+
+    lcm_destroy(lcm);
+}
+
+struct MemqKeepLatestState {
+    volatile int num_calls;
+    volatile int release;
+    std::vector<int> values;
+};
+
+void MemqKeepLatestHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqKeepLatestState* state = (MemqKeepLatestState*)user_data;
+    state->values.push_back(*(int*)rbuf->data);
+    state->num_calls++;
+    // hold up the dispatch thread so that the next messages back up
+    while (!state->release) {
+        usleep(1000);
+    }
+}
+
+TEST(LCM_C, MemqKeepLatest) {
+    lcm_t* lcm = lcm_create("memq://");
+    ASSERT_EQ(0, lcm_set_dispatch_threads(lcm, 1));
+    MemqKeepLatestState state;
+    state.num_calls = 0;
+    state.release = 0;
+    lcm_subscription_t* subs =
+        lcm_subscribe(lcm, "channel", MemqKeepLatestHandler, &state);
+    lcm_subscription_set_queue_capacity(subs, 2);
+    EXPECT_EQ(0, lcm_subscription_set_queue_policy(subs,
+                LCM_QUEUE_KEEP_LATEST));
+
+    // The first message is being handled while the others queue up.  Only
+    // the newest of those is handled after it.
+    const int num_msgs = 5;
+    for (int msg_index = 0; msg_index < num_msgs; ++msg_index) {
+        lcm_publish(lcm, "channel", &msg_index, sizeof(msg_index));
+        EXPECT_EQ(0, lcm_handle(lcm));
+        while (!state.num_calls) {
+            usleep(1000);
+        }
+    }
+    state.release = 1;
+    EXPECT_EQ(0, lcm_set_dispatch_threads(lcm, 0));
+
+    std::vector<int> expected;
+    expected.push_back(0);
+    expected.push_back(num_msgs - 1);
+    EXPECT_EQ(expected, state.values);
+
+    lcm_subscription_stats_t stats;
+    lcm_subscription_get_stats(subs, &stats);
+    EXPECT_EQ(num_msgs - 2, stats.superseded);
+    EXPECT_EQ(0, stats.queue_drops);
+    EXPECT_EQ(0, stats.queue_depth);
+
+    lcm_destroy(lcm);
+}
+
+void MemqLatestValueHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    ((std::vector<int>*)user_data)->push_back(*(int*)rbuf->data);
+}
+
+TEST(LCM_C, MemqKeepLatestNoThreads) {
+    // Without dispatch threads, messages published before lcm_handle() is
+    // called are conflated too.
+    lcm_t* lcm = lcm_create("memq://");
+    std::vector<int> values;
+    lcm_subscription_t* subs =
+        lcm_subscribe(lcm, "channel", MemqLatestValueHandler, &values);
+    EXPECT_EQ(0, lcm_subscription_set_queue_policy(subs,
+                LCM_QUEUE_KEEP_LATEST));
+
+    const int num_msgs = 5;
+    for (int msg_index = 0; msg_index < num_msgs; ++msg_index) {
+        lcm_publish(lcm, "channel", &msg_index, sizeof(msg_index));
+    }
+    EXPECT_EQ(num_msgs, lcm_handle_batch(lcm, 100, 0));
+
+    std::vector<int> expected(1, num_msgs - 1);
+    EXPECT_EQ(expected, values);
+
+    lcm_subscription_stats_t stats;
+    lcm_subscription_get_stats(subs, &stats);
+    EXPECT_EQ(num_msgs - 1, stats.superseded);
+    EXPECT_EQ(0, stats.queue_depth);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqKeepLatestByChannel) {
+    // A subscription matching two channels keeps the latest message of each.
+    lcm_t* lcm = lcm_create("memq://");
+    std::vector<int> values;
+    lcm_subscription_t* subs =
+        lcm_subscribe(lcm, "POSE_.*", MemqLatestValueHandler, &values);
+    EXPECT_EQ(0, lcm_subscription_set_queue_policy(subs,
+                LCM_QUEUE_KEEP_LATEST));
+
+    // even values on POSE_A, odd ones on POSE_B
+    const int num_msgs = 5;
+    for (int msg_index = 0; msg_index < num_msgs; ++msg_index) {
+        lcm_publish(lcm, msg_index % 2 ? "POSE_B" : "POSE_A", &msg_index,
+                sizeof(msg_index));
+    }
+    EXPECT_EQ(num_msgs, lcm_handle_batch(lcm, 100, 0));
+
+    std::vector<int> expected;
+    expected.push_back(3);
+    expected.push_back(4);
+    EXPECT_EQ(expected, values);
+
+    lcm_subscription_stats_t stats;
+    lcm_subscription_get_stats(subs, &stats);
+    EXPECT_EQ(num_msgs - 2, stats.superseded);
+    EXPECT_EQ(0, stats.queue_depth);
+
+    // The same goes for the queue of a dispatch thread.  The first message is
+    // being handled while the others queue up.
+    ASSERT_EQ(0, lcm_set_dispatch_threads(lcm, 1));
+    MemqKeepLatestState state;
+    state.num_calls = 0;
+    state.release = 0;
+    lcm_unsubscribe(lcm, subs);
+    subs = lcm_subscribe(lcm, "POSE_.*", MemqKeepLatestHandler, &state);
+    EXPECT_EQ(0, lcm_subscription_set_queue_policy(subs,
+                LCM_QUEUE_KEEP_LATEST));
+    for (int msg_index = 0; msg_index < num_msgs; ++msg_index) {
+        lcm_publish(lcm, msg_index % 2 ? "POSE_B" : "POSE_A", &msg_index,
+                sizeof(msg_index));
+        EXPECT_EQ(0, lcm_handle(lcm));
+        while (!state.num_calls) {
+            usleep(1000);
+        }
+    }
+    state.release = 1;
+    EXPECT_EQ(0, lcm_set_dispatch_threads(lcm, 0));
+
+    // POSE_B was queued first
+    expected.clear();
+    expected.push_back(0);
+    expected.push_back(3);
+    expected.push_back(4);
+    EXPECT_EQ(expected, state.values);
+
+    lcm_subscription_get_stats(subs, &stats);
+    EXPECT_EQ(num_msgs - 3, stats.superseded);
+    EXPECT_EQ(0, stats.queue_depth);
+
+    lcm_destroy(lcm);
+}
+
+struct MemqSlowState {
+    volatile int num_calls;
+    volatile int release;
+    int sleep_usec;
+    std::vector<int> values;
+};
+
+void MemqSlowHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqSlowState* state = (MemqSlowState*)user_data;
+    state->values.push_back(*(int*)rbuf->data);
+    state->num_calls++;
+    while (!state->release) {
+        usleep(1000);
+    }
+    usleep(state->sleep_usec);
+}
+
+TEST(LCM_C, MemqDropOldest) {
+    lcm_t* lcm = lcm_create("memq://");
+    ASSERT_EQ(0, lcm_set_dispatch_threads(lcm, 2));
+
+    // A slow subscription doesn't hold up a fast one on another thread.
+    MemqSlowState slow;
+    slow.num_calls = 0;
+    slow.release = 0;
+    slow.sleep_usec = 0;
+    lcm_subscription_t* slow_subs =
+        lcm_subscribe(lcm, "channel", MemqSlowHandler, &slow);
+    lcm_subscription_set_queue_capacity(slow_subs, 2);
+    EXPECT_EQ(0, lcm_subscription_set_queue_policy(slow_subs,
+                LCM_QUEUE_DROP_OLDEST));
+    MemqSlowState fast;
+    fast.num_calls = 0;
+    fast.release = 1;
+    fast.sleep_usec = 0;
+    lcm_subscribe(lcm, "channel", MemqSlowHandler, &fast);
+
+    const int num_msgs = 10;
+    for (int msg_index = 0; msg_index < num_msgs; ++msg_index) {
+        lcm_publish(lcm, "channel", &msg_index, sizeof(msg_index));
+        EXPECT_EQ(0, lcm_handle(lcm));
+        while (!slow.num_calls) {
+            usleep(1000);
+        }
+    }
+    while (fast.num_calls < num_msgs) {
+        usleep(1000);
+    }
+
+    lcm_subscription_stats_t stats;
+    lcm_subscription_get_stats(slow_subs, &stats);
+    EXPECT_EQ(3, stats.queue_depth);
+    EXPECT_EQ(3, stats.dispatch_queue_depth);
+    EXPECT_EQ(num_msgs - 3, stats.queue_drops);
+
+    // The slow subscription handles the first message, then the newest ones.
+    slow.release = 1;
+    EXPECT_EQ(0, lcm_set_dispatch_threads(lcm, 0));
+    std::vector<int> expected;
+    expected.push_back(0);
+    expected.push_back(num_msgs - 2);
+    expected.push_back(num_msgs - 1);
+    EXPECT_EQ(expected, slow.values);
+    EXPECT_EQ(num_msgs, fast.values.size());
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqBlock) {
+    lcm_t* lcm = lcm_create("memq://");
+    ASSERT_EQ(0, lcm_set_dispatch_threads(lcm, 1));
+
+    // Dispatching waits for the handler instead of dropping messages.
+    MemqSlowState state;
+    state.num_calls = 0;
+    state.release = 1;
+    state.sleep_usec = 1000;
+    lcm_subscription_t* subs =
+        lcm_subscribe(lcm, "channel", MemqSlowHandler, &state);
+    lcm_subscription_set_queue_capacity(subs, 1);
+    EXPECT_EQ(0, lcm_subscription_set_queue_policy(subs, LCM_QUEUE_BLOCK));
+
+    const int num_msgs = 20;
+    for (int msg_index = 0; msg_index < num_msgs; ++msg_index) {
+        lcm_publish(lcm, "channel", &msg_index, sizeof(msg_index));
+    }
+    EXPECT_EQ(num_msgs, lcm_handle_batch(lcm, num_msgs, 0));
+    EXPECT_EQ(0, lcm_set_dispatch_threads(lcm, 0));
+
+    EXPECT_EQ(num_msgs, state.values.size());
+    lcm_subscription_stats_t stats;
+    lcm_subscription_get_stats(subs, &stats);
+    EXPECT_EQ(0, stats.queue_drops);
+    EXPECT_EQ(0, stats.queue_depth);
+
+    lcm_destroy(lcm);
+}
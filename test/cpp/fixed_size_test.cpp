@@ -0,0 +1,123 @@
+#include <string.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "lcmtest/fixed_size_t.hpp"
+
+static void FillVec(int n, lcmtest::vec3_t* vec) {
+    vec->x = n + 0.25;
+    vec->y = -n - 0.5;
+    vec->z = n * 2.0f;
+}
+
+static void FillFixedSize(lcmtest::fixed_size_t* msg) {
+    msg->utime = 0x0102030405060708LL;
+    msg->enabled = 1;
+    for (int i = 0; i < 3; ++i) {
+        msg->flags[i] = 0xf0 + i;
+    }
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            msg->gains[i][j] = -1000 * i + j;
+        }
+    }
+    for (int i = 0; i < 6; ++i) {
+        for (int j = 0; j < 6; ++j) {
+            msg->cov[i][j] = i * 6 + j + 0.125;
+        }
+    }
+    FillVec(7, &msg->pos);
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            FillVec(i * 3 + j, &msg->waypoints[i][j]);
+        }
+    }
+    msg->mode = -3;
+    for (int i = 0; i < 4; ++i) {
+        msg->counts[i] = (i + 1) * 100000;
+    }
+}
+
+static void ExpectVecEq(const lcmtest::vec3_t& expected,
+        const lcmtest::vec3_t& actual) {
+    EXPECT_EQ(expected.x, actual.x);
+    EXPECT_EQ(expected.y, actual.y);
+    EXPECT_EQ(expected.z, actual.z);
+}
+
+TEST(LCM_CPP, FixedSizeRoundTrip) {
+    lcmtest::fixed_size_t msg;
+    FillFixedSize(&msg);
+    // 8 byte hash, then the fields
+    ASSERT_EQ(8 + 469, msg.getEncodedSize());
+
+    std::vector<uint8_t> buf(msg.getEncodedSize());
+    ASSERT_EQ((int) buf.size(), msg.encode(&buf[0], 0, buf.size()));
+
+    lcmtest::fixed_size_t decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    ASSERT_EQ((int) buf.size(), decoded.decode(&buf[0], 0, buf.size()));
+    EXPECT_EQ(msg.utime, decoded.utime);
+    EXPECT_EQ(msg.enabled, decoded.enabled);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(msg.flags[i], decoded.flags[i]);
+    }
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            EXPECT_EQ(msg.gains[i][j], decoded.gains[i][j]);
+        }
+    }
+    for (int i = 0; i < 6; ++i) {
+        for (int j = 0; j < 6; ++j) {
+            EXPECT_EQ(msg.cov[i][j], decoded.cov[i][j]);
+        }
+    }
+    ExpectVecEq(msg.pos, decoded.pos);
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            ExpectVecEq(msg.waypoints[i][j], decoded.waypoints[i][j]);
+        }
+    }
+    EXPECT_EQ(msg.mode, decoded.mode);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(msg.counts[i], decoded.counts[i]);
+    }
+
+    // the message is encoded the same way again
+    std::vector<uint8_t> buf2(decoded.getEncodedSize());
+    ASSERT_EQ((int) buf2.size(), decoded.encode(&buf2[0], 0, buf2.size()));
+    EXPECT_EQ(buf, buf2);
+}
+
+TEST(LCM_CPP, FixedSizeLayout) {
+    // read the encoded message back through a view, which walks the fields
+    // one at a time instead of using fixed offsets
+    lcmtest::fixed_size_t msg;
+    FillFixedSize(&msg);
+    std::vector<uint8_t> buf(msg.getEncodedSize());
+    ASSERT_EQ((int) buf.size(), msg.encode(&buf[0], 0, buf.size()));
+
+    lcmtest::fixed_size_tView view;
+    ASSERT_EQ((int) buf.size(), view.decode(&buf[0], 0, buf.size()));
+    EXPECT_EQ(msg.utime, view.utime());
+    EXPECT_EQ(msg.gains[1][2], view.gains(1)[2]);
+    EXPECT_EQ(msg.cov[4][5], view.cov(4)[5]);
+    EXPECT_EQ(msg.pos.y, view.pos().y());
+    EXPECT_EQ(msg.waypoints[1][1].z, view.waypoints(1, 1).z());
+    EXPECT_EQ(msg.mode, view.mode());
+    EXPECT_EQ(msg.counts[3], view.counts()[3]);
+}
+
+TEST(LCM_CPP, FixedSizeTruncated) {
+    lcmtest::fixed_size_t msg;
+    FillFixedSize(&msg);
+    std::vector<uint8_t> buf(msg.getEncodedSize());
+    ASSERT_EQ((int) buf.size(), msg.encode(&buf[0], 0, buf.size()));
+
+    std::vector<uint8_t> out(buf.size());
+    for (int len = 0; len < (int) buf.size(); ++len) {
+        lcmtest::fixed_size_t decoded;
+        EXPECT_GT(0, decoded.decode(&buf[0], 0, len)) << "length " << len;
+        EXPECT_GT(0, msg.encode(&out[0], 0, len)) << "length " << len;
+    }
+}
@@ -4,6 +4,8 @@
 
 #include <lcm/lcm-cpp.hpp>
 
+#include "lcmtest/primitives_list_t.hpp"
+
 TEST(LCM_CPP, MemqConstructDestroy) {
     lcm::LCM lcm("memq://");
     EXPECT_TRUE(lcm.good());
@@ -104,3 +106,57 @@ TEST(LCM_CPP, MemqTimeout) {
     EXPECT_LT(0, lcm.handleTimeout(10000));
     EXPECT_TRUE(msg_handled);
 }
+
+struct MemqReuseState {
+    std::vector<const lcmtest::primitives_list_t*> msgs;
+    std::vector<size_t> num_items;
+    std::vector<size_t> num_ranges;
+};
+
+void MemqReuseHandler(const lcm::ReceiveBuffer* rbuf,
+        const std::string& channel,
+        const lcmtest::primitives_list_t* msg,
+        MemqReuseState* state) {
+    state->msgs.push_back(msg);
+    state->num_items.push_back(msg->items.size());
+    state->num_ranges.push_back(msg->items.empty() ? 0 :
+            msg->items[0].ranges.size());
+}
+
+TEST(LCM_CPP, MemqReuseMessage) {
+    // Messages are decoded into the same instance.  Arrays that shrink,
+    // including to zero elements, must not keep the previous elements.
+    lcm::LCM lcm("memq://");
+    MemqReuseState state;
+    lcm.subscribeFunction("channel", MemqReuseHandler, &state);
+
+    lcmtest::primitives_list_t msg;
+    msg.num_items = 2;
+    msg.items.resize(2);
+    msg.items[0].num_ranges = 3;
+    msg.items[0].ranges.resize(3);
+    msg.items[1].num_ranges = 0;
+    lcm.publish("channel", &msg);
+
+    msg.num_items = 1;
+    msg.items.resize(1);
+    msg.items[0].num_ranges = 0;
+    msg.items[0].ranges.clear();
+    lcm.publish("channel", &msg);
+
+    msg.num_items = 0;
+    msg.items.clear();
+    lcm.publish("channel", &msg);
+
+    for (int i = 0; i < 3; i++)
+        lcm.handle();
+
+    ASSERT_EQ(3, state.msgs.size());
+    EXPECT_EQ(state.msgs[0], state.msgs[1]);
+    EXPECT_EQ(state.msgs[0], state.msgs[2]);
+    EXPECT_EQ(2, state.num_items[0]);
+    EXPECT_EQ(3, state.num_ranges[0]);
+    EXPECT_EQ(1, state.num_items[1]);
+    EXPECT_EQ(0, state.num_ranges[1]);
+    EXPECT_EQ(0, state.num_items[2]);
+}
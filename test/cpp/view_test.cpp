@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <string.h>
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+template <class T>
+static std::vector<uint8_t> Encode(const T& msg) {
+    std::vector<uint8_t> buf(msg.getEncodedSize());
+    EXPECT_EQ((int) buf.size(), msg.encode(&buf[0], 0, buf.size()));
+    return buf;
+}
+
+// copyTo() decodes the fields, which follow the 8 byte hash
+static const int kHashSize = 8;
+
+// Checks that a view refuses every truncated copy of an encoded message.
+template <class V>
+static void ExpectTruncatedRejected(const std::vector<uint8_t>& buf) {
+    for (int len = 0; len < (int) buf.size(); ++len) {
+        V view;
+        EXPECT_GT(0, view.decode(&buf[0], 0, len)) << "length " << len;
+    }
+}
+
+TEST(LCM_CPP, ViewMultidimArray) {
+    lcmtest::multidim_array_t msg;
+    FillLcmType(3, &msg);
+    std::vector<uint8_t> buf = Encode(msg);
+
+    lcmtest::multidim_array_tView view;
+    ASSERT_EQ((int) buf.size(), view.decode(&buf[0], 0, buf.size()));
+    EXPECT_EQ(3, view.size_a());
+    EXPECT_EQ(3, view.size_b());
+    EXPECT_EQ(3, view.size_c());
+
+    // the whole array, flattened
+    lcm::ArrayView<int32_t> data = view.data();
+    ASSERT_EQ(27, data.size());
+    for (int n = 0; n < data.size(); ++n) {
+        EXPECT_EQ(n, data[n]);
+    }
+
+    // the innermost dimension
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            lcm::ArrayView<int32_t> row = view.data(i, j);
+            ASSERT_EQ(3, row.size());
+            for (int k = 0; k < 3; ++k) {
+                EXPECT_EQ(msg.data[i][j][k], row[k]);
+            }
+        }
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            EXPECT_STREQ(msg.strarray[i][k].c_str(), view.strarray(i, k));
+        }
+    }
+
+    lcmtest::multidim_array_t copy;
+    ASSERT_EQ((int) buf.size() - kHashSize, view.copyTo(&copy));
+    EXPECT_TRUE(CheckLcmType(&copy, 3));
+
+    ExpectTruncatedRejected<lcmtest::multidim_array_tView>(buf);
+}
+
+TEST(LCM_CPP, ViewArrayCopyAndSlice) {
+    lcmtest::multidim_array_t msg;
+    FillLcmType(4, &msg);
+    std::vector<uint8_t> buf = Encode(msg);
+    lcmtest::multidim_array_tView view;
+    ASSERT_EQ((int) buf.size(), view.decode(&buf[0], 0, buf.size()));
+
+    lcm::ArrayView<int32_t> data = view.data();
+    std::vector<int32_t> values(data.size());
+    data.copyTo(&values[0]);
+    for (int n = 0; n < (int) values.size(); ++n) {
+        EXPECT_EQ(n, values[n]);
+    }
+
+    // every other element of the second row
+    lcm::ArrayView<int32_t> slice = view.data(0, 1).slice(1, 2, 2);
+    ASSERT_EQ(2, slice.size());
+    EXPECT_EQ(2 * (int) sizeof(int32_t), slice.stride());
+    EXPECT_EQ(5, slice[0]);
+    EXPECT_EQ(7, slice[1]);
+
+    // a column through the whole array, copied out
+    lcm::ArrayView<int32_t> column = data.slice(2, 16, 4);
+    std::vector<int32_t> column_values(column.size());
+    column.copyTo(&column_values[0]);
+    for (int n = 0; n < column.size(); ++n) {
+        EXPECT_EQ(2 + 4 * n, column_values[n]);
+    }
+
+    lcm::ArrayView<int32_t> empty = data.slice(3, 0);
+    EXPECT_TRUE(empty.empty());
+}
+
+TEST(LCM_CPP, ViewNode) {
+    lcmtest::node_t msg;
+    FillLcmType(3, &msg);
+    std::vector<uint8_t> buf = Encode(msg);
+
+    lcmtest::node_tView view;
+    ASSERT_EQ((int) buf.size(), view.decode(&buf[0], 0, buf.size()));
+    ASSERT_EQ(3, view.num_children());
+    for (int i = 0; i < 3; ++i) {
+        lcmtest::node_tView child = view.children(i);
+        ASSERT_EQ(2, child.num_children());
+        for (int j = 0; j < 2; ++j) {
+            lcmtest::node_tView grandchild = child.children(j);
+            ASSERT_EQ(1, grandchild.num_children());
+            EXPECT_EQ(0, grandchild.children(0).num_children());
+        }
+    }
+
+    lcmtest::node_t copy;
+    ASSERT_EQ((int) buf.size() - kHashSize, view.copyTo(&copy));
+    EXPECT_TRUE(CheckLcmType(&copy, 3));
+
+    ExpectTruncatedRejected<lcmtest::node_tView>(buf);
+}
+
+TEST(LCM_CPP, ViewPrimitivesList) {
+    lcmtest::primitives_list_t msg;
+    FillLcmType(5, &msg);
+    std::vector<uint8_t> buf = Encode(msg);
+
+    lcmtest::primitives_list_tView view;
+    ASSERT_EQ((int) buf.size(), view.decode(&buf[0], 0, buf.size()));
+    ASSERT_EQ(5, view.num_items());
+    for (int n = 0; n < 5; ++n) {
+        const lcmtest::primitives_t& expected = msg.items[n];
+        lcmtest::primitives_tView item = view.items(n);
+        EXPECT_EQ(expected.i8, item.i8());
+        EXPECT_EQ(expected.i16, item.i16());
+        EXPECT_EQ(expected.i64, item.i64());
+        ASSERT_EQ(n, item.num_ranges());
+        ASSERT_EQ(n, item.ranges().size());
+        for (int i = 0; i < n; ++i) {
+            EXPECT_EQ(expected.ranges[i], item.ranges()[i]);
+        }
+        ASSERT_EQ(3, item.position().size());
+        for (int i = 0; i < 3; ++i) {
+            EXPECT_EQ(expected.position[i], item.position()[i]);
+        }
+        ASSERT_EQ(4, item.orientation().size());
+        for (int i = 0; i < 4; ++i) {
+            EXPECT_EQ(expected.orientation[i], item.orientation()[i]);
+        }
+        EXPECT_STREQ(expected.name.c_str(), item.name());
+        EXPECT_EQ(expected.enabled, item.enabled());
+    }
+
+    lcmtest::primitives_list_t copy;
+    ASSERT_EQ((int) buf.size() - kHashSize, view.copyTo(&copy));
+    EXPECT_TRUE(CheckLcmType(&copy, 5));
+
+    ExpectTruncatedRejected<lcmtest::primitives_list_tView>(buf);
+}
+
+TEST(LCM_CPP, ViewWrongHash) {
+    lcmtest::node_t msg;
+    FillLcmType(1, &msg);
+    std::vector<uint8_t> buf = Encode(msg);
+    buf[0] ^= 0xff;
+
+    lcmtest::node_tView view;
+    EXPECT_GT(0, view.decode(&buf[0], 0, buf.size()));
+}
@@ -27,10 +27,13 @@ def run_tests():
     print("Running C unit tests")
     run_gtest("c/memq_test")
     run_gtest("c/eventlog_test")
+    run_gtest("c/arena_test")
 
     # C++ unit tests
     print("Running C++ unit tests")
     run_gtest("cpp/memq_test")
+    run_gtest("cpp/view_test")
+    run_gtest("cpp/fixed_size_test")
 
 def summarize_results():
     # Parse and summarize unit test results